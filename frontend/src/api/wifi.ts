@@ -1,11 +1,17 @@
-export const getStatus = async () => {
+// Long-poll: the device holds the request until the status version differs
+// from `since` or `waitMs` passes. The ETag header (boot nonce and version) is the tag.
+export const getStatus = async (since?: string, waitMs = 20000) => {
     const controller = new AbortController();
-    const id = setTimeout(() => controller.abort(), 3000); // Таймаут 3 сек
+    const timeout = since ? waitMs + 3000 : 3000; // Таймаут 3 сек сверх ожидания
+    const id = setTimeout(() => controller.abort(), timeout);
+
+    const url = since ? `/api/status?wait=${waitMs}&since=${since}` : '/api/status';
 
     try {
-        const res = await fetch('/api/status', { signal: controller.signal });
+        const res = await fetch(url, { signal: controller.signal });
         clearTimeout(id);
-        return await res.json();
+        const version = (res.headers.get("ETag") || "").replace(/"/g, "");
+        return { data: await res.json(), version };
     } catch (e) {
         throw new Error("Device unreachable");
     }
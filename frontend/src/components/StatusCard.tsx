@@ -29,26 +29,37 @@ export const StatusCard: FC = () => {
   useEffect(() => {
     let isMounted = true;
 
+    // Long-poll: каждый запрос висит на устройстве до изменения статуса
     const pollStatus = async () => {
-      try {
-        const data = await getStatus();
-        if (isMounted) {
-          setStatus(data);
-          setError(false);
-        }
-      } catch (err) {
-        if (isMounted) {
-          setError(true);
+      let version: string | undefined;
+      while (isMounted) {
+        try {
+          const started = Date.now();
+          const res = await getStatus(version);
+          if (isMounted) {
+            setStatus(res.data);
+            setError(false);
+          }
+          // Быстрый ответ без изменений = все слоты заняты, откат к опросу
+          const unchanged = !res.version || res.version === version;
+          version = res.version || undefined;
+          if (unchanged && Date.now() - started < 1000) {
+            await new Promise((resolve) => setTimeout(resolve, 3000));
+          }
+        } catch (err) {
+          if (isMounted) {
+            setError(true);
+          }
+          version = undefined;
+          await new Promise((resolve) => setTimeout(resolve, 3000));
         }
       }
     };
 
     pollStatus();
-    const interval = setInterval(pollStatus, 3000); // Опрос раз в 3 сек для отзывчивости
 
     return () => {
       isMounted = false;
-      clearInterval(interval);
     };
   }, []);
 
@@ -1,16 +1,45 @@
 #pragma once
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/PowerManager.h"
+#include "../core/MemoryMonitor.h"
+#include "../core/Trace.h"
+#include "../core/Timebase.h"
+#include "../core/Axes.h"
+#include "../core/SequenceEngine.h"
+#include "../core/Replay.h"
+#include "../core/MotorMailbox.h"
+#include "../core/Profile.h"
 
 #include "../hardware/EncoderReader.h"
-#include "../hardware/Buttons.h"
 #include "../hardware/MotorController.h"
 #include "../hardware/CurrentSensor.h"
+#include "../hardware/CurrentAnalyzer.h"
+#include "../hardware/StallGuard.h"
+
+// Modules outside the build profile are replaced by OmittedModule
+#if AF_FEATURE_BUTTONS
+#include "../hardware/Buttons.h"
+#else
+using Buttons = OmittedModule;
+#endif
+
+#if AF_FEATURE_DISPLAY
 #include "../hardware/Display.h"
+#else
+using Display = OmittedModule;
+#endif
 
+#if AF_FEATURE_NETWORK
 #include "../network/WebServer.h"
 #include "../network/WiFiManager.h"
 #include "../network/MqttBroker.h"
+#else
+using WiFiManager = OmittedModule;
+using WebServer = OmittedModule;
+using MqttBroker = OmittedModule;
+#endif
 
 class App
 {
@@ -20,44 +49,164 @@ public:
 
 private:
     DeviceState state;
+    PowerManager power;
+    MemoryMonitor memory;
 
     WiFiManager wifi;
     WebServer web;
     MqttBroker mqtt;
 
-    EncoderReader encoder;
+    // One instance per axis in Config::Axes::COUNT
+    AxisBank<EncoderReader> encoders;
+    AxisBank<CurrentSensor> currents;
+    AxisBank<MotorController> motors;
+    CurrentAnalyzer analyzer;
+    StallGuard stallGuards[Config::Axes::COUNT];
+
     Buttons buttons;
-    MotorController motor;
-    CurrentSensor current;
     Display display;
+
+    void controlTick();
 };
 
 void App::setup()
 {
     Serial0.begin(Config::Debug::BAUD_RATE);
+    Log::begin();
+    memory.begin();
+    Timebase::begin();
 
-    
     wifi.begin(state);
     web.begin(state);
+    // Programs arrive over MQTT/HTTP and are stored on LittleFS, which the
+    // web server mounts
+    if constexpr (Config::Profile::NETWORK)
+        SequenceEngine::begin();
     mqtt.begin(state);
     
-    encoder.begin();
+    encoders.forEach([](auto &encoder, uint8_t) { encoder.begin(); });
+    currents.forEach([](auto &current, uint8_t) { current.begin(); });
+    motors.forEach([](auto &motor, uint8_t) { motor.begin(); });
+    analyzer.begin();
+
     buttons.begin();
-    motor.begin();
-    current.begin();
-    display.begin();      
+    display.begin();
+    power.begin();
+
+    MemoryMonitor::booted();
 }
 
 void App::loop()
 {
-    wifi.update(state);
-    web.update(state);
-    mqtt.update(state);
+    TRACE_SCOPE("loop");
+    // Steady-state passes should make no heap calls; the module probes
+    // below say which part did when this one counts any
+    MemoryMonitor::Probe loopProbe(MemoryMonitor::Module::Loop);
+    {
+        TRACE_SCOPE("wifi");
+        MemoryMonitor::Probe probe(MemoryMonitor::Module::WiFi);
+        wifi.update(state);
+        Timebase::update(state);
+    }
+    {
+        TRACE_SCOPE("web");
+        MemoryMonitor::Probe probe(MemoryMonitor::Module::Web);
+        web.update(state);
+    }
+    {
+        TRACE_SCOPE("mqtt");
+        MemoryMonitor::Probe probe(MemoryMonitor::Module::Mqtt);
+        mqtt.update(state);
+    }
+    {
+        TRACE_SCOPE("buttons");
+        buttons.update(state);
+    }
+
+#if AF_FEATURE_NETWORK
+    // Replayed commands land before the pass recorded after them; runs are
+    // started over HTTP, so there is nothing to replay without the network
+    Replay::update(state, [this](const char *topic, const char *payload) { mqtt.inject(state, topic, payload); });
+#endif
+    controlTick();
+    if (!Replay::replaying())
+    {
+        // Block features come from the live ADC, not from the recording
+        TRACE_SCOPE("analyzer");
+        analyzer.update(state);
+    }
+    {
+        TRACE_SCOPE("display");
+        MemoryMonitor::Probe probe(MemoryMonitor::Module::Display);
+        display.update(state);
+    }
+
+    if constexpr (Config::Profile::NETWORK)
+        SequenceEngine::update();
+    memory.update(state);
+    Trace::update();
+    power.update(state);
+}
+
+void App::controlTick()
+{
+    // Sensors for every axis first, then all outputs back to back so
+    // setpoints committed together (hub/cmd/sync) start on the same pass
+    TRACE_SCOPE("control");
+    unsigned long start = micros();
+
+    // Raw readings come from the hardware or, during a replay, from the
+    // recording; a replay without a pass due yet skips this one
+    AxisInputs inputs[Config::Axes::COUNT];
+    bool replaying = Replay::replaying();
+
+    // Latest /api/motor setpoints, ahead of the input record so a replay
+    // applies them on the same pass
+    if constexpr (Config::Profile::NETWORK)
+        MotorMailbox::apply(state, replaying);
+    if (!replaying)
+    {
+        encoders.forEach([&inputs](auto &encoder, uint8_t i) { encoder.sample(inputs[i]); });
+        currents.forEach([&inputs](auto &current, uint8_t i) { current.sample(inputs[i]); });
+    }
+    if (!Replay::inputs(inputs))
+        return;
+
+    encoders.forEach([&](auto &encoder, uint8_t i) { encoder.update(state.axes[i], inputs[i]); });
+    currents.forEach([&](auto &current, uint8_t i) { current.update(state.axes[i], inputs[i]); });
+
+    // Sequence setpoints go through the stall guards like any other command
+    SequenceEngine::tick(state);
+
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+        stallGuards[i].update(state.axes[i], state.stallReaction);
 
-    buttons.update(state, wifi);
-    encoder.update(state);
-    current.update(state);
+    // Stage every duty, then latch them; the LEDC timer is shared, so the
+    // new duties take effect on the same PWM period. A replay leaves the
+    // motors stopped; its duties only go into the output record.
+    if (!replaying)
+    {
+        motors.forEach([this](auto &motor, uint8_t i) { motor.update(state.axes[i]); });
+        motors.forEach([this](auto &motor, uint8_t i) { motor.apply(state.axes[i]); });
+    }
+    else
+    {
+        for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+        {
+            if (state.axes[i].commandPending)
+                LatencyTracker::close(state.axes[i], micros());
+        }
+    }
 
-    motor.update(state);
-    display.update(state);
+    state.controlTickUs = micros() - start;
+    if (Replay::mode() != Replay::Mode::Off)
+    {
+        uint16_t duties[Config::Axes::COUNT];
+        motors.forEach([this, &duties](auto &motor, uint8_t i) { duties[i] = motor.dutyFor(state.axes[i].motorSpeed); });
+        Replay::pass(state, duties, state.controlTickUs);
+    }
+    if (state.controlTickUs > Config::Axes::CONTROL_BUDGET_US)
+    {
+        LOG_W(Motor, "Control pass over budget: %lu us", (unsigned long)state.controlTickUs);
+    }
 }
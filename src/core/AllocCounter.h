@@ -0,0 +1,158 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+#include "Config.h"
+
+// Heap calls per task. On the target malloc, calloc and realloc are wrapped
+// at link time (-Wl,--wrap in platformio.ini) and every call bumps the
+// calling task's tally, so a MemoryMonitor::Probe also sees allocations that
+// are freed again before it ends; the free-size delta cannot. A task is
+// watched from its first calls() or preferPsram(), up to
+// Config::Memory::ALLOC_TASKS. On the host, tests call count() from their
+// own allocator hooks.
+//
+// The same wraps let one task send its larger malloc/calloc blocks to PSRAM
+// for a while (BrokerServer's capacity mode) without touching what any other
+// task allocates, unlike heap_caps_malloc_extmem_enable().
+class AllocCounter
+{
+public:
+    // Heap calls made so far by the calling task
+    static uint32_t calls();
+
+    // Calling task: blocks of at least `minBytes` come from PSRAM, falling
+    // back to internal heap when it is full; 0 turns it off
+    static void preferPsram(size_t minBytes);
+
+    // From the allocator hooks; returns the task's preferPsram() threshold
+    static size_t count();
+
+private:
+#ifdef ARDUINO
+    static portMUX_TYPE mux;
+    static TaskHandle_t tasks[Config::Memory::ALLOC_TASKS];
+    // Written by the owning task only
+    static uint32_t tallies[Config::Memory::ALLOC_TASKS];
+    static size_t psramMin[Config::Memory::ALLOC_TASKS];
+
+    static int8_t slot();
+#else
+    static thread_local uint32_t tally;
+#endif
+};
+
+#ifdef ARDUINO
+portMUX_TYPE AllocCounter::mux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t AllocCounter::tasks[Config::Memory::ALLOC_TASKS] = {};
+uint32_t AllocCounter::tallies[Config::Memory::ALLOC_TASKS] = {};
+size_t AllocCounter::psramMin[Config::Memory::ALLOC_TASKS] = {};
+
+// The calling task's slot, taken on first use; -1 once all are taken
+int8_t AllocCounter::slot()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < Config::Memory::ALLOC_TASKS; i++)
+    {
+        if (tasks[i] == self)
+            return i;
+    }
+
+    int8_t found = -1;
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < Config::Memory::ALLOC_TASKS; i++)
+    {
+        if (!tasks[i])
+        {
+            tallies[i] = 0;
+            psramMin[i] = 0;
+            tasks[i] = self;
+            found = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+    return found;
+}
+
+uint32_t AllocCounter::calls()
+{
+    int8_t i = slot();
+    return i < 0 ? 0 : tallies[i];
+}
+
+void AllocCounter::preferPsram(size_t minBytes)
+{
+    int8_t i = slot();
+    if (i >= 0)
+        psramMin[i] = minBytes;
+}
+
+// In IRAM like the heap functions it sits in front of
+size_t IRAM_ATTR AllocCounter::count()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (!self)
+        return 0;
+    for (uint8_t i = 0; i < Config::Memory::ALLOC_TASKS; i++)
+    {
+        if (tasks[i] == self)
+        {
+            tallies[i]++;
+            return psramMin[i];
+        }
+    }
+    return 0;
+}
+
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *IRAM_ATTR __wrap_malloc(size_t size)
+    {
+        size_t psramMin = AllocCounter::count();
+        if (psramMin && size >= psramMin)
+        {
+            if (void *block = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT))
+                return block;
+        }
+        return __real_malloc(size);
+    }
+
+    void *IRAM_ATTR __wrap_calloc(size_t count, size_t size)
+    {
+        size_t psramMin = AllocCounter::count();
+        if (psramMin && count * size >= psramMin)
+        {
+            if (void *block = heap_caps_calloc(count, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT))
+                return block;
+        }
+        return __real_calloc(count, size);
+    }
+
+    void *IRAM_ATTR __wrap_realloc(void *ptr, size_t size)
+    {
+        AllocCounter::count();
+        return __real_realloc(ptr, size);
+    }
+}
+#else
+thread_local uint32_t AllocCounter::tally = 0;
+
+uint32_t AllocCounter::calls() { return tally; }
+void AllocCounter::preferPsram(size_t) {}
+
+size_t AllocCounter::count()
+{
+    tally++;
+    return 0;
+}
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+#include "Config.h"
+
+// Compile-time description of one motor channel. Modules that drive an axis
+// are templates over this type, so pins are constants.
+template <uint8_t PwmPin, uint8_t DirPin, uint8_t EnPin,
+          uint8_t EncAPin, uint8_t EncBPin, uint8_t EncZPin,
+          uint8_t AdcPin>
+struct AxisDescriptor
+{
+    static constexpr uint8_t MOTOR_PWM = PwmPin;
+    static constexpr uint8_t MOTOR_DIR = DirPin;
+    static constexpr uint8_t MOTOR_EN = EnPin;
+    static constexpr uint8_t ENCODER_A = EncAPin;
+    static constexpr uint8_t ENCODER_B = EncBPin;
+    static constexpr uint8_t ENCODER_Z = EncZPin; // NO_PIN: homing zeroes in place
+    static constexpr uint8_t CURRENT_ADC = AdcPin;
+
+    static constexpr bool HAS_INDEX = EncZPin != Config::Pins::NO_PIN;
+    static constexpr bool HAS_CURRENT = AdcPin != Config::Pins::NO_PIN;
+};
+
+namespace Axes
+{
+    namespace Pins = Config::Pins;
+
+    // Set the Z pin to Pins::ENCODER_Z to home on the index channel
+    using Axis0 = AxisDescriptor<Pins::MOTOR_PWM, Pins::MOTOR_DIR, Pins::MOTOR_EN,
+                                 Pins::ENCODER_A, Pins::ENCODER_B, Pins::NO_PIN, Pins::CURRENT_ADC>;
+    using Axis1 = AxisDescriptor<Pins::Axis1::MOTOR_PWM, Pins::Axis1::MOTOR_DIR, Pins::Axis1::MOTOR_EN,
+                                 Pins::Axis1::ENCODER_A, Pins::Axis1::ENCODER_B, Pins::NO_PIN, Pins::Axis1::CURRENT_ADC>;
+    using Axis2 = AxisDescriptor<Pins::Axis2::MOTOR_PWM, Pins::Axis2::MOTOR_DIR, Pins::Axis2::MOTOR_EN,
+                                 Pins::Axis2::ENCODER_A, Pins::Axis2::ENCODER_B, Pins::NO_PIN, Pins::Axis2::CURRENT_ADC>;
+    // No free pins left on the DevKitC carrier; assign before raising Config::Axes::COUNT to 4
+    using Axis3 = AxisDescriptor<Pins::NO_PIN, Pins::NO_PIN, Pins::NO_PIN, Pins::NO_PIN,
+                                 Pins::NO_PIN, Pins::NO_PIN, Pins::NO_PIN>;
+
+    using All = std::tuple<Axis0, Axis1, Axis2, Axis3>;
+
+    static_assert(Config::Axes::COUNT >= 1 && Config::Axes::COUNT <= Config::Axes::MAX_COUNT,
+                  "Config::Axes::COUNT out of range");
+}
+
+// One module instance per active axis, stored inline (no heap, no virtual calls).
+// forEach() unrolls at compile time, so a control pass costs O(COUNT).
+template <template <typename> class Module,
+          typename Indices = std::make_index_sequence<Config::Axes::COUNT>>
+class AxisBank;
+
+template <template <typename> class Module, size_t... I>
+class AxisBank<Module, std::index_sequence<I...>>
+{
+public:
+    template <typename F>
+    void forEach(F &&f)
+    {
+        (f(std::get<I>(modules), (uint8_t)I), ...);
+    }
+
+    template <size_t N>
+    auto &get() { return std::get<N>(modules); }
+
+private:
+    std::tuple<Module<std::tuple_element_t<I, Axes::All>>...> modules;
+};
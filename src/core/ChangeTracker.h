@@ -0,0 +1,253 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "Host.h"
+#endif
+#include <ArduinoJson.h>
+#include "DeviceState.h"
+#include "Config.h"
+
+// One flat snapshot of the reported DeviceState fields: every axis' fields
+// followed by the device-wide ones. Values are kept as doubles so one
+// deadband comparison covers counts, floats, flags and enums alike.
+struct TelemetryFrame
+{
+    enum AxisField : uint8_t
+    {
+        Encoder,
+        Homed,
+        Current,
+        MotorSpeed,
+        CurrentRms,
+        CurrentPeak,
+        VibrationHz,
+        Alarm,
+        Velocity,
+        Load,
+        LoadStall,
+        AXIS_FIELDS
+    };
+
+    enum DeviceField : uint8_t
+    {
+        WifiConnected,
+        ApActive,
+        MqttConnected,
+        ControlTickUs,
+        PowerIdle,
+        AvgCurrentMa,
+        WakeLatencyUs,
+        HeapFree,
+        HeapLargestBlock,
+        MemoryLow,
+        Backlog,
+        SequenceState,
+        SequenceStep,
+        SequenceLoops,
+        DEVICE_FIELDS
+    };
+
+    static constexpr uint8_t COUNT = AXIS_FIELDS * Config::Axes::COUNT + DEVICE_FIELDS;
+    static_assert(COUNT <= 64, "Field mask is 64 bits");
+
+    static constexpr uint8_t field(uint8_t axis, AxisField f) { return axis * AXIS_FIELDS + f; }
+    static constexpr uint8_t field(DeviceField f) { return AXIS_FIELDS * Config::Axes::COUNT + f; }
+
+    double values[COUNT];
+
+    void capture(const DeviceState &state);
+
+    // Writes the fields in `mask`: axis 0 and device fields at the top level
+    // (the hub/telemetry keys), other axes under "axes":{"<n>":{...}}
+    void write(JsonObject out, uint64_t mask) const;
+
+private:
+    enum class Kind : uint8_t
+    {
+        Int,
+        Float,
+        Bool,
+        Alarm,
+        Sequence
+    };
+
+    struct Info
+    {
+        const char *key;
+        Kind kind;
+        float deadband;
+    };
+
+    static const Info axisInfo[AXIS_FIELDS];
+    static const Info deviceInfo[DEVICE_FIELDS];
+
+    static const Info &info(uint8_t index);
+    friend class ChangeTracker;
+};
+
+// Change detection for one consumer. A field counts as changed once it has
+// moved more than its Config::Telemetry deadband away from the value the
+// consumer last took, so slow drift is still reported once it adds up.
+// MQTT deltas and the display each keep their own tracker.
+class ChangeTracker
+{
+public:
+    static constexpr uint64_t ALL = TelemetryFrame::COUNT == 64 ? ~0ull : (1ull << TelemetryFrame::COUNT) - 1;
+
+    static constexpr uint64_t bit(uint8_t field) { return 1ull << field; }
+
+    // Fields past their deadband since they were last committed
+    uint64_t changes(const TelemetryFrame &frame) const;
+
+    // Takes the frame's values for `mask` as the new reference
+    void commit(const TelemetryFrame &frame, uint64_t mask);
+
+private:
+    double reference[TelemetryFrame::COUNT] = {};
+    uint64_t valid = 0;
+};
+
+const TelemetryFrame::Info TelemetryFrame::axisInfo[AXIS_FIELDS] = {
+    {"encoder", Kind::Int, Config::Telemetry::ENCODER_COUNTS},
+    {"homed", Kind::Bool, 0},
+    {"current", Kind::Int, Config::Telemetry::CURRENT_ADC},
+    {"motorSpeed", Kind::Int, 0},
+    {"currentRms", Kind::Float, Config::Telemetry::CURRENT_RMS},
+    {"currentPeak", Kind::Float, Config::Telemetry::CURRENT_PEAK},
+    {"vibrationHz", Kind::Float, Config::Telemetry::VIBRATION_HZ},
+    {"alarm", Kind::Alarm, 0},
+    {"velocity", Kind::Float, Config::Telemetry::VELOCITY},
+    {"load", Kind::Float, Config::Telemetry::LOAD},
+    {"loadStall", Kind::Bool, 0},
+};
+
+const TelemetryFrame::Info TelemetryFrame::deviceInfo[DEVICE_FIELDS] = {
+    {"wifiConnected", Kind::Bool, 0},
+    {"apActive", Kind::Bool, 0},
+    {"mqttConnected", Kind::Bool, 0},
+    {"controlTickUs", Kind::Int, Config::Telemetry::CONTROL_TICK_US},
+    {"powerIdle", Kind::Bool, 0},
+    {"avgCurrentMa", Kind::Int, Config::Telemetry::AVG_CURRENT_MA},
+    {"wakeLatencyUs", Kind::Int, Config::Telemetry::WAKE_LATENCY_US},
+    {"heapFree", Kind::Int, Config::Telemetry::HEAP_BYTES},
+    {"heapLargestBlock", Kind::Int, Config::Telemetry::HEAP_BYTES},
+    {"memoryLow", Kind::Bool, 0},
+    {"backlog", Kind::Int, 0},
+    {"sequence", Kind::Sequence, 0},
+    {"sequenceStep", Kind::Int, 0},
+    {"sequenceLoops", Kind::Int, 0},
+};
+
+const TelemetryFrame::Info &TelemetryFrame::info(uint8_t index)
+{
+    uint8_t axisFields = AXIS_FIELDS * Config::Axes::COUNT;
+    return index < axisFields ? axisInfo[index % AXIS_FIELDS] : deviceInfo[index - axisFields];
+}
+
+void TelemetryFrame::capture(const DeviceState &state)
+{
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        const AxisState &axis = state.axes[i];
+        double *v = values + field(i, Encoder);
+        v[Encoder] = axis.encoderPos;
+        v[Homed] = axis.homed;
+        v[Current] = axis.currentAdc;
+        v[MotorSpeed] = axis.motorSpeed;
+        v[CurrentRms] = axis.currentRms;
+        v[CurrentPeak] = axis.currentPeak;
+        v[VibrationHz] = axis.vibrationHz;
+        v[Alarm] = (uint8_t)axis.currentAlarm;
+        v[Velocity] = axis.velocity;
+        v[Load] = axis.loadEstimate;
+        v[LoadStall] = axis.loadStall;
+    }
+
+    double *d = values + field(WifiConnected);
+    d[WifiConnected] = state.wifiConnected;
+    d[ApActive] = state.apActive;
+    d[MqttConnected] = state.mqttConnected;
+    d[ControlTickUs] = state.controlTickUs;
+    d[PowerIdle] = state.powerIdle;
+    d[AvgCurrentMa] = state.avgCurrentMa;
+    d[WakeLatencyUs] = state.wakeLatencyUs;
+    d[HeapFree] = state.heapFree;
+    d[HeapLargestBlock] = state.heapLargestBlock;
+    d[MemoryLow] = state.memoryLow;
+    d[Backlog] = state.backlogRecords;
+    d[SequenceState] = (uint8_t)state.sequenceState;
+    d[SequenceStep] = state.sequenceStep;
+    d[SequenceLoops] = state.sequenceLoops;
+}
+
+void TelemetryFrame::write(JsonObject out, uint64_t mask) const
+{
+    // Fields run axis by axis, so each axis object is created once
+    JsonObject axes;
+    JsonObject axisOut;
+    uint8_t axisOutIndex = 0;
+    for (uint8_t i = 0; i < COUNT; i++)
+    {
+        if (!(mask & ChangeTracker::bit(i)))
+            continue;
+
+        JsonObject target = out;
+        uint8_t axis = i / AXIS_FIELDS;
+        if (axis > 0 && axis < Config::Axes::COUNT)
+        {
+            if (axis != axisOutIndex)
+            {
+                if (axes.isNull())
+                    axes = out["axes"].to<JsonObject>();
+                char name[4];
+                snprintf(name, sizeof(name), "%u", axis);
+                axisOut = axes[name].to<JsonObject>();
+                axisOutIndex = axis;
+            }
+            target = axisOut;
+        }
+
+        const Info &field = info(i);
+        switch (field.kind)
+        {
+        case Kind::Int:
+            target[field.key] = (int64_t)values[i];
+            break;
+        case Kind::Float:
+            target[field.key] = (float)values[i];
+            break;
+        case Kind::Bool:
+            target[field.key] = values[i] != 0;
+            break;
+        case Kind::Alarm:
+            target[field.key] = currentAlarmName((CurrentAlarm)(uint8_t)values[i]);
+            break;
+        case Kind::Sequence:
+            target[field.key] = sequenceStateName((::SequenceState)(uint8_t)values[i]);
+            break;
+        }
+    }
+}
+
+uint64_t ChangeTracker::changes(const TelemetryFrame &frame) const
+{
+    uint64_t mask = ALL & ~valid;
+    for (uint8_t i = 0; i < TelemetryFrame::COUNT; i++)
+    {
+        if (fabs(frame.values[i] - reference[i]) > TelemetryFrame::info(i).deadband)
+            mask |= bit(i);
+    }
+    return mask;
+}
+
+void ChangeTracker::commit(const TelemetryFrame &frame, uint64_t mask)
+{
+    for (uint8_t i = 0; i < TelemetryFrame::COUNT; i++)
+    {
+        if (mask & bit(i))
+            reference[i] = frame.values[i];
+    }
+    valid |= mask;
+}
@@ -1,6 +1,30 @@
 #pragma once
 
+// Plain constants; also compiled into the native host tests (test/)
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+// Build profile, set per environment in platformio.ini. These stay macros
+// because they also gate #includes: a module left out never pulls in its
+// headers, so its libraries are not compiled and its buffers, tasks and
+// statics never reach the image. Code tests Config::Profile instead, except
+// around calls into a header that is itself gated.
+#ifndef AF_PROFILE
+#define AF_PROFILE "full"
+#endif
+#ifndef AF_FEATURE_NETWORK
+#define AF_FEATURE_NETWORK 1
+#endif
+#ifndef AF_FEATURE_DISPLAY
+#define AF_FEATURE_DISPLAY 1
+#endif
+#ifndef AF_FEATURE_BUTTONS
+#define AF_FEATURE_BUTTONS 1
+#endif
 
 namespace Config
 {
@@ -8,6 +32,14 @@ namespace Config
     constexpr const char *FIRMWARE_VERSION = "1.0.0";
     constexpr const char *DEVICE_NAME = "AlexFil Hub";
 
+    namespace Profile
+    {
+        constexpr const char *NAME = AF_PROFILE;
+        constexpr bool NETWORK = AF_FEATURE_NETWORK; // WiFi, web server, MQTT broker/bridge, OTA, SNTP
+        constexpr bool DISPLAY = AF_FEATURE_DISPLAY; // TFT status screen and trend plot
+        constexpr bool BUTTONS = AF_FEATURE_BUTTONS; // Jog and setup-mode buttons
+    }
+
     // Pin Definitions
     namespace Pins
     {
@@ -19,6 +51,7 @@ namespace Config
         // Encoder (quadrature)
         constexpr uint8_t ENCODER_A = 15;
         constexpr uint8_t ENCODER_B = 16;
+        constexpr uint8_t ENCODER_Z = 8; // Index channel (optional, see core/Axes.h)
 
         // Buttons (moved to free up SPI pins for display)
         constexpr uint8_t BTN_UP = 17;
@@ -27,20 +60,81 @@ namespace Config
         
         // ADC (current sensor)
         constexpr uint8_t CURRENT_ADC = 7;
+
+        constexpr uint8_t NO_PIN = 0xFF;
+
+        // Additional motor axes (hub carrier board assignment)
+        namespace Axis1
+        {
+            constexpr uint8_t MOTOR_PWM = 38;
+            constexpr uint8_t MOTOR_DIR = 39;
+            constexpr uint8_t MOTOR_EN = 40;
+            constexpr uint8_t ENCODER_A = 41;
+            constexpr uint8_t ENCODER_B = 42;
+            constexpr uint8_t CURRENT_ADC = 9;
+        }
+
+        namespace Axis2
+        {
+            constexpr uint8_t MOTOR_PWM = 47;
+            constexpr uint8_t MOTOR_DIR = 48;
+            constexpr uint8_t MOTOR_EN = 2;
+            constexpr uint8_t ENCODER_A = 11;
+            constexpr uint8_t ENCODER_B = 12;
+            constexpr uint8_t CURRENT_ADC = 10;
+        }
+    }
+
+    // Motion Axes
+    namespace Axes
+    {
+        constexpr uint8_t COUNT = 1;     // Active axes, 1..MAX_COUNT
+        constexpr uint8_t MAX_COUNT = 4; // ESP32-S3 has 4 PCNT units
+        constexpr unsigned long CONTROL_BUDGET_US = 1000; // Sensor + motor pass for all axes
     }
 
     // Motor Settings
     namespace Motor
     {
-        constexpr int MIN_DUTY = 70;
-        constexpr int MAX_SPEED = 255;
-        constexpr int SPEED_STEP = 10;
+        // Speed is per-mille of full scale, sign is direction
+        constexpr int SPEED_SCALE = 1000;
+        constexpr int MAX_SPEED = SPEED_SCALE;
+        constexpr int SPEED_STEP = 40;
+
+        // LEDC output: above the audible range; 80 MHz APB / 20 kHz leaves 11 bits
+        constexpr uint32_t PWM_FREQUENCY_HZ = 20000;
+        constexpr uint8_t PWM_RESOLUTION_BITS = 11;
+        constexpr uint8_t LEDC_TIMER = 0;         // Shared by all axes
+        constexpr uint8_t LEDC_FIRST_CHANNEL = 0; // One channel per axis from here
+
+        // Lowest duty (per-mille) that turns the motor; speed 1 maps here
+        constexpr int DEADBAND = 275;
+
+        enum class StopMode : uint8_t
+        {
+            Coast, // EN low: driver outputs float
+            Brake  // EN high, PWM low: windings shorted (driver dependent)
+        };
+
+        constexpr StopMode STOP_MODE = StopMode::Brake;
     }
 
     // Encoder Settings
     namespace Encoder
     {
+        enum class CountMode : uint8_t
+        {
+            Single, // 1 count per line (A edges, one direction)
+            Half,   // 2 counts per line (A both edges)
+            Full    // 4 counts per line (A and B both edges)
+        };
+
+        constexpr CountMode COUNT_MODE = CountMode::Full;
         constexpr uint16_t FILTER_VALUE = 1023;
+
+        // Homing (index pin is part of the axis descriptor)
+        constexpr int HOMING_SPEED = 300;                  // Sign selects the search direction
+        constexpr unsigned long HOMING_TIMEOUT_MS = 20000;
     }
 
     // Button Settings
@@ -54,10 +148,65 @@ namespace Config
     namespace Current
     {
         constexpr uint8_t ADC_RESOLUTION = 12;
-        constexpr int ADC_THRESHOLD = 20;
         constexpr unsigned long READ_INTERVAL_MS = 100;
     }
 
+    // Current Signal Analysis (block RMS/peak/FFT)
+    namespace Analysis
+    {
+        constexpr bool ENABLED = true;
+        constexpr bool USE_ESP_DSP = true;        // Falls back to the reference kernels if esp-dsp is missing
+        constexpr uint32_t SAMPLE_RATE_HZ = 2000;
+        constexpr size_t BLOCK_SIZE = 256;        // Power of two
+        constexpr uint8_t TASK_PRIORITY = 2;
+        constexpr uint8_t TASK_CORE = 1;          // App core; WiFi/LWIP stay undisturbed on core 0
+        constexpr uint32_t TASK_STACK_SIZE = 4096;
+
+        // Detection thresholds (ADC counts), evaluated only while the axis is driven
+        constexpr float STALL_MEAN_ADC = 2500;
+        constexpr uint8_t STALL_BLOCKS = 2;       // Consecutive blocks above STALL_MEAN_ADC
+        constexpr float JAM_PEAK_ADC = 600;
+        constexpr float JAM_CREST_FACTOR = 4.0f;  // peak / rms
+        constexpr float VIBRATION_BAND_LOW_HZ = 40;
+        constexpr float VIBRATION_BAND_HIGH_HZ = 400;
+        constexpr float VIBRATION_BAND_RATIO = 0.6f;
+        constexpr float VIBRATION_MIN_RMS_ADC = 30;
+    }
+
+    // Stall / Load Estimator (duty + encoder velocity + current fusion)
+    namespace Stall
+    {
+        enum class Reaction : uint8_t
+        {
+            AlarmOnly,
+            Stop,
+            ReverseRetry
+        };
+
+        constexpr Reaction DEFAULT_REACTION = Reaction::Stop;
+
+        // Motor model (calibrate per installation)
+        constexpr float NO_LOAD_CPS_PER_SPEED = 7.4f; // Encoder counts/s per speed step (per-mille)
+        constexpr float CURRENT_ZERO_ADC = 0.0f;      // Sensor output at 0 A
+        constexpr float NO_LOAD_CURRENT_ADC = 300.0f; // Free-running current
+        constexpr float TORQUE_PER_ADC = 1.0f;        // Load units per ADC count above no-load
+
+        constexpr float VELOCITY_FILTER_MS = 10.0f;
+        constexpr float CURRENT_FILTER_MS = 5.0f;
+
+        // Detection
+        constexpr float STALL_SPEED_RATIO = 0.2f;     // Measured / expected velocity below this...
+        constexpr float STALL_CURRENT_ADC = 1500.0f;  // ...while current is above this...
+        constexpr unsigned long STALL_CONFIRM_MS = 30; // ...for this long
+        constexpr unsigned long SPINUP_GRACE_MS = 150; // After a setpoint change
+
+        // Reverse-and-retry
+        constexpr int REVERSE_SPEED = 470;
+        constexpr unsigned long REVERSE_MS = 300;
+        constexpr uint8_t MAX_RETRIES = 3;
+        constexpr unsigned long RETRY_RESET_MS = 2000; // Clean running time that clears the retry count
+    }
+
     // WiFi Settings
     namespace WiFi
     {
@@ -68,21 +217,35 @@ namespace Config
         constexpr unsigned long CONNECT_TIMEOUT_MS = 15000;
         constexpr unsigned long RECONNECT_DELAY_MS = 5000;
         constexpr unsigned long SETUP_MODE_TIMEOUT_MS = 600000; // 10 minutes
+
+        // Scan cache (/api/scan)
+        constexpr unsigned long SCAN_TTL_MS = 30000;         // Results older than this trigger a refresh
+        constexpr unsigned long SCAN_MIN_INTERVAL_MS = 10000; // Shared by all clients
+        constexpr uint8_t SCAN_MAX_NETWORKS = 32;
     }
 
     // MQTT Settings
     namespace Mqtt
     {
         constexpr uint16_t PORT = 1883;
-        constexpr unsigned long TELEMETRY_INTERVAL_MS = 1000;
         constexpr size_t MAX_MESSAGE_SIZE = 512;
         constexpr size_t MAX_TOPIC_SIZE = 64;
 
         // Topics
         constexpr const char *TOPIC_CMD_MOTOR = "hub/cmd/motor";
         constexpr const char *TOPIC_CMD_CONFIG = "hub/cmd/config";
+        constexpr const char *TOPIC_CMD_HOME = "hub/cmd/home";
+        constexpr const char *TOPIC_CMD_SYNC = "hub/cmd/sync";
+        constexpr const char *TOPIC_CMD_SEQUENCE = "hub/cmd/sequence";
+        constexpr const char *TOPIC_AXIS_PREFIX = "hub/axis/";
+        constexpr const char *TOPIC_AXIS_CMD = "hub/axis/+/cmd";
         constexpr const char *TOPIC_TELEMETRY = "hub/telemetry";
+        constexpr const char *TOPIC_TELEMETRY_DELTA = "hub/telemetry/delta";
         constexpr const char *TOPIC_STATUS = "hub/status";
+        constexpr const char *TOPIC_EVENT_ALARM = "hub/event/alarm";
+        constexpr const char *TOPIC_MEMORY = "hub/memory";
+        constexpr const char *TOPIC_ECHO = "hub/echo";
+        constexpr const char *TOPIC_LOG = "hub/log";
 
         // mDNS
         constexpr const char *MDNS_HOSTNAME = "hub";
@@ -90,12 +253,169 @@ namespace Config
         constexpr const char *MDNS_PROTOCOL = "tcp";
     }
 
+    // Timebase (core/Timebase.h); SNTP stays off while NTP_SERVER is empty
+    // and no "ntpServer" was saved through /api/save
+    namespace Time
+    {
+        constexpr const char *NTP_SERVER = "";
+        constexpr uint32_t SYNC_INTERVAL_MS = 15 * 60 * 1000;
+        constexpr uint32_t MIN_DRIFT_SPAN_MS = 60 * 1000;  // Shorter sync gaps are too noisy for drift
+        constexpr double DRIFT_SMOOTHING = 0.25;           // EMA weight of each new drift measurement
+    }
+
+    // Motion sequences (core/SequenceEngine.h), run from the control pass
+    namespace Sequence
+    {
+        constexpr uint16_t MAX_STEPS = 128;               // 12 bytes each, program plus staging copy
+        constexpr const char *FILE_PATH = "/sequence.bin";
+        constexpr size_t MAX_UPLOAD_BYTES = 8192;         // HTTP body, buffered in PSRAM
+        constexpr uint32_t MAX_STEP_MS = 60UL * 60 * 1000; // Durations and timeouts
+        constexpr uint32_t CURRENT_SETTLE_MS = 20;        // "waitCurrentBelow" must hold this long
+    }
+
+    // Record and replay (core/Replay.h): commands and raw sensor readings in,
+    // PWM/telemetry/display out, each into its own PSRAM buffer
+    namespace Replay
+    {
+        constexpr size_t INPUT_BYTES = 512 * 1024;   // 8 + 24 bytes per axis per pass, plus commands
+        constexpr size_t OUTPUT_BYTES = 512 * 1024;
+        constexpr uint32_t DEFAULT_DURATION_MS = 10000;
+        constexpr uint32_t MAX_DURATION_MS = 120000;
+        constexpr uint8_t MAX_SPEED = 16;            // Time scale; 0 replays pass by pass as fast as the loop runs
+        constexpr uint16_t MAX_COMMAND_BYTES = 1024; // Topic plus payload per recorded command
+    }
+
+    // HTTP motor control (/api/motor): latest-wins handoff to the control
+    // pass (core/MotorMailbox.h), token bucket per client address
+    namespace HttpMotor
+    {
+        constexpr uint8_t FRAME_BYTES = 8;          // Binary form: axis, op, speed, id (little endian)
+        constexpr size_t MAX_JSON_BYTES = 128;      // JSON form, one command
+        constexpr uint16_t RATE_PER_SECOND = 100;   // Sustained requests per client
+        constexpr uint16_t BURST = 20;              // Requests a client may send back to back
+        constexpr uint8_t MAX_CLIENTS = 8;          // Tracked addresses; the least recently seen is reused
+    }
+
+    // Change-driven telemetry (core/ChangeTracker.h): full keyframes on
+    // hub/telemetry, changed fields only on hub/telemetry/delta
+    namespace Telemetry
+    {
+        constexpr unsigned long MIN_INTERVAL_MS = 100;        // Deltas at most this often
+        constexpr unsigned long MAX_INTERVAL_MS = 5000;       // Empty delta as a heartbeat when nothing moved
+        constexpr unsigned long KEYFRAME_INTERVAL_MS = 10000; // Resync point for late subscribers
+        constexpr unsigned long OFFLINE_INTERVAL_MS = 1000;   // Keyframes into the backlog while offline
+        // Keyframe buffer: device fields and axis 0 take about 600 bytes, each further axis about 230
+        constexpr size_t KEYFRAME_BYTES = 512 + 256 * Config::Axes::COUNT;
+
+        // Deadbands: a field is reported once it moves more than this from its last reported value
+        constexpr float ENCODER_COUNTS = 2;
+        constexpr float CURRENT_ADC = 20;
+        constexpr float CURRENT_RMS = 5;      // ADC counts
+        constexpr float CURRENT_PEAK = 10;    // ADC counts
+        constexpr float VIBRATION_HZ = 1;
+        constexpr float VELOCITY = 20;        // Counts per second
+        constexpr float LOAD = 0.02f;
+        constexpr float CONTROL_TICK_US = 50;
+        constexpr float AVG_CURRENT_MA = 5;
+        constexpr float WAKE_LATENCY_US = 100;
+        constexpr float HEAP_BYTES = 2048;
+    }
+
+    // Embedded broker limits (network/BrokerServer.h)
+    namespace Broker
+    {
+        constexpr bool CAPACITY_MODE = true;             // Per-client allocations go to PSRAM
+        constexpr size_t PSRAM_ALLOC_THRESHOLD = 256;    // Bytes; smaller blocks stay internal
+        constexpr uint8_t MAX_CLIENTS = 16;              // Further CONNECTs get "server unavailable"
+        constexpr unsigned long SOCKET_TIMEOUT_MS = 250; // A subscriber blocking a send this long is dropped
+        constexpr unsigned long KEEP_ALIVE_TOLERANCE_MS = 10000;
+        // Per-client outbound buffer: PICOMQTT_OUTGOING_BUFFER_SIZE in platformio.ini
+    }
+
+    // Store-and-forward telemetry while WiFi is down (network/TelemetryStore.h)
+    namespace Store
+    {
+        constexpr size_t RING_BYTES = 64 * 1024;          // PSRAM, ~3 min of 1 Hz telemetry
+        constexpr bool SPILL_ENABLED = true;              // Continue on LittleFS when the ring is full
+        constexpr const char *SPILL_PATH = "/backlog.bin";
+        constexpr uint32_t SPILL_MAX_BYTES = 512 * 1024;
+        constexpr unsigned long REPLAY_HOLDOFF_MS = 5000; // Lets subscribers reconnect first
+        constexpr uint16_t REPLAY_PER_SECOND = 20;        // Replay pacing after reconnect
+        constexpr uint8_t REPLAY_BURST = 4;
+    }
+
+    // Upstream bridge (network/MqttBridge.h); off while HOST is empty and
+    // no "bridgeHost" was saved through /api/save
+    namespace Bridge
+    {
+        constexpr const char *HOST = "";
+        constexpr uint16_t PORT = 1883;
+        constexpr const char *TOPIC_ROOT = "plant/hubs"; // Upstream topics: <ROOT>/hub-xxxxxx/...
+        constexpr const char *FORWARD[] = {"hub/telemetry", "hub/telemetry/delta", "hub/status", "hub/event/#"};
+
+        constexpr size_t BATCH_MAX_BYTES = 2048;
+        constexpr uint32_t BATCH_INTERVAL_MS = 1000;    // Longest a message waits for batch-mates
+        constexpr uint8_t QUEUE_BATCHES = 32;           // PSRAM; oldest dropped beyond this
+        constexpr bool COMPRESS = true;                 // Raw deflate via ROM miniz, when it helps
+        constexpr int DEFLATE_PROBES = 128;
+        constexpr uint8_t INBOX_SIZE = 4;               // Upstream commands waiting for the loop
+
+        constexpr uint32_t POLL_INTERVAL_MS = 20;
+        constexpr uint32_t TASK_STACK_SIZE = 6144;
+        constexpr uint8_t TASK_PRIORITY = 1;
+        constexpr uint8_t TASK_CORE = 0;
+    }
+
     // Web Server
     namespace Web
     {
         constexpr uint16_t PORT = 80;
         constexpr size_t MAX_REQUEST_SIZE = 1024;
         constexpr const char *API_PREFIX = "/api";
+
+        // /api/status: body rebuilt by the loop, versioned for ETag / long-poll
+        constexpr unsigned long STATUS_REFRESH_MS = 200;
+        constexpr size_t STATUS_JSON_SIZE = 384;
+        constexpr uint8_t MAX_PARKED_POLLS = 4;        // One per setup-AP client
+        constexpr unsigned long LONG_POLL_MAX_MS = 25000;
+    }
+
+    // JSON document arenas (PSRAM bump allocators, see core/JsonArena.h)
+    namespace Json
+    {
+        constexpr size_t WEB_ARENA_SIZE = 16 * 1024;  // Largest web response: /api/scan with ~40 networks
+        constexpr size_t MQTT_ARENA_SIZE = 8 * 1024;  // Commands, telemetry and alarm events
+        constexpr size_t STATUS_ARENA_SIZE = 2 * 1024; // /api/status rebuild in the loop
+        constexpr uint8_t MAX_HANDLERS = 16;          // Per-handler peak slots per arena
+        constexpr uint8_t MAX_ARENAS = 4;
+    }
+
+    // Command latency (ingress -> PWM write)
+    namespace Latency
+    {
+        constexpr uint8_t HISTOGRAM_BUCKETS = 16;   // Powers of two from BASE_US: 64 us .. 2 s
+        constexpr uint32_t HISTOGRAM_BASE_US = 64;
+        constexpr bool ECHO_ENABLED = true;         // Publish hub/echo for commands carrying an "id"
+    }
+
+    // Memory observability (/api/memory, hub/memory)
+    namespace Memory
+    {
+        constexpr unsigned long SAMPLE_INTERVAL_MS = 1000;
+        constexpr unsigned long PUBLISH_INTERVAL_MS = 10000;
+        constexpr uint8_t MAX_TASKS = 24;
+        constexpr uint8_t ALLOC_TASKS = 4; // Tasks whose heap calls are counted (core/AllocCounter.h)
+
+        // Low-memory alarm, raised before allocations start failing
+        constexpr size_t LOW_HEAP_BYTES = 24 * 1024;  // Free internal heap
+        constexpr size_t LOW_BLOCK_BYTES = 8 * 1024;  // Largest block: one publish plus LWIP pbufs
+        constexpr uint32_t LOW_STACK_BYTES = 512;     // Tightest task stack high-water mark
+    }
+
+    // OTA Updates (/api/ota)
+    namespace Ota
+    {
+        constexpr unsigned long REBOOT_DELAY_MS = 500; // Lets the HTTP response leave before restart
     }
 
     // Display Settings
@@ -105,6 +425,42 @@ namespace Config
         constexpr uint16_t HEIGHT = 320;
         constexpr uint8_t ROTATION = 0;                   // 0=портрет, 1=ландшафт
         constexpr unsigned long UPDATE_INTERVAL_MS = 250; // Обновление экрана каждые 250ms
+
+        // Тренд скорости и тока оси 0 (hardware/TrendPlot.h)
+        constexpr bool PLOT_ENABLED = true;
+        constexpr uint16_t PLOT_X = 5;
+        constexpr uint16_t PLOT_Y = 241;
+        constexpr uint16_t PLOT_WIDTH = 230;              // Колонок истории = PLOT_WIDTH - 2
+        constexpr uint16_t PLOT_HEIGHT = 58;
+        constexpr unsigned long PLOT_INTERVAL_MS = 40;    // Одна колонка за кадр: 25 FPS, ~9 s истории
+        constexpr int16_t PLOT_MIN_CURRENT_ADC = 100;     // Нижняя граница автомасштаба тока
+    }
+
+    // Power Management (idle policy)
+    namespace Power
+    {
+        constexpr bool IDLE_ENABLED = true;
+        constexpr unsigned long IDLE_TIMEOUT_MS = 30000;  // Motor stopped and no activity for this long -> idle
+        constexpr unsigned long IDLE_POLL_MS = 20;        // Loop wait while idle (woken early by interrupts)
+        constexpr uint16_t CPU_FREQ_MAX_MHZ = 240;
+        constexpr uint16_t CPU_FREQ_IDLE_MHZ = 80;
+        constexpr bool LIGHT_SLEEP_ENABLE = true;          // Needs CONFIG_PM_ENABLE in the SDK build
+
+        // Nominal supply current per state, used for the average draw estimate
+        constexpr uint16_t ACTIVE_CURRENT_MA = 115; // 240 MHz, WiFi modem always on
+        constexpr uint16_t IDLE_CURRENT_MA = 35;    // 80 MHz, modem sleep
+        constexpr uint16_t SLEEP_CURRENT_MA = 20;   // Auto light sleep between DTIM beacons
+    }
+
+    // Timeline recorder (core/Trace.h)
+    namespace Trace
+    {
+        constexpr bool ENABLED = true;                // false compiles every TRACE_* away
+        constexpr size_t MAX_EVENTS = 4096;           // 20 bytes each, PSRAM
+        constexpr uint8_t MAX_NAMES = 64;             // Distinct event names per capture
+        constexpr uint32_t DEFAULT_DURATION_MS = 2000;
+        constexpr uint32_t MAX_DURATION_MS = 30000;
+        constexpr uint32_t SYNC_INTERVAL_MS = 10;     // Cycle/time anchors on the loop core
     }
 
     // Serial/Debug
@@ -117,12 +473,82 @@ namespace Config
         constexpr const char *LOG_WIFI = "[WiFi]";
         constexpr const char *LOG_MQTT = "[MQTT]";
         constexpr const char *LOG_MQTT_CTRL = "[MQTT_CTRL]";
+        constexpr const char *LOG_MDNS = "[mDNS]";
         constexpr const char *LOG_WEB = "[WEB]";
         constexpr const char *LOG_BTN = "[BTN]";
         constexpr const char *LOG_ENCODER = "[ENC]";
         constexpr const char *LOG_CURRENT = "[CUR]";
         constexpr const char *LOG_MOTOR = "[MOTOR]";
         constexpr const char *LOG_DISPLAY = "[DISPLAY]";
+        constexpr const char *LOG_POWER = "[POWER]";
+        constexpr const char *LOG_OTA = "[OTA]";
+        constexpr const char *LOG_JSON = "[JSON]";
+        constexpr const char *LOG_MEMORY = "[MEM]";
+        constexpr const char *LOG_TRACE = "[TRACE]";
+        constexpr const char *LOG_TIME = "[TIME]";
+        constexpr const char *LOG_SEQUENCE = "[SEQ]";
+        constexpr const char *LOG_REPLAY = "[RPLY]";
+    }
+
+    // Logging (core/Log.h): calls above a module's level compile away
+    namespace Log
+    {
+        enum class Level : uint8_t
+        {
+            Off,
+            Error,
+            Warn,
+            Info,
+            Debug,
+            Trace
+        };
+
+        // Order matches the prefix table in Log.h
+        enum class Module : uint8_t
+        {
+            WiFi,
+            Mqtt,
+            MqttCtrl,
+            Mdns,
+            Web,
+            Button,
+            Encoder,
+            Current,
+            Motor,
+            Display,
+            Power,
+            Ota,
+            Json,
+            Memory,
+            Trace,
+            Time,
+            Sequence,
+            Replay,
+            COUNT
+        };
+
+        constexpr Level LEVEL = Debug::ENABLE_DEBUG_LOGS ? Level::Debug : Level::Info;
+
+        // Per-module overrides of LEVEL
+        constexpr Level moduleLevel(Module module)
+        {
+            switch (module)
+            {
+            case Module::Display:
+                return Level::Info; // Init steps only matter when bringing up a new panel
+            default:
+                return LEVEL;
+            }
+        }
+
+        constexpr size_t RING_SLOTS = 128;        // Power of two
+        constexpr size_t SLOT_SIZE = 64;          // Bytes per record, sequence word included
+        constexpr uint8_t TASK_PRIORITY = 1;      // Below loop and async_tcp
+        constexpr uint32_t TASK_STACK_SIZE = 4096;
+        constexpr uint8_t HISTORY_LINES = 32;     // Formatted lines kept for /api/log
+        constexpr size_t LINE_LENGTH = 128;
+        constexpr Level MQTT_LEVEL = Level::Warn; // Lines at or above this go to hub/log
+        constexpr uint8_t MQTT_MAX_PER_UPDATE = 4;
     }
 
     // System
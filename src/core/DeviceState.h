@@ -1,20 +1,196 @@
 #pragma once
+#ifdef ARDUINO
 #include <Arduino.h>
-#include <WiFi.h>
+#include <IPAddress.h>
+#else
+#include "Host.h"
+#endif
+#include "Config.h"
+#include "FixedString.h"
+
+enum class CurrentAlarm : uint8_t
+{
+    None,
+    Stall,
+    Jam,
+    Vibration
+};
+
+inline const char *currentAlarmName(CurrentAlarm alarm)
+{
+    switch (alarm)
+    {
+    case CurrentAlarm::Stall:
+        return "stall";
+    case CurrentAlarm::Jam:
+        return "jam";
+    case CurrentAlarm::Vibration:
+        return "vibration";
+    default:
+        return "none";
+    }
+}
+
+// Motion sequence engine phase
+enum class SequenceState : uint8_t
+{
+    Idle,
+    Running,
+    Paused,
+    Done,
+    Failed
+};
+
+inline const char *sequenceStateName(SequenceState state)
+{
+    switch (state)
+    {
+    case SequenceState::Running:
+        return "running";
+    case SequenceState::Paused:
+        return "paused";
+    case SequenceState::Done:
+        return "done";
+    case SequenceState::Failed:
+        return "failed";
+    default:
+        return "idle";
+    }
+}
+
+// Where a motor command came from, for latency accounting
+enum class CommandSource : uint8_t
+{
+    Mqtt,
+    Http,
+    Button,
+    COUNT
+};
+
+inline const char *commandSourceName(CommandSource source)
+{
+    switch (source)
+    {
+    case CommandSource::Mqtt:
+        return "mqtt";
+    case CommandSource::Http:
+        return "http";
+    case CommandSource::Button:
+        return "button";
+    default:
+        return "unknown";
+    }
+}
+
+// Per-axis data. Kept small and stored as one contiguous array so the
+// control pass walks each axis' fields in a single sequential sweep.
+struct AxisState
+{
+    // Control (touched every tick)
+    int motorSpeed = 0; // Per-mille of full scale
+    Config::Motor::StopMode stopMode = Config::Motor::STOP_MODE;
+    int64_t encoderPos = 0;
+    int16_t currentAdc = 0;
+
+    // Current analysis (per block)
+    float currentRms = 0;
+    float currentPeak = 0;
+    float vibrationHz = 0;
+    CurrentAlarm currentAlarm = CurrentAlarm::None;
+
+    // Load estimator (duty/velocity/current fusion)
+    float velocity = 0; // Encoder counts per second
+    float loadEstimate = 0;
+    bool loadStall = false;
+
+    // Homing (encoder index)
+    bool homingRequested = false;
+    bool homingActive = false;
+    bool homed = false;
+    int homingSpeed = 0;
+
+    // Command latency: stamped at ingress, closed by the motor output
+    bool commandPending = false;
+    CommandSource commandSource = CommandSource::Mqtt;
+    uint32_t commandIngressUs = 0;
+    uint32_t commandId = 0;       // Optional client tag, echoed back
+    uint32_t actuatedSeq = 0;     // Bumped on every closed command
+    uint32_t actuatedId = 0;
+    uint32_t actuatedLatencyUs = 0;
+
+    // Call right after changing motorSpeed on behalf of an input
+    void stampCommand(CommandSource source, uint32_t ingressUs, uint32_t id = 0)
+    {
+        commandPending = true;
+        commandSource = source;
+        commandIngressUs = ingressUs;
+        commandId = id;
+    }
+};
+
+// Raw sensor readings of one control pass, before any processing. The
+// control pass reads them from hardware or, during a replay, from the
+// recording (core/Replay.h).
+struct AxisInputs
+{
+    int64_t encoderCount = 0; // PCNT count, before the home offset
+    int64_t indexCount = 0;   // Count latched by the index pulse
+    bool indexLatched = false;
+    int16_t currentAdc = 0;
+};
 
 struct DeviceState
 {
     // Network
     bool wifiConnected = false;
     bool apActive = false;
-    String savedSsid = "";
+    FixedString<32> savedSsid;
     IPAddress localIP;
     bool mqttConnected = false;
+    bool setupModeRequested = false; // Setup button, consumed by WiFiManager
 
-    // Sensors
-    int32_t encoderPos = 0;
-    int16_t currentAdc = 0;
+    // Store-and-forward backlog (TelemetryStore, loop task)
+    uint32_t backlogRecords = 0;
+    uint32_t backlogBytes = 0;      // Ring and flash
+    uint32_t backlogFlashBytes = 0;
+    uint32_t backlogOldestMs = 0;   // Capture time of the oldest pending record
+    uint32_t backlogDropped = 0;
+    uint32_t backlogReplayed = 0;
+
+    // Motion (axis 0 is the legacy single-motor channel)
+    AxisState axes[Config::Axes::COUNT];
+    uint32_t controlTickUs = 0;
+    Config::Stall::Reaction stallReaction = Config::Stall::DEFAULT_REACTION;
+
+    // Sequence progress (SequenceEngine, control pass)
+    SequenceState sequenceState = SequenceState::Idle;
+    uint16_t sequenceStep = 0;
+    uint32_t sequenceLoops = 0;
+
+    bool anyMotorRunning() const
+    {
+        for (const AxisState &axis : axes)
+        {
+            if (axis.motorSpeed != 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Maintenance
+    bool otaActive = false;
+
+    // Memory (internal heap unless noted)
+    uint32_t heapFree = 0;
+    uint32_t heapMinFree = 0;
+    uint32_t heapLargestBlock = 0;
+    uint8_t heapFragmentation = 0; // %
+    uint32_t psramFree = 0;
+    uint32_t minStackFree = 0;     // Bytes, tightest task
+    bool memoryLow = false;
 
-    // Motor
-    int motorSpeed = 0;
+    // Power
+    bool powerIdle = false;
+    uint16_t avgCurrentMa = 0;
+    uint32_t wakeLatencyUs = 0;
 };
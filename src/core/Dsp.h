@@ -0,0 +1,191 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <string.h>
+#endif
+#include <math.h>
+
+// Block signal kernels for current analysis. The reference versions are plain
+// C++ and run anywhere; on the ESP32-S3 the esp-dsp versions use the PIE
+// vector unit (dsps_*_aes3). Both produce the same BlockStats/spectrum.
+#if __has_include(<esp_dsp.h>)
+#include <esp_dsp.h>
+#define DSP_HAS_ESP_DSP 1
+#else
+#define DSP_HAS_ESP_DSP 0
+#endif
+
+namespace Dsp
+{
+    struct BlockStats
+    {
+        float mean = 0; // DC level
+        float rms = 0;  // AC RMS around the mean
+        float peak = 0; // Largest excursion from the mean
+    };
+
+    struct Spectrum
+    {
+        float dominantHz = 0;
+        float bandRatio = 0; // Share of AC energy inside the band of interest
+    };
+
+    // Fills the Hann window (reference formula, matches dsps_wind_hann_f32)
+    void hannWindow(float *window, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            window[i] = 0.5f * (1.0f - cosf(2.0f * (float)M_PI * i / (n - 1)));
+        }
+    }
+
+    // ---- Reference implementation ------------------------------------------
+
+    // Writes the zero-mean signal to `centered`
+    BlockStats statsReference(const float *x, float *centered, size_t n)
+    {
+        BlockStats s;
+        float sum = 0;
+        for (size_t i = 0; i < n; i++)
+            sum += x[i];
+        s.mean = sum / n;
+
+        float energy = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            float v = x[i] - s.mean;
+            centered[i] = v;
+            energy += v * v;
+            if (fabsf(v) > s.peak)
+                s.peak = fabsf(v);
+        }
+        s.rms = sqrtf(energy / n);
+        return s;
+    }
+
+    // In-place radix-2 complex FFT on interleaved re/im data, n = power of two
+    void fftReference(float *data, size_t n)
+    {
+        for (size_t i = 1, j = 0; i < n; i++)
+        {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j ^= bit;
+            if (i < j)
+            {
+                float tr = data[2 * i], ti = data[2 * i + 1];
+                data[2 * i] = data[2 * j];
+                data[2 * i + 1] = data[2 * j + 1];
+                data[2 * j] = tr;
+                data[2 * j + 1] = ti;
+            }
+        }
+
+        for (size_t len = 2; len <= n; len <<= 1)
+        {
+            float angle = -2.0f * (float)M_PI / len;
+            float wr = cosf(angle), wi = sinf(angle);
+            for (size_t i = 0; i < n; i += len)
+            {
+                float cr = 1.0f, ci = 0.0f;
+                for (size_t k = 0; k < len / 2; k++)
+                {
+                    float *a = &data[2 * (i + k)];
+                    float *b = &data[2 * (i + k + len / 2)];
+                    float br = b[0] * cr - b[1] * ci;
+                    float bi = b[0] * ci + b[1] * cr;
+                    b[0] = a[0] - br;
+                    b[1] = a[1] - bi;
+                    a[0] += br;
+                    a[1] += bi;
+                    float nr = cr * wr - ci * wi;
+                    ci = cr * wi + ci * wr;
+                    cr = nr;
+                }
+            }
+        }
+    }
+
+    // ---- esp-dsp implementation --------------------------------------------
+
+#if DSP_HAS_ESP_DSP
+    bool initAccelerated(size_t maxFft)
+    {
+        return dsps_fft2r_init_fc32(NULL, maxFft) == ESP_OK;
+    }
+
+    // `ones` is a block of 1.0f used to sum with the vector dot product
+    BlockStats statsAccelerated(const float *x, float *centered, const float *ones, size_t n)
+    {
+        BlockStats s;
+        float sum = 0;
+        dsps_dotprod_f32(x, ones, &sum, n);
+        s.mean = sum / n;
+
+        dsps_addc_f32(x, centered, n, -s.mean, 1, 1);
+
+        float energy = 0;
+        dsps_dotprod_f32(centered, centered, &energy, n);
+        s.rms = sqrtf(energy / n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (fabsf(centered[i]) > s.peak)
+                s.peak = fabsf(centered[i]);
+        }
+        return s;
+    }
+
+    void fftAccelerated(float *data, size_t n)
+    {
+        dsps_fft2r_fc32(data, n);
+        dsps_bit_rev_fc32(data, n);
+    }
+#endif
+
+    // ---- Shared helpers ----------------------------------------------------
+
+    // Loads window * signal into interleaved complex form (imaginary = 0)
+    void loadWindowed(const float *centered, const float *window, float *data, size_t n)
+    {
+#if DSP_HAS_ESP_DSP
+        memset(data, 0, 2 * n * sizeof(float));
+        dsps_mul_f32(centered, window, data, n, 1, 1, 2);
+#else
+        for (size_t i = 0; i < n; i++)
+        {
+            data[2 * i] = centered[i] * window[i];
+            data[2 * i + 1] = 0;
+        }
+#endif
+    }
+
+    // Power spectrum summary over bins 1..n/2 (DC excluded)
+    Spectrum summarize(const float *data, size_t n, float sampleRateHz, float bandLowHz, float bandHighHz)
+    {
+        Spectrum sp;
+        float binHz = sampleRateHz / n;
+        float total = 0, band = 0, best = 0;
+
+        for (size_t k = 1; k < n / 2; k++)
+        {
+            float p = data[2 * k] * data[2 * k] + data[2 * k + 1] * data[2 * k + 1];
+            float hz = k * binHz;
+            total += p;
+            if (hz >= bandLowHz && hz <= bandHighHz)
+                band += p;
+            if (p > best)
+            {
+                best = p;
+                sp.dominantHz = hz;
+            }
+        }
+
+        sp.bandRatio = total > 0 ? band / total : 0;
+        return sp;
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stdio.h>
+#endif
+#include <stdarg.h>
+#include <string.h>
+
+// Inline character buffer with String-like calls for state that is copied or
+// formatted every loop. Never allocates; text beyond N characters is cut off.
+template <size_t N>
+class FixedString
+{
+public:
+    FixedString() { buffer[0] = '\0'; }
+    FixedString(const char *text) { assign(text); }
+
+    static constexpr size_t capacity() { return N; }
+
+    const char *c_str() const { return buffer; }
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    void clear()
+    {
+        len = 0;
+        buffer[0] = '\0';
+    }
+
+    FixedString &assign(const char *text, size_t count = SIZE_MAX)
+    {
+        len = 0;
+        if (text)
+        {
+            while (len < N && len < count && text[len])
+            {
+                buffer[len] = text[len];
+                len++;
+            }
+        }
+        buffer[len] = '\0';
+        return *this;
+    }
+
+    FixedString &operator=(const char *text) { return assign(text); }
+
+    template <size_t M>
+    FixedString &operator=(const FixedString<M> &other) { return assign(other.c_str()); }
+
+    FixedString &append(const char *text)
+    {
+        while (text && *text && len < N)
+            buffer[len++] = *text++;
+        buffer[len] = '\0';
+        return *this;
+    }
+
+    FixedString &operator+=(const char *text) { return append(text); }
+
+    // Replaces the contents; returns false if the output was truncated
+    bool format(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buffer, N + 1, fmt, args);
+        va_end(args);
+        len = n < 0 ? 0 : (n > (int)N ? N : n);
+        return n >= 0 && n <= (int)N;
+    }
+
+    bool operator==(const char *text) const { return strcmp(buffer, text ? text : "") == 0; }
+    bool operator!=(const char *text) const { return !(*this == text); }
+
+    template <size_t M>
+    bool operator==(const FixedString<M> &other) const { return *this == other.c_str(); }
+    template <size_t M>
+    bool operator!=(const FixedString<M> &other) const { return !(*this == other.c_str()); }
+
+private:
+    char buffer[N + 1];
+    size_t len = 0;
+};
+
+// Formatting helpers for values that otherwise go through String
+namespace Fmt
+{
+    // Dotted quad, "0.0.0.0" style, from an IPAddress or anything indexed
+    // the same way
+    template <typename Address>
+    FixedString<15> ip(const Address &address)
+    {
+        FixedString<15> out;
+        out.format("%u.%u.%u.%u", address[0], address[1], address[2], address[3]);
+        return out;
+    }
+
+    // Cuts `text` to `width` columns, marking the cut with "..."
+    template <size_t N>
+    FixedString<N> ellipsize(const char *text, size_t width)
+    {
+        FixedString<N> out;
+        size_t n = strlen(text);
+        if (n <= width || width < 3)
+            return out.assign(text, width);
+        out.assign(text, width - 3);
+        out.append("...");
+        return out;
+    }
+
+#ifdef ARDUINO
+    // Writes `text` as a quoted JSON string
+    inline void jsonString(Print &out, const char *text)
+    {
+        out.write('"');
+        for (; *text; text++)
+        {
+            char c = *text;
+            if (c == '"' || c == '\\')
+            {
+                out.write('\\');
+                out.write(c);
+            }
+            else if ((uint8_t)c < 0x20)
+            {
+                out.printf("\\u%04x", c);
+            }
+            else
+            {
+                out.write(c);
+            }
+        }
+        out.write('"');
+    }
+#endif
+
+    // hh:mm:ss from a seconds count
+    inline FixedString<16> duration(unsigned long seconds)
+    {
+        FixedString<16> out;
+        out.format("%02lu:%02lu:%02lu", seconds / 3600, (seconds % 3600) / 60, seconds % 60);
+        return out;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// Host stand-ins for the few Arduino, FreeRTOS and esp_timer calls that the
+// otherwise hardware-free modules make (Log, Timebase, SequenceEngine,
+// Replay, JsonArena, ChangeTracker), so they also compile into the native
+// tests (test/). Only
+// included when ARDUINO is not defined.
+//
+// The clock is fake: esp_timer_get_time(), micros() and millis() read
+// Host::clockUs, which tests set and advance themselves.
+#ifdef ARDUINO
+#error "core/Host.h is for host builds only"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+using std::max;
+using std::min;
+
+template <typename T, typename L, typename H>
+constexpr T constrain(T value, L low, H high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+#define IRAM_ATTR
+
+namespace Host
+{
+    inline int64_t clockUs = 0;
+}
+
+inline int64_t esp_timer_get_time() { return Host::clockUs; }
+inline uint32_t micros() { return (uint32_t)Host::clockUs; }
+inline uint32_t millis() { return (uint32_t)(Host::clockUs / 1000); }
+
+// Critical sections become a spin lock; the native tests run on threads
+struct portMUX_TYPE
+{
+    std::atomic_flag locked = ATOMIC_FLAG_INIT;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED \
+    {                                \
+    }
+
+inline void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    while (mux->locked.test_and_set(std::memory_order_acquire))
+    {
+    }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *mux) { mux->locked.clear(std::memory_order_release); }
+
+// Every capability is plain heap on the host
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+inline void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void *heap_caps_realloc(void *ptr, size_t size, uint32_t) { return realloc(ptr, size); }
+inline void heap_caps_free(void *ptr) { free(ptr); }
+inline bool psramFound() { return false; }
+
+// DeviceState carries the address for the display and /api/status only
+struct IPAddress
+{
+    uint8_t octets[4] = {};
+    uint8_t operator[](int i) const { return octets[i]; }
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#else
+#include "Host.h"
+#endif
+#include <ArduinoJson.h>
+#include "Config.h"
+#include "Log.h"
+
+// Bump allocator for ArduinoJson documents, backed by one PSRAM block per
+// owner (web server, MQTT controller). Documents live inside a Scope; when the
+// scope closes the arena rewinds to where it started, so nothing a handler
+// allocated ever reaches the internal heap. Each arena is used from a single
+// task only (async_tcp for the web server, the loop task for MQTT).
+//
+// Usage - the Scope must be declared before the document:
+//     JsonArena::Scope scope(arena, "status");
+//     JsonDocument doc(&arena);
+class JsonArena : public ArduinoJson::Allocator
+{
+public:
+    struct HandlerStats
+    {
+        const char *name = nullptr;
+        uint32_t calls = 0;
+        uint32_t peak = 0;      // Bytes used by one scope, high water
+        uint32_t overflows = 0; // Scopes that spilled to the heap
+    };
+
+    class Scope
+    {
+    public:
+        Scope(JsonArena &arena, const char *handler)
+            : arena(arena), stats(arena.statsFor(handler)), mark(arena.used),
+              outerHighWater(arena.highWater), spilled(arena.spilled)
+        {
+            arena.highWater = mark;
+        }
+        ~Scope() { arena.rewind(*this); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        JsonArena &arena;
+        HandlerStats *stats;
+        size_t mark;
+        size_t outerHighWater;
+        uint32_t spilled;
+
+        friend class JsonArena;
+    };
+
+    bool begin(const char *name, size_t size);
+
+    const char *name() const { return arenaName; }
+    size_t capacity() const { return size; }
+    size_t peak() const { return peakUsed; }
+    bool inPsram() const { return psram; }
+
+    // Appends this arena and its handler table to `out`
+    void report(JsonObject out) const;
+
+    // All arenas created so far, for the instrumentation endpoint
+    static JsonArena *const *all() { return registry; }
+    static uint8_t count() { return registered; }
+
+    void *allocate(size_t bytes) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t bytes) override;
+
+private:
+    // Every block is prefixed with its size so reallocate() can copy it
+    struct Header
+    {
+        uint32_t size;
+        uint32_t reserved;
+    };
+    static constexpr size_t ALIGN = 8;
+
+    const char *arenaName = "";
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    size_t used = 0;
+    size_t peakUsed = 0;
+    size_t highWater = 0;    // Peak of `used` since the innermost scope opened
+    uint8_t *last = nullptr; // Most recent block, can grow or free in place
+    bool psram = false;
+    uint32_t spilled = 0;    // Heap fallbacks since boot
+
+    HandlerStats handlers[Config::Json::MAX_HANDLERS];
+    uint8_t handlerCount = 0;
+
+    static JsonArena *registry[Config::Json::MAX_ARENAS];
+    static uint8_t registered;
+
+    bool owns(const void *ptr) const { return ptr >= base && ptr < base + size; }
+    static size_t blockSize(const void *ptr) { return ((const Header *)ptr - 1)->size; }
+
+    HandlerStats *statsFor(const char *handler);
+    void grew();
+    void rewind(const Scope &scope);
+    void *spill(size_t bytes);
+};
+
+JsonArena *JsonArena::registry[Config::Json::MAX_ARENAS] = {};
+uint8_t JsonArena::registered = 0;
+
+bool JsonArena::begin(const char *name, size_t bytes)
+{
+    arenaName = name;
+
+    base = psramFound() ? (uint8_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : nullptr;
+    psram = base != nullptr;
+    if (!base)
+        base = (uint8_t *)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+
+    size = base ? bytes : 0;
+    used = 0;
+    last = nullptr;
+
+    if (registered < Config::Json::MAX_ARENAS)
+        registry[registered++] = this;
+
+    LOG_I(Json, "Arena '%s': %u bytes in %s", name, (unsigned)size,
+          psram ? "PSRAM" : (base ? "internal RAM" : "nothing (heap fallback)"));
+    return base != nullptr;
+}
+
+void *JsonArena::allocate(size_t bytes)
+{
+    size_t start = (used + ALIGN - 1) & ~(ALIGN - 1);
+    size_t end = start + sizeof(Header) + bytes;
+    if (!base || end > size)
+        return spill(bytes);
+
+    Header *header = (Header *)(base + start);
+    header->size = bytes;
+    last = (uint8_t *)(header + 1);
+
+    used = end;
+    grew();
+    return last;
+}
+
+void JsonArena::deallocate(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    if (!owns(ptr))
+    {
+        heap_caps_free(ptr);
+        return;
+    }
+
+    // Only the newest block is actually returned; the rest goes when the scope closes
+    if (ptr == last)
+    {
+        used = (uint8_t *)ptr - sizeof(Header) - base;
+        last = nullptr;
+    }
+}
+
+void *JsonArena::reallocate(void *ptr, size_t bytes)
+{
+    if (!ptr)
+        return allocate(bytes);
+
+    if (!owns(ptr))
+        return heap_caps_realloc(ptr, bytes, MALLOC_CAP_8BIT);
+
+    // Newest block grows or shrinks in place (string building, pool shrink-to-fit)
+    if (ptr == last && (uint8_t *)ptr - base + bytes <= size)
+    {
+        ((Header *)ptr - 1)->size = bytes;
+        used = (uint8_t *)ptr - base + bytes;
+        grew();
+        return ptr;
+    }
+
+    size_t old = blockSize(ptr);
+    if (bytes <= old)
+        return ptr;
+
+    void *moved = allocate(bytes);
+    if (moved)
+        memcpy(moved, ptr, old);
+    return moved;
+}
+
+void *JsonArena::spill(size_t bytes)
+{
+    spilled++;
+    void *ptr = psram ? heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : nullptr;
+    return ptr ? ptr : heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+}
+
+JsonArena::HandlerStats *JsonArena::statsFor(const char *handler)
+{
+    // Handler names are string literals, so the pointer identifies them
+    for (uint8_t i = 0; i < handlerCount; i++)
+    {
+        if (handlers[i].name == handler)
+            return &handlers[i];
+    }
+
+    if (handlerCount == Config::Json::MAX_HANDLERS)
+        return nullptr;
+
+    handlers[handlerCount].name = handler;
+    return &handlers[handlerCount++];
+}
+
+void JsonArena::grew()
+{
+    if (used > highWater)
+        highWater = used;
+    if (used > peakUsed)
+        peakUsed = used;
+}
+
+void JsonArena::rewind(const Scope &scope)
+{
+    HandlerStats *stats = scope.stats;
+    if (stats)
+    {
+        stats->calls++;
+        if (highWater - scope.mark > stats->peak)
+            stats->peak = highWater - scope.mark;
+        if (spilled != scope.spilled)
+        {
+            if (stats->overflows++ == 0)
+                LOG_W(Json, "Arena '%s' overflowed in '%s', raise its size", arenaName, stats->name);
+        }
+    }
+
+    used = scope.mark;
+    last = nullptr;
+    if (scope.outerHighWater > highWater)
+        highWater = scope.outerHighWater;
+}
+
+void JsonArena::report(JsonObject out) const
+{
+    out["name"] = arenaName;
+    out["capacity"] = size;
+    out["peak"] = peakUsed;
+    out["psram"] = psram;
+    out["spilled"] = spilled;
+
+    JsonArray list = out["handlers"].to<JsonArray>();
+    for (uint8_t i = 0; i < handlerCount; i++)
+    {
+        JsonObject h = list.add<JsonObject>();
+        h["name"] = handlers[i].name;
+        h["calls"] = handlers[i].calls;
+        h["peak"] = handlers[i].peak;
+        h["overflows"] = handlers[i].overflows;
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "DeviceState.h"
+#include "Config.h"
+
+// Command-to-PWM latency histograms, one per command source. Buckets are
+// powers of two starting at BASE_US, so recording is a shift and an add.
+// Written by the control pass (loop task), read by the web/MQTT reporters.
+class LatencyTracker
+{
+public:
+    static constexpr uint8_t BUCKETS = Config::Latency::HISTOGRAM_BUCKETS;
+    static constexpr uint32_t BASE_US = Config::Latency::HISTOGRAM_BASE_US;
+
+    // Closes the axis' pending command at `nowUs` (just after the PWM write)
+    static void close(AxisState &axis, uint32_t nowUs);
+
+    static void report(JsonObject out);
+    // One source's histogram, as found under its name in report()
+    static void report(JsonObject out, CommandSource source);
+
+private:
+    struct Histogram
+    {
+        uint32_t count = 0;
+        uint32_t minUs = UINT32_MAX;
+        uint32_t maxUs = 0;
+        uint64_t sumUs = 0;
+        uint32_t buckets[BUCKETS] = {};
+    };
+
+    static portMUX_TYPE mux;
+    static Histogram histograms[(uint8_t)CommandSource::COUNT];
+
+    static uint8_t bucketFor(uint32_t us);
+    static uint32_t percentile(const Histogram &h, uint8_t pct);
+    static void write(JsonObject out, const Histogram &h);
+};
+
+portMUX_TYPE LatencyTracker::mux = portMUX_INITIALIZER_UNLOCKED;
+LatencyTracker::Histogram LatencyTracker::histograms[(uint8_t)CommandSource::COUNT];
+
+uint8_t LatencyTracker::bucketFor(uint32_t us)
+{
+    uint8_t bucket = 0;
+    for (uint32_t bound = BASE_US; us >= bound && bucket < BUCKETS - 1; bound <<= 1)
+        bucket++;
+    return bucket;
+}
+
+void LatencyTracker::close(AxisState &axis, uint32_t nowUs)
+{
+    uint32_t latency = nowUs - axis.commandIngressUs;
+
+    portENTER_CRITICAL(&mux);
+    Histogram &h = histograms[(uint8_t)axis.commandSource];
+    h.count++;
+    h.sumUs += latency;
+    if (latency < h.minUs)
+        h.minUs = latency;
+    if (latency > h.maxUs)
+        h.maxUs = latency;
+    h.buckets[bucketFor(latency)]++;
+    portEXIT_CRITICAL(&mux);
+
+    axis.commandPending = false;
+    axis.actuatedId = axis.commandId;
+    axis.actuatedLatencyUs = latency;
+    axis.actuatedSeq++;
+}
+
+// Upper bound of the bucket holding the pct-th percentile
+uint32_t LatencyTracker::percentile(const Histogram &h, uint8_t pct)
+{
+    if (h.count == 0)
+        return 0;
+
+    uint32_t target = (uint64_t)h.count * pct / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++)
+    {
+        seen += h.buckets[i];
+        if (seen > target)
+            return i == BUCKETS - 1 ? h.maxUs : BASE_US << i;
+    }
+    return h.maxUs;
+}
+
+void LatencyTracker::report(JsonObject out)
+{
+    Histogram copy[(uint8_t)CommandSource::COUNT];
+    portENTER_CRITICAL(&mux);
+    memcpy(copy, histograms, sizeof(copy));
+    portEXIT_CRITICAL(&mux);
+
+    out["bucketBaseUs"] = BASE_US;
+
+    for (uint8_t s = 0; s < (uint8_t)CommandSource::COUNT; s++)
+        write(out[commandSourceName((CommandSource)s)].to<JsonObject>(), copy[s]);
+}
+
+void LatencyTracker::report(JsonObject out, CommandSource source)
+{
+    Histogram copy;
+    portENTER_CRITICAL(&mux);
+    copy = histograms[(uint8_t)source];
+    portEXIT_CRITICAL(&mux);
+
+    out["bucketBaseUs"] = BASE_US;
+    write(out, copy);
+}
+
+void LatencyTracker::write(JsonObject src, const Histogram &h)
+{
+    src["count"] = h.count;
+    if (h.count == 0)
+        return;
+
+    src["minUs"] = h.minUs;
+    src["avgUs"] = (uint32_t)(h.sumUs / h.count);
+    src["p50Us"] = percentile(h, 50);
+    src["p99Us"] = percentile(h, 99);
+    src["maxUs"] = h.maxUs;
+
+    JsonArray buckets = src["buckets"].to<JsonArray>();
+    for (uint8_t i = 0; i < BUCKETS; i++)
+        buckets.add(h.buckets[i]);
+}
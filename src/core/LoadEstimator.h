@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include "Config.h"
+
+// Estimates motor load from commanded duty, encoder velocity and current.
+// A brushed DC motor at speed s should turn near NO_LOAD_CPS_PER_SPEED * |s|
+// (the motor output already compensates the driver dead-band);
+// current above the no-load level is proportional to load torque. A stall is
+// a large speed deficit together with high current, held for STALL_CONFIRM_MS.
+// No hardware access: feed it recorded or simulated traces on the host as is.
+class LoadEstimator
+{
+public:
+    void reset();
+    void update(int duty, int64_t position, float currentAdc, uint32_t nowUs);
+
+    float velocity() const { return filteredVelocity; }
+    float expectedVelocity() const { return expected; }
+    float speedRatio() const { return ratio; }
+    float load() const { return loadUnits; }
+    bool stalled() const { return stall; }
+
+private:
+    bool primed = false;
+    int64_t lastPosition = 0;
+    uint32_t lastUs = 0;
+    int lastDuty = 0;
+    uint32_t dutyChangedUs = 0;
+    uint32_t suspectSinceUs = 0;
+    bool suspect = false;
+
+    float filteredVelocity = 0;
+    float filteredCurrent = 0;
+    float expected = 0;
+    float ratio = 1;
+    float loadUnits = 0;
+    bool stall = false;
+
+    static float smooth(float prev, float value, float dtMs, float tauMs)
+    {
+        float alpha = dtMs / (tauMs + dtMs);
+        return prev + alpha * (value - prev);
+    }
+};
+
+void LoadEstimator::reset()
+{
+    primed = false;
+    suspect = false;
+    stall = false;
+    filteredVelocity = 0;
+    filteredCurrent = 0;
+    ratio = 1;
+    loadUnits = 0;
+}
+
+void LoadEstimator::update(int duty, int64_t position, float currentAdc, uint32_t nowUs)
+{
+    if (!primed)
+    {
+        primed = true;
+        lastPosition = position;
+        lastUs = nowUs;
+        lastDuty = duty;
+        dutyChangedUs = nowUs;
+        filteredCurrent = currentAdc - Config::Stall::CURRENT_ZERO_ADC;
+        return;
+    }
+
+    uint32_t dtUs = nowUs - lastUs;
+    if (dtUs == 0)
+        return;
+
+    float dtMs = dtUs / 1000.0f;
+    float rawVelocity = (position - lastPosition) * 1e6f / dtUs;
+    lastPosition = position;
+    lastUs = nowUs;
+
+    filteredVelocity = smooth(filteredVelocity, rawVelocity, dtMs, Config::Stall::VELOCITY_FILTER_MS);
+    filteredCurrent = smooth(filteredCurrent, currentAdc - Config::Stall::CURRENT_ZERO_ADC, dtMs, Config::Stall::CURRENT_FILTER_MS);
+
+    if (duty != lastDuty)
+    {
+        lastDuty = duty;
+        dutyChangedUs = nowUs;
+        suspect = false;
+        stall = false;
+    }
+
+    int magnitude = duty < 0 ? -duty : duty;
+    float effective = (float)magnitude;
+    expected = (duty < 0 ? -1.0f : 1.0f) * effective * Config::Stall::NO_LOAD_CPS_PER_SPEED;
+
+    ratio = expected != 0 ? filteredVelocity / expected : 1.0f;
+    loadUnits = fmaxf(0.0f, filteredCurrent - Config::Stall::NO_LOAD_CURRENT_ADC) * Config::Stall::TORQUE_PER_ADC;
+
+    bool driven = effective > 0 && nowUs - dutyChangedUs >= Config::Stall::SPINUP_GRACE_MS * 1000UL;
+    bool blocked = driven && ratio < Config::Stall::STALL_SPEED_RATIO &&
+                   filteredCurrent > Config::Stall::STALL_CURRENT_ADC;
+
+    if (!blocked)
+    {
+        suspect = false;
+        stall = false;
+    }
+    else if (!suspect)
+    {
+        suspect = true;
+        suspectSinceUs = nowUs;
+    }
+    else if (nowUs - suspectSinceUs >= Config::Stall::STALL_CONFIRM_MS * 1000UL)
+    {
+        stall = true;
+    }
+}
@@ -0,0 +1,568 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include "Host.h"
+#endif
+#include <atomic>
+#include <type_traits>
+#include "Config.h"
+#include "FixedString.h"
+
+// Leveled, per-module logging. A call below the module's compile-time level
+// is removed entirely, arguments included (the macros wrap `if constexpr`).
+// Enabled calls only pack the format pointer and the raw arguments into a
+// fixed-size binary record in a lock-free MPSC ring; a low-priority task
+// formats them and feeds serial, the /api/log history and hub/log.
+//
+//     LOG_I(Mqtt, "Broker started on port %d", port);
+//
+// Format strings must be literals (only the pointer is stored). String
+// arguments are copied into the record and cut to fit the slot.
+//
+// On the host (native tests) there is no drain task: flush() formats
+// whatever is queued into the history, and nothing is printed.
+#define LOG_AT(module, level, ...)                                                               \
+    do                                                                                           \
+    {                                                                                            \
+        if constexpr (Log::enabled(Log::Module::module, Log::Level::level))                      \
+            Log::write(Log::Module::module, Log::Level::level, __VA_ARGS__);                     \
+    } while (0)
+
+#define LOG_E(module, ...) LOG_AT(module, Error, __VA_ARGS__)
+#define LOG_W(module, ...) LOG_AT(module, Warn, __VA_ARGS__)
+#define LOG_I(module, ...) LOG_AT(module, Info, __VA_ARGS__)
+#define LOG_D(module, ...) LOG_AT(module, Debug, __VA_ARGS__)
+#define LOG_T(module, ...) LOG_AT(module, Trace, __VA_ARGS__)
+
+namespace Log
+{
+    using Level = Config::Log::Level;
+    using Module = Config::Log::Module;
+
+    constexpr bool enabled(Module module, Level level)
+    {
+        return level != Level::Off && (uint8_t)level <= (uint8_t)Config::Log::moduleLevel(module);
+    }
+
+    struct Stats
+    {
+        uint32_t written = 0;   // Records accepted into the ring
+        uint32_t dropped = 0;   // Ring full
+        uint32_t truncated = 0; // Arguments cut to fit a slot
+    };
+
+    struct Line
+    {
+        uint32_t seq;
+        int64_t timeUs; // Timebase::nowUs() at the call
+        Level level;
+        Module module;
+        FixedString<Config::Log::LINE_LENGTH> text;
+    };
+
+    void begin();
+    void flush(uint32_t timeoutMs = 100);
+    Stats stats();
+
+    // Copies history lines with seq > `since`; returns how many were copied
+    size_t history(uint32_t since, Line *out, size_t capacity);
+    uint32_t lastSeq();
+
+    const char *levelName(Level level);
+
+    namespace detail
+    {
+        enum class Arg : uint8_t
+        {
+            I32,
+            U32,
+            I64,
+            U64,
+            F64,
+            Str,
+            Ptr
+        };
+
+        struct Header
+        {
+            int64_t timeUs;
+            const char *fmt;
+            Module module;
+            Level level;
+            uint8_t size; // Payload bytes after the header
+            uint8_t argc;
+        };
+
+        constexpr size_t PAYLOAD = Config::Log::SLOT_SIZE - sizeof(uint32_t);
+        static_assert((Config::Log::RING_SLOTS & (Config::Log::RING_SLOTS - 1)) == 0, "Log ring size must be a power of two");
+        static_assert(PAYLOAD > sizeof(Header) + 8, "Log slot too small");
+
+        struct Slot
+        {
+            std::atomic<uint32_t> seq;
+            uint8_t data[PAYLOAD];
+        };
+
+        // Packs one record on the caller's stack
+        class Packer
+        {
+        public:
+            uint8_t buffer[PAYLOAD];
+            size_t used = sizeof(Header);
+            bool truncated = false;
+            uint8_t argc = 0;
+
+            template <typename T>
+            void put(T value)
+            {
+                using U = std::decay_t<T>;
+                if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>)
+                    putString(value);
+                else if constexpr (std::is_floating_point_v<U>)
+                    putRaw(Arg::F64, (double)value);
+                else if constexpr (std::is_enum_v<U>)
+                    put((std::underlying_type_t<U>)value);
+                else if constexpr (std::is_integral_v<U> && sizeof(U) <= 4)
+                {
+                    if constexpr (std::is_signed_v<U>)
+                        putRaw(Arg::I32, (int32_t)value);
+                    else
+                        putRaw(Arg::U32, (uint32_t)value);
+                }
+                else if constexpr (std::is_integral_v<U>)
+                {
+                    if constexpr (std::is_signed_v<U>)
+                        putRaw(Arg::I64, (int64_t)value);
+                    else
+                        putRaw(Arg::U64, (uint64_t)value);
+                }
+                else if constexpr (std::is_pointer_v<U>)
+                    putRaw(Arg::Ptr, (uintptr_t)value);
+                else
+                    static_assert(std::is_pointer_v<U>, "Unsupported log argument type");
+            }
+
+        private:
+            template <typename V>
+            void putRaw(Arg tag, V value)
+            {
+                if (used + 1 + sizeof(V) > PAYLOAD)
+                {
+                    truncated = true;
+                    return;
+                }
+                buffer[used++] = (uint8_t)tag;
+                memcpy(buffer + used, &value, sizeof(V));
+                used += sizeof(V);
+                argc++;
+            }
+
+            void putString(const char *text)
+            {
+                if (used + 2 > PAYLOAD)
+                {
+                    truncated = true;
+                    return;
+                }
+                buffer[used++] = (uint8_t)Arg::Str;
+                if (!text)
+                    text = "(null)";
+                while (*text && used < PAYLOAD - 1)
+                    buffer[used++] = *text++;
+                if (*text)
+                    truncated = true;
+                buffer[used++] = '\0';
+                argc++;
+            }
+        };
+
+        void push(Packer &packer, Module module, Level level, const char *fmt);
+    }
+
+    template <typename... Args>
+    void write(Module module, Level level, const char *fmt, Args... args)
+    {
+        detail::Packer packer;
+        (packer.put(args), ...);
+        detail::push(packer, module, level, fmt);
+    }
+}
+
+namespace Log
+{
+    namespace detail
+    {
+        Slot slots[Config::Log::RING_SLOTS];
+        std::atomic<uint32_t> enqueuePos{0};
+        uint32_t dequeuePos = 0; // Drain task only
+
+        std::atomic<uint32_t> written{0};
+        std::atomic<uint32_t> dropped{0};
+        std::atomic<uint32_t> truncated{0};
+        std::atomic<uint32_t> printed{0};
+
+#ifdef ARDUINO
+        TaskHandle_t drainTask = nullptr;
+#endif
+
+        portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+        Line historyLines[Config::Log::HISTORY_LINES];
+        uint32_t historySeq = 0;
+
+        const char *const prefixes[(uint8_t)Module::COUNT] = {
+            Config::Debug::LOG_WIFI,
+            Config::Debug::LOG_MQTT,
+            Config::Debug::LOG_MQTT_CTRL,
+            Config::Debug::LOG_MDNS,
+            Config::Debug::LOG_WEB,
+            Config::Debug::LOG_BTN,
+            Config::Debug::LOG_ENCODER,
+            Config::Debug::LOG_CURRENT,
+            Config::Debug::LOG_MOTOR,
+            Config::Debug::LOG_DISPLAY,
+            Config::Debug::LOG_POWER,
+            Config::Debug::LOG_OTA,
+            Config::Debug::LOG_JSON,
+            Config::Debug::LOG_MEMORY,
+            Config::Debug::LOG_TRACE,
+            Config::Debug::LOG_TIME,
+            Config::Debug::LOG_SEQUENCE,
+            Config::Debug::LOG_REPLAY,
+        };
+
+        // Vyukov bounded queue: producers claim a slot with one CAS and publish it
+        // through its sequence word. Sequences are stored relative to the slot
+        // index so the zero-initialised ring is valid before begin() (static ctors).
+        uint32_t sequence(uint32_t index)
+        {
+            return slots[index].seq.load(std::memory_order_acquire) + index;
+        }
+
+        void publish(uint32_t index, uint32_t seq)
+        {
+            slots[index].seq.store(seq - index, std::memory_order_release);
+        }
+
+        void push(Packer &packer, Module module, Level level, const char *fmt)
+        {
+            Header header{esp_timer_get_time(), fmt, module, level, (uint8_t)(packer.used - sizeof(Header)), packer.argc};
+            memcpy(packer.buffer, &header, sizeof(Header));
+
+            uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                uint32_t index = pos & (Config::Log::RING_SLOTS - 1);
+                int32_t diff = (int32_t)(sequence(index) - pos);
+                if (diff == 0)
+                {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        memcpy(slots[index].data, packer.buffer, packer.used);
+                        publish(index, pos + 1);
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            written.fetch_add(1, std::memory_order_relaxed);
+            if (packer.truncated)
+                truncated.fetch_add(1, std::memory_order_relaxed);
+
+#ifdef ARDUINO
+            if (drainTask)
+            {
+                if (xPortInIsrContext())
+                {
+                    BaseType_t woken = pdFALSE;
+                    vTaskNotifyGiveFromISR(drainTask, &woken);
+                    portYIELD_FROM_ISR(woken);
+                }
+                else
+                {
+                    xTaskNotifyGive(drainTask);
+                }
+            }
+#endif
+        }
+
+        bool pop(uint8_t *out)
+        {
+            uint32_t index = dequeuePos & (Config::Log::RING_SLOTS - 1);
+            if ((int32_t)(sequence(index) - (dequeuePos + 1)) < 0)
+                return false;
+
+            memcpy(out, slots[index].data, PAYLOAD);
+            publish(index, dequeuePos + Config::Log::RING_SLOTS);
+            dequeuePos++;
+            return true;
+        }
+
+        // Formats one conversion with the stored argument, widened to what the spec expects
+        template <size_t N>
+        void formatArg(FixedString<N> &out, const char *spec, size_t specLen, char conv, const uint8_t *&arg, const uint8_t *end)
+        {
+            // Rebuild the spec without length modifiers, then add the one matching the widened value
+            char base[16];
+            size_t n = 0;
+            for (size_t i = 0; i < specLen - 1 && n < sizeof(base) - 4; i++)
+            {
+                char c = spec[i];
+                if (c != 'h' && c != 'l' && c != 'L' && c != 'z' && c != 'j' && c != 't' && c != 'q')
+                    base[n++] = c;
+            }
+
+            char chunk[Config::Log::LINE_LENGTH];
+            if (arg >= end)
+            {
+                out += "<?>";
+                return;
+            }
+
+            Arg tag = (Arg)*arg++;
+            int64_t i64 = 0;
+            double f64 = 0;
+            const char *str = nullptr;
+
+            switch (tag)
+            {
+            case Arg::I32:
+            {
+                int32_t v;
+                memcpy(&v, arg, 4);
+                arg += 4;
+                i64 = v;
+                f64 = v;
+                break;
+            }
+            case Arg::U32:
+            case Arg::Ptr:
+            {
+                uint32_t v;
+                memcpy(&v, arg, sizeof(uint32_t));
+                arg += tag == Arg::Ptr ? sizeof(uintptr_t) : 4;
+                i64 = v;
+                f64 = v;
+                break;
+            }
+            case Arg::I64:
+            case Arg::U64:
+                memcpy(&i64, arg, 8);
+                arg += 8;
+                f64 = (double)i64;
+                break;
+            case Arg::F64:
+                memcpy(&f64, arg, 8);
+                arg += 8;
+                i64 = (int64_t)f64;
+                break;
+            case Arg::Str:
+                str = (const char *)arg;
+                arg += strlen(str) + 1;
+                break;
+            }
+
+            switch (conv)
+            {
+            case 'd':
+            case 'i':
+                memcpy(base + n, "ll", 2);
+                base[n + 2] = conv;
+                base[n + 3] = '\0';
+                snprintf(chunk, sizeof(chunk), base, (long long)i64);
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                memcpy(base + n, "ll", 2);
+                base[n + 2] = conv;
+                base[n + 3] = '\0';
+                snprintf(chunk, sizeof(chunk), base, (unsigned long long)i64);
+                break;
+            case 'c':
+                base[n] = conv;
+                base[n + 1] = '\0';
+                snprintf(chunk, sizeof(chunk), base, (int)i64);
+                break;
+            case 's':
+                base[n] = conv;
+                base[n + 1] = '\0';
+                snprintf(chunk, sizeof(chunk), base, str ? str : "?");
+                break;
+            case 'p':
+                snprintf(chunk, sizeof(chunk), "0x%08llx", (unsigned long long)i64);
+                break;
+            default: // f F e E g G
+                base[n] = conv;
+                base[n + 1] = '\0';
+                snprintf(chunk, sizeof(chunk), base, f64);
+                break;
+            }
+            out += chunk;
+        }
+
+        template <size_t N>
+        void format(const uint8_t *record, FixedString<N> &out)
+        {
+            Header header;
+            memcpy(&header, record, sizeof(Header));
+            const uint8_t *arg = record + sizeof(Header);
+            const uint8_t *end = arg + header.size;
+
+            out.format("%llu %s ", (unsigned long long)(header.timeUs / 1000), prefixes[(uint8_t)header.module]);
+
+            const char *p = header.fmt;
+            while (*p && out.length() < N)
+            {
+                const char *pct = strchr(p, '%');
+                if (!pct)
+                {
+                    out += p;
+                    break;
+                }
+
+                char literal[Config::Log::LINE_LENGTH];
+                size_t len = min((size_t)(pct - p), sizeof(literal) - 1);
+                memcpy(literal, p, len);
+                literal[len] = '\0';
+                out += literal;
+
+                if (pct[1] == '%')
+                {
+                    out += "%";
+                    p = pct + 2;
+                    continue;
+                }
+
+                const char *conv = pct + 1;
+                while (*conv && !strchr("diouxXcsfFeEgGp", *conv))
+                    conv++;
+                if (!*conv)
+                {
+                    out += pct;
+                    break;
+                }
+
+                formatArg(out, pct, conv - pct + 1, *conv, arg, end);
+                p = conv + 1;
+            }
+        }
+
+        // Formats, prints and keeps every queued record
+        void drainPending()
+        {
+            uint8_t record[PAYLOAD];
+            while (pop(record))
+            {
+                Line line;
+                format(record, line.text);
+#ifdef ARDUINO
+                Serial0.println(line.text.c_str());
+#endif
+                printed.fetch_add(1, std::memory_order_relaxed);
+
+                Header header;
+                memcpy(&header, record, sizeof(Header));
+                line.timeUs = header.timeUs;
+                line.level = header.level;
+                line.module = header.module;
+
+                portENTER_CRITICAL(&historyMux);
+                line.seq = ++historySeq;
+                historyLines[line.seq % Config::Log::HISTORY_LINES] = line;
+                portEXIT_CRITICAL(&historyMux);
+            }
+        }
+
+#ifdef ARDUINO
+        void drain(void *)
+        {
+            for (;;)
+            {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                drainPending();
+            }
+        }
+#endif
+    }
+
+    // Starts the drain task; anything logged earlier is printed right away
+    void begin()
+    {
+#ifdef ARDUINO
+        xTaskCreate(detail::drain, "log_drain", Config::Log::TASK_STACK_SIZE, nullptr,
+                    Config::Log::TASK_PRIORITY, &detail::drainTask);
+        xTaskNotifyGive(detail::drainTask);
+#endif
+    }
+
+    // Waits for the drain task to empty the ring (e.g. right before a restart)
+    void flush(uint32_t timeoutMs)
+    {
+#ifdef ARDUINO
+        // Timebase's clock, read directly: Timebase.h includes this file
+        int64_t deadline = esp_timer_get_time() + timeoutMs * 1000LL;
+        while (detail::printed.load() != detail::written.load() && esp_timer_get_time() < deadline)
+            vTaskDelay(1);
+        Serial0.flush();
+#else
+        detail::drainPending();
+#endif
+    }
+
+    Stats stats()
+    {
+        Stats s;
+        s.written = detail::written.load(std::memory_order_relaxed);
+        s.dropped = detail::dropped.load(std::memory_order_relaxed);
+        s.truncated = detail::truncated.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    uint32_t lastSeq()
+    {
+        portENTER_CRITICAL(&detail::historyMux);
+        uint32_t seq = detail::historySeq;
+        portEXIT_CRITICAL(&detail::historyMux);
+        return seq;
+    }
+
+    // Only the bounds are read together; each line is copied under its own
+    // lock, so a long read never holds the drain task off for more than one
+    size_t history(uint32_t since, Line *out, size_t capacity)
+    {
+        uint32_t last = lastSeq();
+        uint32_t first = last > Config::Log::HISTORY_LINES ? last - Config::Log::HISTORY_LINES + 1 : 1;
+
+        size_t n = 0;
+        for (uint32_t seq = max(since + 1, first); seq <= last && n < capacity; seq++)
+        {
+            portENTER_CRITICAL(&detail::historyMux);
+            out[n] = detail::historyLines[seq % Config::Log::HISTORY_LINES];
+            portEXIT_CRITICAL(&detail::historyMux);
+
+            // Overwritten by a newer line since the bounds were read
+            if (out[n].seq == seq)
+                n++;
+        }
+        return n;
+    }
+
+    const char *levelName(Level level)
+    {
+        static const char *const names[] = {"off", "error", "warn", "info", "debug", "trace"};
+        return names[(uint8_t)level];
+    }
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include "AllocCounter.h"
+#include "DeviceState.h"
+#include "Config.h"
+#include "Log.h"
+#include "Timebase.h"
+
+// Periodic heap/PSRAM/stack sampling plus per-module heap attribution.
+// Internal heap is what WiFi/LWIP and MQTT publishes live on, so the low
+// memory alarm watches its free size, its largest free block and the
+// tightest task stack, and raises before an allocation actually fails.
+class MemoryMonitor
+{
+public:
+    enum class Module : uint8_t
+    {
+        WiFi,
+        Web,
+        Mqtt,
+        Display,
+        Loop, // A whole App::loop iteration
+        COUNT
+    };
+
+    // Attributes internal heap movement during its lifetime to a module. The
+    // free-size read is O(1), so probes can wrap every loop iteration. The
+    // net delta misses allocations freed before the probe ends, so the
+    // task's heap call count (AllocCounter) is taken as well.
+    class Probe
+    {
+    public:
+        explicit Probe(Module module)
+            : module(module), before(heap_caps_get_free_size(MALLOC_CAP_INTERNAL)), callsBefore(AllocCounter::calls()) {}
+        ~Probe()
+        {
+            MemoryMonitor::account(module, before, heap_caps_get_free_size(MALLOC_CAP_INTERNAL), AllocCounter::calls() - callsBefore);
+        }
+
+        Probe(const Probe &) = delete;
+        Probe &operator=(const Probe &) = delete;
+
+    private:
+        Module module;
+        size_t before;
+        uint32_t callsBefore;
+    };
+
+    void begin();
+    void update(DeviceState &state);
+
+    // End of App::setup: boot time and the heap left once every module of
+    // the build profile has taken its buffers and task stacks
+    static void booted();
+
+    // Full snapshot for /api/memory and hub/memory; safe from any task
+    static void report(JsonObject out);
+
+private:
+    struct ModuleStats
+    {
+        uint32_t calls = 0;
+        uint32_t allocations = 0; // Probes that ended with less free heap
+        int32_t retained = 0;     // Net bytes still held after the probes
+        uint32_t largestDrop = 0;
+        uint32_t mallocs = 0;      // Heap calls inside probes, freed or not
+        uint32_t mallocProbes = 0; // Probes that made any heap call
+    };
+
+    struct TaskStack
+    {
+        char name[configMAX_TASK_NAME_LEN];
+        uint32_t freeBytes;
+    };
+
+    static const char *const moduleNames[(uint8_t)Module::COUNT];
+
+    static portMUX_TYPE mux;
+    static ModuleStats modules[(uint8_t)Module::COUNT];
+    static TaskStack tasks[Config::Memory::MAX_TASKS];
+    static uint8_t taskCount;
+    static const char *lowReason;
+    static uint32_t bootMs;
+    static uint32_t bootHeapFree;
+    static uint32_t bootPsramFree;
+
+    uint64_t lastSample = 0;
+    bool low = false;
+
+    static void account(Module module, size_t before, size_t after, uint32_t mallocs);
+
+    void sampleHeap(DeviceState &state);
+    void sampleTasks(DeviceState &state);
+    void checkAlarm(DeviceState &state);
+};
+
+const char *const MemoryMonitor::moduleNames[(uint8_t)Module::COUNT] = {"wifi", "web", "mqtt", "display", "loop"};
+
+portMUX_TYPE MemoryMonitor::mux = portMUX_INITIALIZER_UNLOCKED;
+MemoryMonitor::ModuleStats MemoryMonitor::modules[(uint8_t)Module::COUNT];
+MemoryMonitor::TaskStack MemoryMonitor::tasks[Config::Memory::MAX_TASKS];
+uint8_t MemoryMonitor::taskCount = 0;
+const char *MemoryMonitor::lowReason = nullptr;
+uint32_t MemoryMonitor::bootMs = 0;
+uint32_t MemoryMonitor::bootHeapFree = 0;
+uint32_t MemoryMonitor::bootPsramFree = 0;
+
+void MemoryMonitor::begin()
+{
+    LOG_I(Memory, "Internal heap: %u free of %u, PSRAM: %u free of %u",
+          (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL), (unsigned)heap_caps_get_total_size(MALLOC_CAP_INTERNAL),
+          (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM), (unsigned)heap_caps_get_total_size(MALLOC_CAP_SPIRAM));
+}
+
+void MemoryMonitor::booted()
+{
+    bootMs = Timebase::nowMs();
+    bootHeapFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    bootPsramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    LOG_I(Memory, "Profile \"%s\" up in %lu ms, internal heap %lu free, PSRAM %lu free", Config::Profile::NAME,
+          (unsigned long)bootMs, (unsigned long)bootHeapFree, (unsigned long)bootPsramFree);
+}
+
+void MemoryMonitor::update(DeviceState &state)
+{
+    uint64_t now = Timebase::nowMs();
+    if (lastSample != 0 && now - lastSample < Config::Memory::SAMPLE_INTERVAL_MS)
+        return;
+    lastSample = now;
+
+    sampleHeap(state);
+    sampleTasks(state);
+    checkAlarm(state);
+}
+
+void MemoryMonitor::account(Module module, size_t before, size_t after, uint32_t mallocs)
+{
+    int32_t delta = (int32_t)before - (int32_t)after;
+
+    portENTER_CRITICAL(&mux);
+    ModuleStats &m = modules[(uint8_t)module];
+    m.calls++;
+    m.retained += delta;
+    if (delta > 0)
+    {
+        m.allocations++;
+        if ((uint32_t)delta > m.largestDrop)
+            m.largestDrop = delta;
+    }
+    if (mallocs)
+    {
+        m.mallocs += mallocs;
+        m.mallocProbes++;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void MemoryMonitor::sampleHeap(DeviceState &state)
+{
+    state.heapFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    state.heapMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    state.heapLargestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    state.psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    // 0 = one contiguous block, 100 = free space shredded into tiny pieces
+    state.heapFragmentation = state.heapFree ? 100 - (uint8_t)((uint64_t)state.heapLargestBlock * 100 / state.heapFree) : 0;
+}
+
+void MemoryMonitor::sampleTasks(DeviceState &state)
+{
+    uint32_t minStack = UINT32_MAX;
+
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t status[Config::Memory::MAX_TASKS];
+    UBaseType_t n = uxTaskGetSystemState(status, Config::Memory::MAX_TASKS, nullptr);
+
+    portENTER_CRITICAL(&mux);
+    taskCount = n;
+    for (UBaseType_t i = 0; i < n; i++)
+    {
+        // Stack is counted in bytes on ESP-IDF (StackType_t is uint8_t)
+        strlcpy(tasks[i].name, status[i].pcTaskName, sizeof(tasks[i].name));
+        tasks[i].freeBytes = status[i].usStackHighWaterMark;
+        if (tasks[i].freeBytes < minStack)
+            minStack = tasks[i].freeBytes;
+    }
+    portEXIT_CRITICAL(&mux);
+#else
+    // Without the trace facility only the loop task can be inspected
+    portENTER_CRITICAL(&mux);
+    taskCount = 1;
+    strlcpy(tasks[0].name, pcTaskGetName(nullptr), sizeof(tasks[0].name));
+    tasks[0].freeBytes = minStack = uxTaskGetStackHighWaterMark(nullptr);
+    portEXIT_CRITICAL(&mux);
+#endif
+
+    state.minStackFree = minStack;
+}
+
+void MemoryMonitor::checkAlarm(DeviceState &state)
+{
+    const char *reason = nullptr;
+    if (state.heapFree < Config::Memory::LOW_HEAP_BYTES)
+        reason = "heap";
+    else if (state.heapLargestBlock < Config::Memory::LOW_BLOCK_BYTES)
+        reason = "fragmentation";
+    else if (state.minStackFree < Config::Memory::LOW_STACK_BYTES)
+        reason = "stack";
+
+    // Clear only once every margin is comfortably back, to avoid flapping
+    bool clear = state.heapFree > Config::Memory::LOW_HEAP_BYTES * 5 / 4 &&
+                 state.heapLargestBlock > Config::Memory::LOW_BLOCK_BYTES * 5 / 4 &&
+                 state.minStackFree >= Config::Memory::LOW_STACK_BYTES;
+
+    if (!low && reason)
+    {
+        low = true;
+        lowReason = reason;
+        LOG_W(Memory, "Low memory (%s): free=%lu min=%lu largest=%lu stack=%lu", reason,
+              (unsigned long)state.heapFree, (unsigned long)state.heapMinFree,
+              (unsigned long)state.heapLargestBlock, (unsigned long)state.minStackFree);
+    }
+    else if (low && clear)
+    {
+        low = false;
+        lowReason = nullptr;
+        LOG_I(Memory, "Memory recovered: free=%lu largest=%lu",
+              (unsigned long)state.heapFree, (unsigned long)state.heapLargestBlock);
+    }
+
+    state.memoryLow = low;
+}
+
+void MemoryMonitor::report(JsonObject out)
+{
+    JsonObject boot = out["boot"].to<JsonObject>();
+    boot["profile"] = Config::Profile::NAME;
+    boot["ms"] = bootMs;
+    boot["heapFree"] = bootHeapFree;
+    boot["psramFree"] = bootPsramFree;
+
+    JsonObject heap = out["heap"].to<JsonObject>();
+    heap["free"] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    heap["minFree"] = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    heap["largestBlock"] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    heap["total"] = heap_caps_get_total_size(MALLOC_CAP_INTERNAL);
+
+    JsonObject psram = out["psram"].to<JsonObject>();
+    psram["free"] = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    psram["minFree"] = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+    psram["total"] = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+
+    // Copy under the lock, build JSON outside it
+    ModuleStats moduleCopy[(uint8_t)Module::COUNT];
+    TaskStack taskCopy[Config::Memory::MAX_TASKS];
+    uint8_t n;
+
+    portENTER_CRITICAL(&mux);
+    memcpy(moduleCopy, modules, sizeof(moduleCopy));
+    n = taskCount;
+    memcpy(taskCopy, tasks, n * sizeof(TaskStack));
+    const char *reason = lowReason;
+    portEXIT_CRITICAL(&mux);
+
+    out["low"] = reason != nullptr;
+    if (reason)
+        out["lowReason"] = reason;
+
+    JsonArray taskList = out["tasks"].to<JsonArray>();
+    for (uint8_t i = 0; i < n; i++)
+    {
+        JsonObject t = taskList.add<JsonObject>();
+        t["name"] = taskCopy[i].name;
+        t["stackFree"] = taskCopy[i].freeBytes;
+    }
+
+    JsonObject moduleList = out["modules"].to<JsonObject>();
+    for (uint8_t i = 0; i < (uint8_t)Module::COUNT; i++)
+    {
+        JsonObject m = moduleList[moduleNames[i]].to<JsonObject>();
+        m["calls"] = moduleCopy[i].calls;
+        m["allocations"] = moduleCopy[i].allocations;
+        m["retained"] = moduleCopy[i].retained;
+        m["largestDrop"] = moduleCopy[i].largestDrop;
+        m["mallocs"] = moduleCopy[i].mallocs;
+        m["mallocProbes"] = moduleCopy[i].mallocProbes;
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include "DeviceState.h"
+#include "Config.h"
+#include "Replay.h"
+#include "TripleBuffer.h"
+
+// Latest-wins setpoint handoff from the web server (async_tcp task) to the
+// control pass. Each axis is a TripleBuffer, so neither side waits or locks
+// and a burst between two passes collapses into its last command.
+class MotorMailbox
+{
+public:
+    enum class Op : uint8_t
+    {
+        Set,
+        Stop,
+        Brake,
+        Coast,
+        COUNT
+    };
+
+    struct Command
+    {
+        int16_t speed = 0; // Per-mille, Set only
+        Op op = Op::Stop;
+        uint32_t id = 0;   // Optional client tag, echoed on hub/echo
+        uint32_t ingressUs = 0;
+    };
+
+    static const char *opName(Op op);
+    // Same names as the hub/cmd/motor actions; false for unknown ones
+    static bool parseOp(const char *name, Op &op);
+
+    // async_tcp task only (single writer). Returns false when the command
+    // replaced one the control pass had not taken yet.
+    static bool post(uint8_t axis, const Command &command);
+
+    // Control pass: applies the newest command of each axis. While replaying
+    // they are dropped, the recording owns the setpoints.
+    static void apply(DeviceState &state, bool discard);
+
+    static void report(JsonObject out);
+
+private:
+    static TripleBuffer<Command> lanes[Config::Axes::COUNT];
+    static std::atomic<uint32_t> posted;
+    static std::atomic<uint32_t> coalesced;
+    static uint32_t applied;   // Loop task only
+    static uint32_t discarded; // Loop task only
+
+    static void record(uint8_t axis, const Command &command);
+};
+
+TripleBuffer<MotorMailbox::Command> MotorMailbox::lanes[Config::Axes::COUNT];
+std::atomic<uint32_t> MotorMailbox::posted{0};
+std::atomic<uint32_t> MotorMailbox::coalesced{0};
+uint32_t MotorMailbox::applied = 0;
+uint32_t MotorMailbox::discarded = 0;
+
+const char *MotorMailbox::opName(Op op)
+{
+    switch (op)
+    {
+    case Op::Set:
+        return "set";
+    case Op::Brake:
+        return "brake";
+    case Op::Coast:
+        return "coast";
+    default:
+        return "stop";
+    }
+}
+
+bool MotorMailbox::parseOp(const char *name, Op &op)
+{
+    for (uint8_t i = 0; i < (uint8_t)Op::COUNT; i++)
+    {
+        if (strcmp(name, opName((Op)i)) == 0)
+        {
+            op = (Op)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MotorMailbox::post(uint8_t axis, const Command &command)
+{
+    bool taken = lanes[axis].write(command);
+
+    posted.fetch_add(1, std::memory_order_relaxed);
+    if (!taken)
+    {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void MotorMailbox::apply(DeviceState &state, bool discard)
+{
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        if (!lanes[i].take())
+            continue;
+        if (discard)
+        {
+            discarded++;
+            continue;
+        }
+
+        const Command &command = lanes[i].read();
+        AxisState &axis = state.axes[i];
+        switch (command.op)
+        {
+        case Op::Set:
+            axis.motorSpeed = constrain((int)command.speed, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
+            break;
+        case Op::Brake:
+            axis.motorSpeed = 0;
+            axis.stopMode = Config::Motor::StopMode::Brake;
+            break;
+        case Op::Coast:
+            axis.motorSpeed = 0;
+            axis.stopMode = Config::Motor::StopMode::Coast;
+            break;
+        default:
+            axis.motorSpeed = 0;
+            axis.stopMode = Config::Motor::STOP_MODE;
+            break;
+        }
+        axis.stampCommand(CommandSource::Http, command.ingressUs, command.id);
+        applied++;
+
+        if (Replay::recording())
+            record(i, command);
+    }
+}
+
+// Recorded as the equivalent hub/axis/<n>/cmd, which a replay routes
+// through MqttController in the pass it was taken in
+void MotorMailbox::record(uint8_t axis, const Command &command)
+{
+    char topic[Config::Mqtt::MAX_TOPIC_SIZE];
+    char payload[64];
+    snprintf(topic, sizeof(topic), "%s%u/cmd", Config::Mqtt::TOPIC_AXIS_PREFIX, axis);
+    int n = snprintf(payload, sizeof(payload), "{\"action\":\"%s\"", opName(command.op));
+    if (command.op == Op::Set)
+        n += snprintf(payload + n, sizeof(payload) - n, ",\"speed\":%d", command.speed);
+    if (command.id)
+        n += snprintf(payload + n, sizeof(payload) - n, ",\"id\":%lu", (unsigned long)command.id);
+    snprintf(payload + n, sizeof(payload) - n, "}");
+    Replay::command(topic, payload);
+}
+
+void MotorMailbox::report(JsonObject out)
+{
+    out["posted"] = posted.load(std::memory_order_relaxed);
+    out["coalesced"] = coalesced.load(std::memory_order_relaxed);
+    out["applied"] = applied;
+    out["discarded"] = discarded;
+}
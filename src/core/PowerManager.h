@@ -0,0 +1,294 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include "DeviceState.h"
+#include "Config.h"
+#include "Log.h"
+#include "Trace.h"
+#include "Replay.h"
+#include "Axes.h"
+#include "Timebase.h"
+#if AF_FEATURE_NETWORK
+#include <WiFi.h>
+#endif
+
+// Idle policy: when the motor is stopped and nothing has happened for
+// IDLE_TIMEOUT_MS the CPU is scaled down, the WiFi modem sleeps between DTIM
+// beacons and the loop blocks so the idle task can enter auto light sleep.
+// Any activity (button/encoder edge, MQTT or web request) switches back.
+// Connected broker and web clients are not counted: a client that stays
+// quiet for IDLE_TIMEOUT_MS lets the device idle, and its next packet or
+// request wakes it.
+class PowerManager
+{
+public:
+    void begin();
+    void update(DeviceState &state);
+
+    // Safe to call from any task or ISR
+    static void IRAM_ATTR notifyActivity();
+
+private:
+    // Buttons plus encoder A of every active axis
+    static constexpr uint8_t WAKE_PIN_COUNT = 3 + Config::Axes::COUNT;
+    static const uint8_t wakePins[3 + Config::Axes::MAX_COUNT];
+
+    // Low 32 bits of Timebase::nowMs(): ISRs write it, so it must be one word
+    static volatile uint32_t lastActivityMs;
+    // Low 32 bits of esp_timer at the first activity since the loop last
+    // ran at full speed, 0 for none; written from ISRs and async_tcp, so
+    // also one word
+    static volatile uint32_t wakeRequestUs;
+    static TaskHandle_t loopTask;
+
+    esp_pm_lock_handle_t cpuLock = nullptr;
+    esp_pm_lock_handle_t noSleepLock = nullptr;
+    bool pmAvailable = false;
+    bool idle = false;
+
+    // Average current estimate
+    uint64_t lastAccountMs = 0;
+    uint64_t activeMs = 0;
+    uint64_t idleMs = 0;
+
+    static volatile bool wakeArmed;
+
+    static void IRAM_ATTR onWakePin(void *arg);
+
+    void enterIdle(DeviceState &state);
+    void exitIdle(DeviceState &state);
+    void armWakePins();
+    void disarmWakePins();
+    void accountTime(DeviceState &state, uint64_t now);
+    bool clientsActive();
+};
+
+const uint8_t PowerManager::wakePins[3 + Config::Axes::MAX_COUNT] = {
+    Config::Pins::BTN_UP,
+    Config::Pins::BTN_DOWN,
+    Config::Pins::BTN_SETUP,
+    Axes::Axis0::ENCODER_A,
+    Axes::Axis1::ENCODER_A,
+    Axes::Axis2::ENCODER_A,
+    Axes::Axis3::ENCODER_A,
+};
+
+volatile uint32_t PowerManager::lastActivityMs = 0;
+volatile uint32_t PowerManager::wakeRequestUs = 0;
+volatile bool PowerManager::wakeArmed = false;
+TaskHandle_t PowerManager::loopTask = nullptr;
+
+void PowerManager::begin()
+{
+    loopTask = xTaskGetCurrentTaskHandle();
+    lastAccountMs = Timebase::nowMs();
+    lastActivityMs = lastAccountMs;
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_esp32s3_t pmConfig = {};
+    pmConfig.max_freq_mhz = Config::Power::CPU_FREQ_MAX_MHZ;
+    pmConfig.min_freq_mhz = Config::Power::CPU_FREQ_IDLE_MHZ;
+    pmConfig.light_sleep_enable = Config::Power::LIGHT_SLEEP_ENABLE;
+
+    esp_err_t err = esp_pm_configure(&pmConfig);
+    if (err == ESP_OK)
+    {
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "app_active", &cpuLock);
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "app_awake", &noSleepLock);
+        esp_pm_lock_acquire(cpuLock);
+        esp_pm_lock_acquire(noSleepLock);
+        esp_sleep_enable_gpio_wakeup();
+        pmAvailable = true;
+    }
+    else
+    {
+        LOG_E(Power, "esp_pm_configure failed: %s", esp_err_to_name(err));
+    }
+#endif
+
+    LOG_I(Power, "Idle policy %s (PM %s)",
+          Config::Power::IDLE_ENABLED ? "enabled" : "disabled",
+          pmAvailable ? "locks" : "fallback");
+}
+
+void IRAM_ATTR PowerManager::notifyActivity()
+{
+    // Timebase's clock, read directly: nowMs() is not guaranteed to be in IRAM
+    int64_t now = esp_timer_get_time();
+    lastActivityMs = now / 1000;
+    if (wakeRequestUs == 0)
+    {
+        // Two writers racing here both store a valid request time; 0 is
+        // kept free as the "none" marker
+        uint32_t stamp = (uint32_t)now;
+        wakeRequestUs = stamp ? stamp : 1;
+    }
+}
+
+void IRAM_ATTR PowerManager::onWakePin(void *arg)
+{
+    TRACE_INSTANT("wake_pin", (uintptr_t)arg);
+    notifyActivity();
+
+    // An armed pin is level-triggered: fall back to edges so it does not refire
+    if (wakeArmed)
+    {
+        gpio_num_t pin = (gpio_num_t)(uintptr_t)arg;
+        gpio_wakeup_disable(pin);
+        gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+    }
+
+    if (loopTask)
+    {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(loopTask, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void PowerManager::update(DeviceState &state)
+{
+    uint64_t now = Timebase::nowMs();
+    accountTime(state, now);
+
+    bool busy = state.anyMotorRunning() || state.sequenceState == SequenceState::Running || clientsActive() ||
+                Replay::busy() || (uint32_t)now - lastActivityMs < Config::Power::IDLE_TIMEOUT_MS;
+
+    if (idle && busy)
+    {
+        exitIdle(state);
+    }
+    else if (!idle && !busy && Config::Power::IDLE_ENABLED)
+    {
+        enterIdle(state);
+    }
+
+    if (!idle)
+    {
+        wakeRequestUs = 0;
+        return;
+    }
+
+    // Block instead of spinning; wake pins cut the wait short
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(Config::Power::IDLE_POLL_MS));
+}
+
+// Only the setup AP counts here; broker and web clients are covered by the
+// activity timeout (see the class comment)
+bool PowerManager::clientsActive()
+{
+#if AF_FEATURE_NETWORK
+    // Stations on the setup AP keep the device awake (softAP cannot modem-sleep)
+    wifi_mode_t mode = WiFi.getMode();
+    return (mode == WIFI_AP || mode == WIFI_AP_STA);
+#else
+    return false;
+#endif
+}
+
+void PowerManager::enterIdle(DeviceState &state)
+{
+    idle = true;
+    state.powerIdle = true;
+
+#if AF_FEATURE_NETWORK
+    if (WiFi.getMode() == WIFI_STA)
+        WiFi.setSleep(true);
+#endif
+
+    armWakePins();
+
+    if (pmAvailable)
+    {
+        esp_pm_lock_release(noSleepLock);
+        esp_pm_lock_release(cpuLock);
+    }
+    else
+    {
+        setCpuFrequencyMhz(Config::Power::CPU_FREQ_IDLE_MHZ);
+    }
+
+    LOG_D(Power, "Entering idle");
+}
+
+void PowerManager::exitIdle(DeviceState &state)
+{
+    if (pmAvailable)
+    {
+        esp_pm_lock_acquire(cpuLock);
+        esp_pm_lock_acquire(noSleepLock);
+    }
+    else
+    {
+        setCpuFrequencyMhz(Config::Power::CPU_FREQ_MAX_MHZ);
+    }
+
+    disarmWakePins();
+#if AF_FEATURE_NETWORK
+    WiFi.setSleep(false);
+#endif
+
+    uint32_t requested = wakeRequestUs;
+    if (requested != 0)
+    {
+        // Wrap-safe: a wake takes far less than the 71 minutes 32 bits hold
+        state.wakeLatencyUs = (uint32_t)esp_timer_get_time() - requested;
+    }
+
+    idle = false;
+    state.powerIdle = false;
+
+    LOG_D(Power, "Leaving idle (wake latency %lu us)", (unsigned long)state.wakeLatencyUs);
+}
+
+void PowerManager::armWakePins()
+{
+    // Pin interrupts exist only while idle so encoder edges cost nothing when running.
+    // Light sleep only supports level wakeup: arm each pin on the level it is not at now.
+    wakeArmed = pmAvailable;
+    for (uint8_t i = 0; i < WAKE_PIN_COUNT; i++)
+    {
+        attachInterruptArg(wakePins[i], onWakePin, (void *)(uintptr_t)wakePins[i], CHANGE);
+        if (pmAvailable)
+        {
+            gpio_num_t pin = (gpio_num_t)wakePins[i];
+            gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+        }
+    }
+}
+
+void PowerManager::disarmWakePins()
+{
+    wakeArmed = false;
+    for (uint8_t i = 0; i < WAKE_PIN_COUNT; i++)
+    {
+        if (pmAvailable)
+        {
+            gpio_wakeup_disable((gpio_num_t)wakePins[i]);
+        }
+        detachInterrupt(wakePins[i]);
+    }
+}
+
+void PowerManager::accountTime(DeviceState &state, uint64_t now)
+{
+    uint64_t elapsed = now - lastAccountMs;
+    lastAccountMs = now;
+
+    if (idle)
+        idleMs += elapsed;
+    else
+        activeMs += elapsed;
+
+    uint64_t total = activeMs + idleMs;
+    if (total == 0)
+        return;
+
+    uint16_t idleMa = (pmAvailable && Config::Power::LIGHT_SLEEP_ENABLE) ? Config::Power::SLEEP_CURRENT_MA
+                                                                         : Config::Power::IDLE_CURRENT_MA;
+    state.avgCurrentMa = (uint16_t)((activeMs * Config::Power::ACTIVE_CURRENT_MA + idleMs * idleMa) / total);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Config.h"
+
+// Stand-in for a module the build profile leaves out (Config::Profile).
+// App drives every module through the same begin()/update() calls; on this
+// type they are empty and compile away, and the module's own header is
+// never included.
+struct OmittedModule
+{
+    template <typename... Args>
+    void begin(Args &&...) {}
+
+    template <typename... Args>
+    void update(Args &&...) {}
+};
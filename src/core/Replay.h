@@ -0,0 +1,597 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#else
+#include "Host.h"
+#endif
+#include <ArduinoJson.h>
+#include "DeviceState.h"
+#include "Config.h"
+#include "Log.h"
+#include "Timebase.h"
+#include "SequenceEngine.h"
+
+// Record and replay of the control inputs. A recording stores every command
+// routed by MqttBroker (topic, payload, arrival time) and the raw sensor
+// readings of every control pass into the input buffer. A replay feeds such
+// an input back through the same modules: commands go through MqttBroker's
+// dispatch, sensor readings replace the hardware reads of the control pass,
+// and the motors are left alone. Both modes write an output buffer with the
+// PWM of every pass, every telemetry publish and every display update, each
+// with its processing time, so tools/replay_tool.py can diff two firmware
+// builds for behaviour and timing.
+//
+// Records keep their order: commands received before a pass are injected
+// before that pass is replayed, and each recorded pass drives exactly one
+// replayed pass. At speed 0 the replay runs pass by pass as fast as the loop
+// goes; otherwise records fall due at their recorded time divided by speed.
+// Modules with their own clocks (stall guard, sequence timing, telemetry
+// intervals) still see real time, so they diverge from the recording at
+// speeds other than 1.
+//
+// Both buffers live in PSRAM and are allocated on first use. Requests,
+// upload and download are safe from any task; everything else is loop only.
+class Replay
+{
+public:
+    enum class Mode : uint8_t
+    {
+        Off,
+        Recording,
+        Replaying
+    };
+
+    enum class Type : uint8_t
+    {
+        // Input
+        Command = 1,  // topic '\0' payload
+        Inputs = 2,   // InputRecord per axis
+        // Output
+        Pass = 16,    // uint32 pass us, then int16 speed + uint16 duty per axis
+        Publish = 17, // topic '\0' payload
+        Display = 18, // uint32 update us, uint64 changed field mask
+        Handled = 19  // uint32 processing us, topic
+    };
+
+    // File layout: Header, then records of RecordHeader + `size` bytes
+    struct Header
+    {
+        char magic[4]; // "AFRP"
+        uint16_t version;
+        uint8_t output; // 0 input, 1 output
+        uint8_t axes;
+        uint32_t records;
+        uint32_t bytes; // Including this header
+        uint32_t dropped;
+        char firmware[16];
+    };
+
+    struct RecordHeader
+    {
+        uint32_t timeUs; // Since the start of the recording or replay
+        Type type;
+        uint8_t reserved;
+        uint16_t size;
+    };
+
+    // Per-axis Inputs payload
+    struct InputRecord
+    {
+        int64_t encoderCount;
+        int64_t indexCount;
+        int16_t currentAdc;
+        uint8_t indexLatched;
+        uint8_t reserved;
+        uint32_t padding;
+    };
+
+    // Safe from any task; the loop acts on its next pass
+    static bool requestRecord(uint32_t durationMs);
+    static bool requestReplay(uint8_t speed);
+    static void requestStop() { pending = Request::Stop; }
+
+    static Mode mode() { return current; }
+    static bool recording() { return current == Mode::Recording; }
+    static bool replaying() { return current == Mode::Replaying; }
+    static bool busy() { return current != Mode::Off || pending != Request::None || uploader; }
+
+    // Loop task: starts and finishes runs, injects due commands through
+    // inject(topic, payload)
+    template <typename Inject>
+    static void update(DeviceState &state, Inject &&inject);
+
+    // Control pass. While replaying, fills `in` with the next recorded pass
+    // and returns false if none is due yet; the pass is skipped then.
+    // While recording, stores the pass' hardware readings.
+    static bool inputs(AxisInputs *in);
+
+    // Hooks into the modules whose behaviour is recorded
+    static void command(const char *topic, const char *payload);
+    static void handled(const char *topic, uint32_t processUs);
+    static void pass(const DeviceState &state, const uint16_t *duties, uint32_t passUs);
+    static void publish(const char *topic, const char *payload);
+    static void display(uint64_t changed, uint32_t updateUs);
+
+    // Input or output buffer of the last run, 0 while busy or empty
+    static size_t exportSize(bool output);
+    static size_t read(bool output, uint8_t *out, size_t maxLen, size_t offset);
+
+    // HTTP upload of an input file, chunk by chunk. `owner` identifies the
+    // request: the first chunk claims the buffer, chunks of any other
+    // request are ignored until the upload completes or is cancelled.
+    // `error` is set when the failure still needs an answer.
+    static bool upload(const void *owner, const uint8_t *data, size_t len, size_t index, size_t total, const char *&error);
+    // Drops `owner`'s upload if it did not complete; no-op otherwise
+    static void cancelUpload(const void *owner);
+
+    static void report(JsonObject out);
+
+private:
+    enum class Request : uint8_t
+    {
+        None,
+        Record,
+        Replay,
+        Stop
+    };
+
+    struct Buffer
+    {
+        uint8_t *data;
+        size_t capacity;
+        size_t used;
+        uint32_t records;
+        uint32_t dropped;
+    };
+
+    static constexpr uint16_t VERSION = 1;
+
+    static Buffer input;
+    static Buffer output;
+    static volatile Mode current;
+    static volatile Request pending;
+    static const void *volatile uploader; // Request owning the input buffer
+    static volatile uint32_t pendingArg;
+
+    static int64_t startUs;
+    static uint32_t durationMs;
+    static uint8_t speed;
+    static size_t cursor; // Next input record while replaying
+    static uint32_t replayedPasses;
+    static char commandBuffer[Config::Replay::MAX_COMMAND_BYTES + 1];
+
+    static bool allocate();
+    static uint32_t elapsedUs() { return (uint32_t)(Timebase::nowUs() - startUs); }
+    static bool due(uint32_t timeUs);
+    static bool peek(RecordHeader &header);
+    static bool append(Buffer &buffer, Type type, const void *a, uint16_t aSize, const void *b = nullptr, uint16_t bSize = 0);
+    static void writeHeader(Buffer &buffer, bool isOutput);
+    static bool validInput();
+
+    static void startRecording(uint32_t ms);
+    static bool startReplay(DeviceState &state, uint8_t scale);
+    static void finish(DeviceState &state);
+};
+
+Replay::Buffer Replay::input = {nullptr, Config::Replay::INPUT_BYTES, 0, 0, 0};
+Replay::Buffer Replay::output = {nullptr, Config::Replay::OUTPUT_BYTES, 0, 0, 0};
+volatile Replay::Mode Replay::current = Replay::Mode::Off;
+volatile Replay::Request Replay::pending = Replay::Request::None;
+const void *volatile Replay::uploader = nullptr;
+volatile uint32_t Replay::pendingArg = 0;
+int64_t Replay::startUs = 0;
+uint32_t Replay::durationMs = 0;
+uint8_t Replay::speed = 0;
+size_t Replay::cursor = 0;
+uint32_t Replay::replayedPasses = 0;
+char Replay::commandBuffer[Config::Replay::MAX_COMMAND_BYTES + 1];
+
+bool Replay::requestRecord(uint32_t ms)
+{
+    if (busy())
+        return false;
+    pendingArg = constrain(ms, (uint32_t)1, Config::Replay::MAX_DURATION_MS);
+    pending = Request::Record;
+    return true;
+}
+
+bool Replay::requestReplay(uint8_t scale)
+{
+    if (busy() || !validInput())
+        return false;
+    pendingArg = min(scale, Config::Replay::MAX_SPEED);
+    pending = Request::Replay;
+    return true;
+}
+
+bool Replay::allocate()
+{
+    for (Buffer *buffer : {&input, &output})
+    {
+        if (buffer->data)
+            continue;
+        buffer->data = (uint8_t *)heap_caps_malloc(buffer->capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buffer->data)
+        {
+            LOG_E(Replay, "No PSRAM for a %u byte replay buffer", (unsigned)buffer->capacity);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Inject>
+void Replay::update(DeviceState &state, Inject &&inject)
+{
+    Request request = pending;
+    if (request != Request::None)
+    {
+        switch (request)
+        {
+        case Request::Record:
+            pending = Request::None;
+            startRecording(pendingArg);
+            break;
+        case Request::Replay:
+            // Stays pending until a pass has latched the stop
+            if (startReplay(state, pendingArg))
+                pending = Request::None;
+            break;
+        case Request::Stop:
+            pending = Request::None;
+            if (current != Mode::Off)
+                finish(state);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (current == Mode::Recording)
+    {
+        bool full = input.capacity - input.used < sizeof(RecordHeader) + Config::Axes::COUNT * sizeof(InputRecord);
+        if (full || elapsedUs() >= durationMs * 1000ull)
+            finish(state);
+        return;
+    }
+    if (current != Mode::Replaying)
+        return;
+
+    // Commands that arrived before the next recorded pass, once due
+    RecordHeader next;
+    bool more;
+    while ((more = peek(next)) && next.type != Type::Inputs && due(next.timeUs))
+    {
+        if (next.type == Type::Command && next.size <= Config::Replay::MAX_COMMAND_BYTES)
+        {
+            memcpy(commandBuffer, input.data + cursor + sizeof(RecordHeader), next.size);
+            commandBuffer[next.size] = '\0';
+            size_t topicLength = strnlen(commandBuffer, next.size);
+            if (topicLength < next.size)
+                inject(commandBuffer, commandBuffer + topicLength + 1);
+        }
+        cursor += sizeof(RecordHeader) + next.size;
+    }
+
+    if (!more)
+        finish(state);
+}
+
+bool Replay::due(uint32_t timeUs)
+{
+    return speed == 0 || (uint64_t)elapsedUs() * speed >= timeUs;
+}
+
+// Records are packed without padding, so they are copied out rather than
+// dereferenced in place
+bool Replay::peek(RecordHeader &header)
+{
+    if (cursor + sizeof(RecordHeader) > input.used)
+        return false;
+    memcpy(&header, input.data + cursor, sizeof(header));
+    return cursor + sizeof(RecordHeader) + header.size <= input.used;
+}
+
+bool Replay::inputs(AxisInputs *in)
+{
+    if (current == Mode::Recording)
+    {
+        InputRecord records[Config::Axes::COUNT];
+        for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+            records[i] = {in[i].encoderCount, in[i].indexCount, in[i].currentAdc, in[i].indexLatched, 0, 0};
+        append(input, Type::Inputs, records, sizeof(records));
+        return true;
+    }
+    if (current != Mode::Replaying)
+        return true;
+
+    RecordHeader next;
+    if (!peek(next) || next.type != Type::Inputs || next.size != sizeof(InputRecord) * Config::Axes::COUNT || !due(next.timeUs))
+        return false;
+
+    InputRecord records[Config::Axes::COUNT];
+    memcpy(records, input.data + cursor + sizeof(RecordHeader), sizeof(records));
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        in[i].encoderCount = records[i].encoderCount;
+        in[i].indexCount = records[i].indexCount;
+        in[i].indexLatched = records[i].indexLatched;
+        in[i].currentAdc = records[i].currentAdc;
+    }
+    cursor += sizeof(RecordHeader) + next.size;
+    replayedPasses++;
+    return true;
+}
+
+void Replay::command(const char *topic, const char *payload)
+{
+    if (current != Mode::Recording)
+        return;
+
+    size_t topicSize = strlen(topic) + 1;
+    size_t payloadSize = strlen(payload);
+    if (topicSize + payloadSize > Config::Replay::MAX_COMMAND_BYTES)
+    {
+        input.dropped++;
+        LOG_W(Replay, "Command on %s too large to record", topic);
+        return;
+    }
+    append(input, Type::Command, topic, topicSize, payload, payloadSize);
+}
+
+void Replay::handled(const char *topic, uint32_t processUs)
+{
+    if (current != Mode::Off)
+        append(output, Type::Handled, &processUs, sizeof(processUs), topic, strlen(topic));
+}
+
+void Replay::pass(const DeviceState &state, const uint16_t *duties, uint32_t passUs)
+{
+    if (current == Mode::Off)
+        return;
+
+    uint16_t axes[Config::Axes::COUNT * 2];
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        axes[i * 2] = (uint16_t)(int16_t)state.axes[i].motorSpeed;
+        axes[i * 2 + 1] = duties[i];
+    }
+    append(output, Type::Pass, &passUs, sizeof(passUs), axes, sizeof(axes));
+}
+
+void Replay::publish(const char *topic, const char *payload)
+{
+    if (current != Mode::Off)
+        append(output, Type::Publish, topic, strlen(topic) + 1, payload, strlen(payload));
+}
+
+void Replay::display(uint64_t changed, uint32_t updateUs)
+{
+    if (current != Mode::Off)
+        append(output, Type::Display, &updateUs, sizeof(updateUs), &changed, sizeof(changed));
+}
+
+bool Replay::append(Buffer &buffer, Type type, const void *a, uint16_t aSize, const void *b, uint16_t bSize)
+{
+    size_t size = sizeof(RecordHeader) + aSize + bSize;
+    if (buffer.used + size > buffer.capacity)
+    {
+        buffer.dropped++;
+        return false;
+    }
+
+    RecordHeader header = {elapsedUs(), type, 0, (uint16_t)(aSize + bSize)};
+    uint8_t *p = buffer.data + buffer.used;
+    memcpy(p, &header, sizeof(header));
+    memcpy(p + sizeof(header), a, aSize);
+    if (bSize)
+        memcpy(p + sizeof(header) + aSize, b, bSize);
+    buffer.used += size;
+    buffer.records++;
+    return true;
+}
+
+void Replay::writeHeader(Buffer &buffer, bool isOutput)
+{
+    Header header = {{'A', 'F', 'R', 'P'}, VERSION, isOutput, Config::Axes::COUNT,
+                     buffer.records, (uint32_t)buffer.used, buffer.dropped, {}};
+    strncpy(header.firmware, Config::FIRMWARE_VERSION, sizeof(header.firmware) - 1);
+    memcpy(buffer.data, &header, sizeof(header));
+}
+
+bool Replay::validInput()
+{
+    if (!input.data || input.used < sizeof(Header))
+        return false;
+    const Header *header = (const Header *)input.data;
+    return memcmp(header->magic, "AFRP", 4) == 0 && header->version == VERSION &&
+           !header->output && header->axes == Config::Axes::COUNT;
+}
+
+void Replay::startRecording(uint32_t ms)
+{
+    if (!allocate())
+        return;
+
+    for (Buffer *buffer : {&input, &output})
+    {
+        buffer->used = sizeof(Header);
+        buffer->records = 0;
+        buffer->dropped = 0;
+    }
+    durationMs = ms;
+    startUs = Timebase::nowUs();
+    current = Mode::Recording;
+    LOG_I(Replay, "Recording for %lu ms", (unsigned long)ms);
+}
+
+bool Replay::startReplay(DeviceState &state, uint8_t scale)
+{
+    // The replay takes the motors over without driving them; stop them
+    // first and give the control pass one loop to latch that
+    bool idle = state.sequenceState != SequenceState::Running;
+    for (AxisState &axis : state.axes)
+    {
+        idle &= axis.motorSpeed == 0 && !axis.homingActive;
+        axis.motorSpeed = 0;
+        axis.homingRequested = false;
+        axis.homingActive = false;
+    }
+    if (!idle)
+    {
+        SequenceEngine::stop();
+        return false;
+    }
+
+    output.used = sizeof(Header);
+    output.records = 0;
+    output.dropped = 0;
+    cursor = sizeof(Header);
+    replayedPasses = 0;
+    speed = scale;
+    startUs = Timebase::nowUs();
+    current = Mode::Replaying;
+
+    const Header *header = (const Header *)input.data;
+    if (speed)
+        LOG_I(Replay, "Replaying %lu records from firmware %.16s at x%u", (unsigned long)header->records, header->firmware, speed);
+    else
+        LOG_I(Replay, "Replaying %lu records from firmware %.16s pass by pass", (unsigned long)header->records, header->firmware);
+    return true;
+}
+
+void Replay::finish(DeviceState &state)
+{
+    Mode was = current;
+    current = Mode::Off;
+
+    if (was == Mode::Recording)
+        writeHeader(input, false);
+    writeHeader(output, true);
+
+    if (was == Mode::Replaying)
+    {
+        // Leave the axes as the replay found them: stopped
+        SequenceEngine::stop();
+        for (AxisState &axis : state.axes)
+        {
+            axis.motorSpeed = 0;
+            axis.homingActive = false;
+        }
+        LOG_I(Replay, "Replay done: %lu passes in %lu ms, %lu output records", (unsigned long)replayedPasses,
+              (unsigned long)(elapsedUs() / 1000), (unsigned long)output.records);
+    }
+    else
+    {
+        LOG_I(Replay, "Recording done: %lu input records (%u bytes), %lu dropped", (unsigned long)input.records,
+              (unsigned)input.used, (unsigned long)input.dropped);
+    }
+}
+
+size_t Replay::exportSize(bool isOutput)
+{
+    const Buffer &buffer = isOutput ? output : input;
+    if (busy() || !buffer.data || buffer.used <= sizeof(Header))
+        return 0;
+    return buffer.used;
+}
+
+size_t Replay::read(bool isOutput, uint8_t *out, size_t maxLen, size_t offset)
+{
+    size_t total = exportSize(isOutput);
+    if (offset >= total)
+        return 0;
+    size_t n = min(maxLen, total - offset);
+    memcpy(out, (isOutput ? output : input).data + offset, n);
+    return n;
+}
+
+bool Replay::upload(const void *owner, const uint8_t *data, size_t len, size_t index, size_t total, const char *&error)
+{
+    if (index == 0)
+    {
+        if (current != Mode::Off || pending != Request::None || uploader)
+        {
+            error = "busy";
+            return false;
+        }
+        if (total > input.capacity || total < sizeof(Header))
+        {
+            error = "bad_size";
+            return false;
+        }
+        if (!allocate())
+        {
+            error = "no_memory";
+            return false;
+        }
+        uploader = owner;
+        input.used = 0;
+        input.records = 0;
+    }
+    else if (owner != uploader)
+    {
+        // First chunk was refused and answered already; `error` stays unset
+        return false;
+    }
+
+    // The size checked on the first chunk only holds if every chunk stays
+    // inside it
+    if (index + len > total || total > input.capacity)
+    {
+        cancelUpload(owner);
+        error = "bad_size";
+        return false;
+    }
+
+    memcpy(input.data + index, data, len);
+    if (index + len < total)
+        return true;
+
+    uploader = nullptr;
+    input.used = total;
+    if (!validInput())
+    {
+        input.used = 0;
+        error = "bad_file";
+        return false;
+    }
+    input.records = ((const Header *)input.data)->records;
+    input.dropped = 0;
+    return true;
+}
+
+void Replay::cancelUpload(const void *owner)
+{
+    if (!owner || owner != uploader)
+        return;
+    uploader = nullptr;
+    input.used = 0;
+    input.records = 0;
+}
+
+void Replay::report(JsonObject out)
+{
+    static const char *const modes[] = {"off", "recording", "replaying"};
+    Mode mode = current;
+    out["mode"] = modes[(uint8_t)mode];
+    out["pending"] = pending != Request::None;
+    out["inputRecords"] = input.records;
+    out["inputBytes"] = input.used;
+    out["inputDropped"] = input.dropped;
+    out["outputRecords"] = output.records;
+    out["outputBytes"] = output.used;
+    out["outputDropped"] = output.dropped;
+    if (mode != Mode::Off)
+        out["elapsedMs"] = elapsedUs() / 1000;
+    if (mode == Mode::Recording)
+        out["durationMs"] = durationMs;
+    if (mode == Mode::Replaying)
+    {
+        out["speed"] = speed;
+        out["passes"] = replayedPasses;
+        out["progress"] = input.used ? (float)cursor / input.used : 0.0f;
+    }
+}
@@ -0,0 +1,720 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "Host.h"
+#endif
+#include <ArduinoJson.h>
+#include "DeviceState.h"
+#include "Config.h"
+#include "Log.h"
+#include "Timebase.h"
+#if AF_FEATURE_NETWORK
+#include <LittleFS.h>
+#endif
+
+// One program step, 12 bytes as stored in LittleFS
+struct SequenceStep
+{
+    enum class Kind : uint8_t
+    {
+        Run,          // Set speed, hold for `durationUs` (0: next step on the same pass)
+        Move,         // Run at |speed| towards position `value`, stop when crossed
+        WaitPosition, // Keep the speed until the encoder crosses `value`
+        WaitCurrent   // Wait until the current stays below `value` for CURRENT_SETTLE_MS
+    };
+
+    Kind kind;
+    uint8_t axis;
+    int16_t speed;       // Per-mille
+    int32_t value;       // Position (counts) or current (ADC)
+    uint32_t durationUs; // Run: hold time; otherwise timeout, 0 for none
+};
+
+static_assert(sizeof(SequenceStep) == 12, "SequenceStep is stored as is");
+
+// Motion sequences played back from the control pass, so step timing does
+// not depend on network jitter. A program arrives as JSON (hub/cmd/sequence
+// or POST /api/sequence), is kept in RAM and in LittleFS, and survives a
+// reboot. Timed steps are chained on absolute deadlines: each one starts
+// where the previous was scheduled to end, so lateness never accumulates and
+// a step lasts its duration to within one control pass. Lateness against
+// the deadlines is reported in /api/sequence.
+//
+// handle() may be called from any task: uploads go to a staging copy and
+// commands to a one-slot mailbox, and the control pass picks both up.
+// Progress is mirrored into DeviceState for telemetry.
+class SequenceEngine
+{
+public:
+    // Loop task, after LittleFS is mounted: loads the stored program
+    static void begin();
+
+    // Any task. {"action":"upload","steps":[...],"loop":false,"start":false}
+    // or start/stop/pause/resume, or {"action":"loop","value":true}
+    static bool handle(JsonVariantConst command, const char *&error);
+
+    // Any task: stops a running or paused program on the next pass
+    static void stop();
+
+    // Control pass, between the sensor reads and the stall guards
+    static void tick(DeviceState &state);
+
+    // Loop task: writes a newly uploaded program to LittleFS
+    static void update();
+
+    // Any task
+    static void report(JsonObject out);
+
+private:
+    enum class Action : uint8_t
+    {
+        None,
+        Start,
+        Stop,
+        Pause,
+        Resume
+    };
+
+    static portMUX_TYPE mux;
+
+    // Program (written by the control pass, read under mux by report())
+    static SequenceStep steps[Config::Sequence::MAX_STEPS];
+    static uint16_t count;
+    static bool looping;
+    static uint8_t axesUsed; // Bit per axis the program drives
+
+    // Upload handoff: staging is claimed by one writer, then marked ready
+    static SequenceStep staged[Config::Sequence::MAX_STEPS];
+    static uint16_t stagedCount;
+    static bool stagedLoop;
+    static bool staging;
+    static bool stagedReady;
+    static bool persistPending; // Loop task only
+
+    // Mailbox
+    static Action pending;
+    static int8_t pendingLoop; // -1: unchanged
+
+    // Playback (control pass only). phase is also read by parse() on other
+    // tasks, so the control pass writes it under mux through setPhase()
+    static SequenceState phase;
+    static uint16_t index;
+    static uint32_t loops;
+    static int64_t deadlineUs;     // 0: none
+    static int64_t pausedRemainUs; // Deadline minus pause time
+    static int64_t belowSinceUs;   // WaitCurrent: start of the current run below threshold
+    static int8_t direction;       // Move/WaitPosition: sign of the approach
+    static int16_t pausedSpeeds[Config::Axes::COUNT];
+    static const char *failure;
+
+    // Stats (under mux)
+    static uint32_t stepsRun;
+    static uint32_t lastLateUs;
+    static uint32_t maxLateUs;
+
+    static bool parse(JsonVariantConst command, const char *&error);
+    static bool parseStep(JsonObjectConst in, SequenceStep &out, const char *&error);
+    static void writeStep(JsonObject out, const SequenceStep &step);
+
+    static void enter(DeviceState &state, int64_t startUs);
+    static bool finished(DeviceState &state, int64_t nowUs);
+    static void advance(DeviceState &state, int64_t startUs);
+    static void halt(DeviceState &state, SequenceState next, const char *reason);
+    static void setPhase(SequenceState next);
+    static void apply(Action action, DeviceState &state, int64_t nowUs);
+    static void publish(DeviceState &state);
+
+    static bool load();
+    static void save();
+};
+
+portMUX_TYPE SequenceEngine::mux = portMUX_INITIALIZER_UNLOCKED;
+SequenceStep SequenceEngine::steps[Config::Sequence::MAX_STEPS];
+uint16_t SequenceEngine::count = 0;
+bool SequenceEngine::looping = false;
+uint8_t SequenceEngine::axesUsed = 0;
+SequenceStep SequenceEngine::staged[Config::Sequence::MAX_STEPS];
+uint16_t SequenceEngine::stagedCount = 0;
+bool SequenceEngine::stagedLoop = false;
+bool SequenceEngine::staging = false;
+bool SequenceEngine::stagedReady = false;
+bool SequenceEngine::persistPending = false;
+SequenceEngine::Action SequenceEngine::pending = SequenceEngine::Action::None;
+int8_t SequenceEngine::pendingLoop = -1;
+SequenceState SequenceEngine::phase = SequenceState::Idle;
+uint16_t SequenceEngine::index = 0;
+uint32_t SequenceEngine::loops = 0;
+int64_t SequenceEngine::deadlineUs = 0;
+int64_t SequenceEngine::pausedRemainUs = 0;
+int64_t SequenceEngine::belowSinceUs = -1;
+int8_t SequenceEngine::direction = 0;
+int16_t SequenceEngine::pausedSpeeds[Config::Axes::COUNT];
+const char *SequenceEngine::failure = nullptr;
+uint32_t SequenceEngine::stepsRun = 0;
+uint32_t SequenceEngine::lastLateUs = 0;
+uint32_t SequenceEngine::maxLateUs = 0;
+
+namespace
+{
+    // Stored file: header, then `count` SequenceSteps
+    struct SequenceFileHeader
+    {
+        uint32_t magic;
+        uint16_t count;
+        uint8_t flags; // Bit 0: loop
+        uint8_t reserved;
+    };
+
+    constexpr uint32_t SEQUENCE_MAGIC = 0x31514553; // "SEQ1"
+}
+
+void SequenceEngine::begin()
+{
+    if (load())
+        LOG_I(Sequence, "Loaded %u step(s)%s", count, looping ? ", looping" : "");
+}
+
+bool SequenceEngine::handle(JsonVariantConst command, const char *&error)
+{
+    const char *action = command["action"] | "";
+
+    if (strcmp(action, "upload") == 0)
+        return parse(command, error);
+
+    Action next = Action::None;
+    if (strcmp(action, "start") == 0)
+        next = Action::Start;
+    else if (strcmp(action, "stop") == 0)
+        next = Action::Stop;
+    else if (strcmp(action, "pause") == 0)
+        next = Action::Pause;
+    else if (strcmp(action, "resume") == 0)
+        next = Action::Resume;
+    else if (strcmp(action, "loop") == 0)
+    {
+        portENTER_CRITICAL(&mux);
+        pendingLoop = (command["value"] | true) ? 1 : 0;
+        portEXIT_CRITICAL(&mux);
+        return true;
+    }
+    else
+    {
+        error = "unknown_action";
+        return false;
+    }
+
+    portENTER_CRITICAL(&mux);
+    pending = next;
+    portEXIT_CRITICAL(&mux);
+    return true;
+}
+
+void SequenceEngine::stop()
+{
+    portENTER_CRITICAL(&mux);
+    pending = Action::Stop;
+    portEXIT_CRITICAL(&mux);
+}
+
+bool SequenceEngine::parse(JsonVariantConst command, const char *&error)
+{
+    JsonArrayConst list = command["steps"];
+    if (list.isNull() || list.size() == 0)
+    {
+        error = "no_steps";
+        return false;
+    }
+    if (list.size() > Config::Sequence::MAX_STEPS)
+    {
+        error = "too_many_steps";
+        return false;
+    }
+
+    portENTER_CRITICAL(&mux);
+    bool busy = staging || stagedReady || phase == SequenceState::Running || phase == SequenceState::Paused;
+    if (!busy)
+        staging = true;
+    portEXIT_CRITICAL(&mux);
+    if (busy)
+    {
+        error = "busy";
+        return false;
+    }
+
+    // Staging is ours until it is marked ready or released
+    uint16_t n = 0;
+    bool ok = true;
+    for (JsonObjectConst in : list)
+    {
+        if (!parseStep(in, staged[n], error))
+        {
+            ok = false;
+            break;
+        }
+        n++;
+    }
+
+    portENTER_CRITICAL(&mux);
+    staging = false;
+    if (ok)
+    {
+        stagedCount = n;
+        stagedLoop = command["loop"] | false;
+        stagedReady = true;
+        if (command["start"] | false)
+            pending = Action::Start;
+    }
+    portEXIT_CRITICAL(&mux);
+    return ok;
+}
+
+bool SequenceEngine::parseStep(JsonObjectConst in, SequenceStep &out, const char *&error)
+{
+    out = {};
+    out.axis = in["axis"] | 0;
+    if (out.axis >= Config::Axes::COUNT)
+    {
+        error = "bad_axis";
+        return false;
+    }
+
+    int speed = in["speed"] | 0;
+    if (speed < -Config::Motor::SPEED_SCALE || speed > Config::Motor::SPEED_SCALE)
+    {
+        error = "bad_speed";
+        return false;
+    }
+    out.speed = speed;
+
+    // "us" for sub-millisecond holds; "timeoutMs" for the waiting kinds
+    uint32_t ms = in["ms"].is<uint32_t>() ? in["ms"].as<uint32_t>() : in["timeoutMs"] | 0u;
+    if (ms > Config::Sequence::MAX_STEP_MS)
+    {
+        error = "bad_duration";
+        return false;
+    }
+    out.durationUs = in["us"].is<uint32_t>() ? in["us"].as<uint32_t>() : ms * 1000;
+
+    if (in["target"].is<int32_t>())
+    {
+        out.kind = SequenceStep::Kind::Move;
+        out.value = in["target"];
+        if (speed == 0)
+        {
+            error = "move_without_speed";
+            return false;
+        }
+    }
+    else if (in["waitPos"].is<int32_t>())
+    {
+        out.kind = SequenceStep::Kind::WaitPosition;
+        out.value = in["waitPos"];
+    }
+    else if (in["waitCurrentBelow"].is<int32_t>())
+    {
+        out.kind = SequenceStep::Kind::WaitCurrent;
+        out.value = in["waitCurrentBelow"];
+    }
+    else if (in["speed"].is<int>())
+    {
+        out.kind = SequenceStep::Kind::Run;
+    }
+    else
+    {
+        error = "bad_step";
+        return false;
+    }
+    return true;
+}
+
+void SequenceEngine::writeStep(JsonObject out, const SequenceStep &step)
+{
+    out["axis"] = step.axis;
+    switch (step.kind)
+    {
+    case SequenceStep::Kind::Run:
+        out["speed"] = step.speed;
+        if (step.durationUs % 1000)
+            out["us"] = step.durationUs;
+        else
+            out["ms"] = step.durationUs / 1000;
+        return;
+    case SequenceStep::Kind::Move:
+        out["target"] = step.value;
+        out["speed"] = step.speed;
+        break;
+    case SequenceStep::Kind::WaitPosition:
+        out["waitPos"] = step.value;
+        break;
+    case SequenceStep::Kind::WaitCurrent:
+        out["waitCurrentBelow"] = step.value;
+        break;
+    }
+    if (step.durationUs)
+        out["timeoutMs"] = step.durationUs / 1000;
+}
+
+void SequenceEngine::tick(DeviceState &state)
+{
+    int64_t now = Timebase::nowUs();
+
+    portENTER_CRITICAL(&mux);
+    Action action = pending;
+    pending = Action::None;
+    int8_t loopRequest = pendingLoop;
+    pendingLoop = -1;
+    bool ready = stagedReady;
+    if (loopRequest >= 0)
+        looping = loopRequest;
+    portEXIT_CRITICAL(&mux);
+
+    if (ready)
+    {
+        // parse() refuses uploads while a program plays, but a start can
+        // still slip in between its check and the handoff: stop the old
+        // program on its own axes before its steps are overwritten
+        if (phase == SequenceState::Running || phase == SequenceState::Paused)
+        {
+            halt(state, SequenceState::Idle, nullptr);
+            LOG_W(Sequence, "Upload replaced the running program at step %u", index);
+        }
+
+        // Staging stays put while stagedReady is set
+        portENTER_CRITICAL(&mux);
+        memcpy(steps, staged, stagedCount * sizeof(SequenceStep));
+        count = stagedCount;
+        looping = stagedLoop;
+        stagedReady = false;
+        portEXIT_CRITICAL(&mux);
+
+        axesUsed = 0;
+        for (uint16_t i = 0; i < count; i++)
+            axesUsed |= 1u << steps[i].axis;
+        setPhase(SequenceState::Idle);
+        index = 0;
+        persistPending = true;
+        LOG_I(Sequence, "Program loaded: %u step(s)", count);
+    }
+
+    if (action != Action::None)
+        apply(action, state, now);
+
+    if (phase == SequenceState::Running)
+    {
+        // A stall latched by the guard would otherwise be overridden by the next step
+        for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+        {
+            if ((axesUsed & (1u << i)) && state.axes[i].loadStall)
+            {
+                halt(state, SequenceState::Failed, "stall");
+                break;
+            }
+        }
+    }
+
+    // Zero-length steps chain on the same pass; one lap at most, so a
+    // looping program of zero-length steps cannot hold the loop
+    for (uint16_t guard = 0; phase == SequenceState::Running && guard <= count; guard++)
+    {
+        if (!finished(state, now))
+            break;
+
+        // Timed steps hand their deadline on, waits start the next step now
+        bool timed = steps[index].kind == SequenceStep::Kind::Run;
+        advance(state, timed ? deadlineUs : now);
+    }
+
+    publish(state);
+}
+
+void SequenceEngine::apply(Action action, DeviceState &state, int64_t nowUs)
+{
+    switch (action)
+    {
+    case Action::Start:
+        if (count == 0)
+        {
+            LOG_W(Sequence, "Start: no program");
+            return;
+        }
+        if (phase == SequenceState::Running || phase == SequenceState::Paused)
+            halt(state, SequenceState::Idle, nullptr);
+        failure = nullptr;
+        loops = 0;
+        index = 0;
+        setPhase(SequenceState::Running);
+        portENTER_CRITICAL(&mux);
+        maxLateUs = 0;
+        portEXIT_CRITICAL(&mux);
+        LOG_I(Sequence, "Started, %u step(s)", count);
+        enter(state, nowUs);
+        break;
+
+    case Action::Stop:
+        if (phase == SequenceState::Running || phase == SequenceState::Paused)
+        {
+            halt(state, SequenceState::Idle, nullptr);
+            LOG_I(Sequence, "Stopped at step %u", index);
+        }
+        break;
+
+    case Action::Pause:
+        if (phase != SequenceState::Running)
+            return;
+        pausedRemainUs = deadlineUs ? deadlineUs - nowUs : 0;
+        for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+        {
+            pausedSpeeds[i] = state.axes[i].motorSpeed;
+            if (axesUsed & (1u << i))
+                state.axes[i].motorSpeed = 0;
+        }
+        setPhase(SequenceState::Paused);
+        LOG_I(Sequence, "Paused at step %u", index);
+        break;
+
+    case Action::Resume:
+        if (phase != SequenceState::Paused)
+            return;
+        for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+        {
+            if (axesUsed & (1u << i))
+                state.axes[i].motorSpeed = pausedSpeeds[i];
+        }
+        if (deadlineUs)
+            deadlineUs = nowUs + pausedRemainUs;
+        belowSinceUs = -1;
+        setPhase(SequenceState::Running);
+        LOG_I(Sequence, "Resumed at step %u", index);
+        break;
+
+    case Action::None:
+        break;
+    }
+}
+
+void SequenceEngine::enter(DeviceState &state, int64_t startUs)
+{
+    const SequenceStep &step = steps[index];
+    AxisState &axis = state.axes[step.axis];
+
+    deadlineUs = step.durationUs ? startUs + step.durationUs : 0; // Timeout of the waiting kinds
+    belowSinceUs = -1;
+    direction = 0;
+
+    switch (step.kind)
+    {
+    case SequenceStep::Kind::Run:
+        axis.motorSpeed = step.speed;
+        deadlineUs = startUs + step.durationUs;
+        break;
+    case SequenceStep::Kind::Move:
+        direction = step.value > axis.encoderPos ? 1 : step.value < axis.encoderPos ? -1 : 0;
+        axis.motorSpeed = direction * abs(step.speed);
+        break;
+    case SequenceStep::Kind::WaitPosition:
+        direction = step.value > axis.encoderPos ? 1 : step.value < axis.encoderPos ? -1 : 0;
+        break;
+    case SequenceStep::Kind::WaitCurrent:
+        break;
+    }
+
+    portENTER_CRITICAL(&mux);
+    stepsRun++;
+    portEXIT_CRITICAL(&mux);
+}
+
+bool SequenceEngine::finished(DeviceState &state, int64_t nowUs)
+{
+    const SequenceStep &step = steps[index];
+    AxisState &axis = state.axes[step.axis];
+
+    if (step.kind == SequenceStep::Kind::Run)
+    {
+        if (nowUs < deadlineUs)
+            return false;
+
+        uint32_t late = nowUs - deadlineUs;
+        portENTER_CRITICAL(&mux);
+        lastLateUs = late;
+        if (late > maxLateUs)
+            maxLateUs = late;
+        portEXIT_CRITICAL(&mux);
+        return true;
+    }
+
+    bool done = false;
+    switch (step.kind)
+    {
+    case SequenceStep::Kind::Move:
+    case SequenceStep::Kind::WaitPosition:
+        done = direction > 0 ? axis.encoderPos >= step.value : direction < 0 ? axis.encoderPos <= step.value : true;
+        if (done && step.kind == SequenceStep::Kind::Move)
+            axis.motorSpeed = 0;
+        break;
+    case SequenceStep::Kind::WaitCurrent:
+        if (axis.currentAdc >= step.value)
+            belowSinceUs = -1;
+        else if (belowSinceUs < 0)
+            belowSinceUs = nowUs;
+        done = belowSinceUs >= 0 && nowUs - belowSinceUs >= (int64_t)Config::Sequence::CURRENT_SETTLE_MS * 1000;
+        break;
+    case SequenceStep::Kind::Run:
+        break;
+    }
+
+    if (!done && deadlineUs && nowUs >= deadlineUs)
+    {
+        LOG_W(Sequence, "Step %u timed out", index);
+        halt(state, SequenceState::Failed, "timeout");
+    }
+    return done;
+}
+
+void SequenceEngine::advance(DeviceState &state, int64_t startUs)
+{
+    if (++index < count)
+    {
+        enter(state, startUs);
+        return;
+    }
+
+    if (looping)
+    {
+        index = 0;
+        loops++;
+        enter(state, startUs);
+        return;
+    }
+
+    halt(state, SequenceState::Done, nullptr);
+    LOG_I(Sequence, "Done");
+}
+
+void SequenceEngine::halt(DeviceState &state, SequenceState next, const char *reason)
+{
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        if (axesUsed & (1u << i))
+            state.axes[i].motorSpeed = 0;
+    }
+    setPhase(next);
+    deadlineUs = 0;
+    failure = reason;
+}
+
+void SequenceEngine::setPhase(SequenceState next)
+{
+    portENTER_CRITICAL(&mux);
+    phase = next;
+    portEXIT_CRITICAL(&mux);
+}
+
+void SequenceEngine::publish(DeviceState &state)
+{
+    state.sequenceState = phase;
+    state.sequenceStep = index;
+    state.sequenceLoops = loops;
+}
+
+void SequenceEngine::update()
+{
+    if (!persistPending)
+        return;
+    persistPending = false;
+    save();
+}
+
+bool SequenceEngine::load()
+{
+#if AF_FEATURE_NETWORK
+    File file = LittleFS.open(Config::Sequence::FILE_PATH, "r");
+    if (!file)
+        return false;
+
+    SequenceFileHeader header;
+    bool ok = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == SEQUENCE_MAGIC && header.count <= Config::Sequence::MAX_STEPS &&
+              file.size() == sizeof(header) + header.count * sizeof(SequenceStep);
+    if (ok)
+        ok = file.read((uint8_t *)steps, header.count * sizeof(SequenceStep)) == header.count * sizeof(SequenceStep);
+    file.close();
+
+    // The same bounds parseStep() enforces; playback switches on the kind
+    for (uint16_t i = 0; ok && i < header.count; i++)
+        ok = steps[i].axis < Config::Axes::COUNT &&
+             (uint8_t)steps[i].kind <= (uint8_t)SequenceStep::Kind::WaitCurrent &&
+             abs(steps[i].speed) <= Config::Motor::SPEED_SCALE;
+
+    if (!ok)
+    {
+        LOG_W(Sequence, "Ignoring invalid %s", Config::Sequence::FILE_PATH);
+        return false;
+    }
+
+    count = header.count;
+    looping = header.flags & 1;
+    axesUsed = 0;
+    for (uint16_t i = 0; i < count; i++)
+        axesUsed |= 1u << steps[i].axis;
+    return true;
+#else
+    // Programs only arrive over the network; nothing is stored
+    return false;
+#endif
+}
+
+void SequenceEngine::save()
+{
+#if AF_FEATURE_NETWORK
+    // Only the control pass changes the program, and it runs on this task
+    SequenceFileHeader header = {SEQUENCE_MAGIC, count, (uint8_t)(looping ? 1 : 0), 0};
+
+    File file = LittleFS.open(Config::Sequence::FILE_PATH, "w");
+    if (!file)
+    {
+        LOG_E(Sequence, "Cannot write %s", Config::Sequence::FILE_PATH);
+        return;
+    }
+    file.write((const uint8_t *)&header, sizeof(header));
+    file.write((const uint8_t *)steps, count * sizeof(SequenceStep));
+    file.close();
+    LOG_D(Sequence, "Saved %u step(s), %u bytes", count, (unsigned)(sizeof(header) + count * sizeof(SequenceStep)));
+#endif
+}
+
+void SequenceEngine::report(JsonObject out)
+{
+    portENTER_CRITICAL(&mux);
+    SequenceState state = phase;
+    uint16_t step = index;
+    uint16_t steps = count;
+    bool loop = looping;
+    uint32_t laps = loops;
+    const char *reason = failure;
+    uint32_t run = stepsRun;
+    uint32_t late = lastLateUs;
+    uint32_t worst = maxLateUs;
+    portEXIT_CRITICAL(&mux);
+
+    out["state"] = sequenceStateName(state);
+    out["step"] = step;
+    out["steps"] = steps;
+    out["loop"] = loop;
+    out["loops"] = laps;
+    if (reason)
+        out["error"] = reason;
+    out["stepsRun"] = run;
+    out["lastLateUs"] = late;
+    out["maxLateUs"] = worst;
+
+    JsonArray list = out["program"].to<JsonArray>();
+    for (uint16_t i = 0; i < steps; i++)
+    {
+        portENTER_CRITICAL(&mux);
+        SequenceStep copy = SequenceEngine::steps[i];
+        portEXIT_CRITICAL(&mux);
+        writeStep(list.add<JsonObject>(), copy);
+    }
+}
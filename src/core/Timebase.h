@@ -0,0 +1,171 @@
+#pragma once
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include "Host.h"
+#endif
+#include <ArduinoJson.h>
+#include <sys/time.h>
+#include "DeviceState.h"
+#include "Config.h"
+#include "Log.h"
+#include "FixedString.h"
+#if AF_FEATURE_NETWORK
+#include <Preferences.h>
+#include <esp_sntp.h>
+#endif
+
+// Device timebase. nowUs()/nowMs() are 64-bit and monotonic from boot
+// (esp_timer), so interval checks never wrap and samples from different
+// modules share one clock. With an NTP server configured, SNTP runs after
+// the first WiFi connection; each sync records the wall-minus-monotonic
+// offset and, from consecutive syncs, the crystal's drift, so wallUs() maps
+// any monotonic timestamp to Unix time without trusting the system clock to
+// never step. Safe from any task.
+class Timebase
+{
+public:
+    static int64_t nowUs() { return esp_timer_get_time(); }
+    static uint64_t nowMs() { return esp_timer_get_time() / 1000; }
+
+    // True once `intervalMs` has passed since `sinceMs` (both from nowMs())
+    static bool elapsed(uint64_t sinceMs, uint64_t intervalMs) { return nowMs() - sinceMs >= intervalMs; }
+
+    // Loop task: reads the NTP server from NVS or Config
+    static void begin();
+    // Loop task: starts SNTP once WiFi is up
+    static void update(const DeviceState &state);
+
+    static bool synced() { return syncCount != 0; }
+
+    // Unix time in us for a nowUs() timestamp; 0 until the first sync
+    static int64_t wallUs(int64_t monoUs);
+
+    // Adds "ts" (monotonic ms) and, once synced, "utc" (Unix ms) for `monoUs`
+    static void stamp(JsonObject out, int64_t monoUs = nowUs());
+
+    static void report(JsonObject out);
+
+private:
+    static portMUX_TYPE mux;
+    static FixedString<64> server;
+    static bool started;
+    static uint32_t syncCount;
+    static int64_t syncMonoUs;    // Monotonic time of the last sync
+    static int64_t offsetUs;      // Wall minus monotonic at that sync
+    static double driftPpm;       // Wall clock gain per monotonic second
+    static int64_t lastErrorUs;   // Last sync vs. what the previous estimate predicted
+
+    static void onSync(struct timeval *tv);
+};
+
+portMUX_TYPE Timebase::mux = portMUX_INITIALIZER_UNLOCKED;
+FixedString<64> Timebase::server;
+bool Timebase::started = false;
+uint32_t Timebase::syncCount = 0;
+int64_t Timebase::syncMonoUs = 0;
+int64_t Timebase::offsetUs = 0;
+double Timebase::driftPpm = 0;
+int64_t Timebase::lastErrorUs = 0;
+
+void Timebase::begin()
+{
+#if AF_FEATURE_NETWORK
+    Preferences prefs;
+    prefs.begin("wifi-cfg", true);
+    char stored[64] = "";
+    prefs.getString("ntp_server", stored, sizeof(stored));
+    prefs.end();
+
+    server = stored[0] ? stored : Config::Time::NTP_SERVER;
+#endif
+    if (server.isEmpty())
+        LOG_I(Time, "No NTP server; timestamps are monotonic only");
+}
+
+void Timebase::update(const DeviceState &state)
+{
+#if AF_FEATURE_NETWORK
+    if (started || server.isEmpty() || !state.wifiConnected)
+        return;
+
+    started = true;
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, server.c_str());
+    sntp_set_sync_interval(Config::Time::SYNC_INTERVAL_MS);
+    sntp_set_time_sync_notification_cb(onSync);
+    sntp_init();
+    LOG_I(Time, "SNTP started with %s", server.c_str());
+#endif
+}
+
+// lwIP task, right after the system clock was set to `tv`
+void Timebase::onSync(struct timeval *tv)
+{
+    int64_t mono = nowUs();
+    int64_t offset = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - mono;
+
+    portENTER_CRITICAL(&mux);
+    if (syncCount > 0)
+    {
+        int64_t span = mono - syncMonoUs;
+        int64_t predicted = offsetUs + (int64_t)(driftPpm * span / 1e6);
+        lastErrorUs = offset - predicted;
+        if (span >= (int64_t)Config::Time::MIN_DRIFT_SPAN_MS * 1000)
+        {
+            double measured = (double)(offset - offsetUs) * 1e6 / span;
+            driftPpm = syncCount == 1 ? measured : driftPpm + Config::Time::DRIFT_SMOOTHING * (measured - driftPpm);
+        }
+    }
+    syncMonoUs = mono;
+    offsetUs = offset;
+    syncCount++;
+    int64_t error = lastErrorUs;
+    double drift = driftPpm;
+    portEXIT_CRITICAL(&mux);
+
+    LOG_D(Time, "SNTP sync: error %lld us, drift %.2f ppm", (long long)error, drift);
+}
+
+int64_t Timebase::wallUs(int64_t monoUs)
+{
+    portENTER_CRITICAL(&mux);
+    bool valid = syncCount != 0;
+    int64_t since = monoUs - syncMonoUs;
+    int64_t wall = monoUs + offsetUs + (int64_t)(driftPpm * since / 1e6);
+    portEXIT_CRITICAL(&mux);
+    return valid ? wall : 0;
+}
+
+void Timebase::stamp(JsonObject out, int64_t monoUs)
+{
+    out["ts"] = (uint64_t)(monoUs / 1000);
+    int64_t wall = wallUs(monoUs);
+    if (wall)
+        out["utc"] = (uint64_t)(wall / 1000);
+}
+
+void Timebase::report(JsonObject out)
+{
+    portENTER_CRITICAL(&mux);
+    uint32_t syncs = syncCount;
+    int64_t lastSync = syncMonoUs;
+    int64_t error = lastErrorUs;
+    double drift = driftPpm;
+    portEXIT_CRITICAL(&mux);
+
+    int64_t now = nowUs();
+    out["monotonicUs"] = now;
+    out["server"] = server.c_str();
+    out["synced"] = syncs != 0;
+    out["syncs"] = syncs;
+    if (syncs)
+    {
+        out["utcMs"] = (uint64_t)(wallUs(now) / 1000);
+        out["sinceSyncMs"] = (uint64_t)((now - lastSync) / 1000);
+        out["driftPpm"] = drift;
+        out["lastErrorUs"] = error;
+    }
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <esp_ipc.h>
+#include <esp_pm.h>
+#include <hal/cpu_hal.h>
+#include "Config.h"
+#include "Log.h"
+#include "Timebase.h"
+
+// Timeline recorder for loop phases, module updates, handlers and ISRs.
+// A capture is armed with request() and runs for a fixed window: every
+// TRACE_SCOPE / TRACE_INSTANT then appends a 20-byte event stamped with the
+// CPU cycle counter into one PSRAM buffer (one atomic add per event, safe
+// from ISRs and both cores). Outside a capture the cost is one load.
+//
+// Cycle counters are per core and follow frequency changes, so the recorder
+// also drops Sync events pairing a cycle count with esp_timer microseconds;
+// tools/trace_to_chrome.py maps cycles to time between those anchors.
+//
+//     TRACE_SCOPE("mqtt");          // Begin now, End at scope exit
+//     TRACE_INSTANT("enc_index", i); // Point event with a 32-bit argument
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INSTANT(name, arg)                                             \
+    do                                                                       \
+    {                                                                        \
+        if constexpr (Config::Trace::ENABLED)                                \
+            Trace::record(name, Trace::Phase::Instant, (uint32_t)(arg));     \
+    } while (0)
+
+class Trace
+{
+public:
+    enum class Phase : uint8_t
+    {
+        Begin = 'B',
+        End = 'E',
+        Instant = 'i',
+        Sync = 'S' // arg = esp_timer_get_time() low 32 bits
+    };
+
+    struct Event
+    {
+        uint32_t cycles;
+        const char *name;
+        uint32_t arg;
+        TaskHandle_t task; // nullptr in ISRs
+        Phase phase;
+        uint8_t core;
+        uint16_t reserved;
+    };
+
+    // Export layout: Header, names {ptr, len, chars}, tasks {handle, len, chars}, events
+    struct Header
+    {
+        char magic[4]; // "AFTR"
+        uint16_t version;
+        uint16_t eventSize;
+        uint32_t cpuMhz;
+        uint32_t events;
+        uint32_t dropped;
+        uint16_t names;
+        uint16_t tasks;
+    };
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char *name) : name(name)
+        {
+            if constexpr (Config::Trace::ENABLED)
+                record(name, Phase::Begin, 0);
+        }
+        ~Scope()
+        {
+            if constexpr (Config::Trace::ENABLED)
+                record(name, Phase::End, 0);
+        }
+
+    private:
+        const char *name;
+    };
+
+    static void IRAM_ATTR record(const char *name, Phase phase, uint32_t arg)
+    {
+        if (!recording)
+            return;
+        append(name, phase, arg);
+    }
+
+    // Safe from any task: the loop starts the capture on its next pass
+    static void request(uint32_t durationMs);
+
+    // Loop task: starts, syncs and finishes captures
+    static void update();
+
+    static bool busy() { return recording || pendingMs != 0; }
+    static uint32_t eventCount() { return min(next.load(), (uint32_t)Config::Trace::MAX_EVENTS); }
+
+    // Finished capture, 0 if none
+    static size_t exportSize();
+    // Copies up to maxLen bytes of the export starting at `offset`
+    static size_t read(uint8_t *out, size_t maxLen, size_t offset);
+
+private:
+    static constexpr size_t NAME_LENGTH = 31;
+    static constexpr size_t PREAMBLE_SIZE = sizeof(Header) +
+                                            Config::Trace::MAX_NAMES * (sizeof(uint32_t) + 1 + NAME_LENGTH) +
+                                            Config::Memory::MAX_TASKS * (sizeof(uint32_t) + 1 + configMAX_TASK_NAME_LEN);
+
+    static uint8_t *buffer; // Preamble followed by the events
+    static Event *events;
+    static std::atomic<uint32_t> next;
+    static std::atomic<uint32_t> committed;
+    static std::atomic<uint32_t> dropped;
+    static volatile bool recording;
+    static volatile uint32_t pendingMs;
+
+    static uint64_t startMs;
+    static uint32_t durationMs;
+    static uint64_t lastSyncMs;
+    static size_t preambleSize;
+    static uint32_t capturedEvents;
+    static esp_pm_lock_handle_t cpuLock;
+
+    static void IRAM_ATTR append(const char *name, Phase phase, uint32_t arg);
+    static void sync(void *arg = nullptr);
+    static void syncAllCores();
+    static bool allocate();
+    static void start();
+    static void finish();
+    static void buildPreamble();
+};
+
+uint8_t *Trace::buffer = nullptr;
+Trace::Event *Trace::events = nullptr;
+std::atomic<uint32_t> Trace::next{0};
+std::atomic<uint32_t> Trace::committed{0};
+std::atomic<uint32_t> Trace::dropped{0};
+volatile bool Trace::recording = false;
+volatile uint32_t Trace::pendingMs = 0;
+uint64_t Trace::startMs = 0;
+uint32_t Trace::durationMs = 0;
+uint64_t Trace::lastSyncMs = 0;
+size_t Trace::preambleSize = 0;
+uint32_t Trace::capturedEvents = 0;
+esp_pm_lock_handle_t Trace::cpuLock = nullptr;
+
+void IRAM_ATTR Trace::append(const char *name, Phase phase, uint32_t arg)
+{
+    uint32_t cycles = cpu_hal_get_cycle_count();
+    uint32_t i = next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= Config::Trace::MAX_EVENTS)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event &e = events[i];
+    e.cycles = cycles;
+    e.name = name;
+    e.arg = arg;
+    e.task = xPortInIsrContext() ? nullptr : xTaskGetCurrentTaskHandle();
+    e.phase = phase;
+    e.core = xPortGetCoreID();
+    committed.fetch_add(1, std::memory_order_release);
+}
+
+void Trace::request(uint32_t ms)
+{
+    pendingMs = constrain(ms, (uint32_t)1, Config::Trace::MAX_DURATION_MS);
+}
+
+void Trace::sync(void *)
+{
+    append("sync", Phase::Sync, (uint32_t)esp_timer_get_time());
+}
+
+void Trace::syncAllCores()
+{
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        if (core == xPortGetCoreID())
+            sync();
+        else
+            esp_ipc_call_blocking(core, sync, nullptr);
+    }
+}
+
+bool Trace::allocate()
+{
+    if (buffer)
+        return true;
+
+    size_t size = PREAMBLE_SIZE + Config::Trace::MAX_EVENTS * sizeof(Event);
+    buffer = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buffer)
+    {
+        LOG_E(Trace, "No PSRAM for a %u byte trace buffer", (unsigned)size);
+        return false;
+    }
+    events = (Event *)(buffer + PREAMBLE_SIZE);
+    return true;
+}
+
+void Trace::update()
+{
+    if constexpr (!Config::Trace::ENABLED)
+        return;
+
+    uint64_t now = Timebase::nowMs();
+    if (!recording)
+    {
+        if (pendingMs)
+            start();
+        return;
+    }
+
+    if (now - startMs >= durationMs || next.load(std::memory_order_relaxed) >= Config::Trace::MAX_EVENTS)
+    {
+        finish();
+    }
+    else if (now - lastSyncMs >= Config::Trace::SYNC_INTERVAL_MS)
+    {
+        lastSyncMs = now;
+        sync();
+    }
+}
+
+void Trace::start()
+{
+    durationMs = pendingMs;
+    pendingMs = 0;
+    if (!allocate())
+        return;
+
+#if CONFIG_PM_ENABLE
+    // Keep the cycle counter at one rate for the whole window
+    if (!cpuLock)
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "trace", &cpuLock);
+    if (cpuLock)
+        esp_pm_lock_acquire(cpuLock);
+#endif
+
+    preambleSize = 0;
+    next.store(0);
+    committed.store(0);
+    dropped.store(0);
+    startMs = lastSyncMs = Timebase::nowMs();
+    recording = true;
+    syncAllCores();
+
+    LOG_I(Trace, "Capture started for %lu ms", (unsigned long)durationMs);
+}
+
+void Trace::finish()
+{
+    syncAllCores();
+    recording = false;
+
+    // Let writers that already claimed a slot land their event
+    uint32_t claimed = eventCount();
+    for (uint8_t i = 0; i < 10 && committed.load(std::memory_order_acquire) < claimed; i++)
+        delay(1);
+    capturedEvents = committed.load(std::memory_order_acquire);
+
+#if CONFIG_PM_ENABLE
+    if (cpuLock)
+        esp_pm_lock_release(cpuLock);
+#endif
+
+    buildPreamble();
+    LOG_I(Trace, "Capture done: %lu events, %lu dropped", (unsigned long)capturedEvents, (unsigned long)dropped.load());
+}
+
+void Trace::buildPreamble()
+{
+    uint8_t *p = buffer + sizeof(Header);
+    uint8_t *end = buffer + PREAMBLE_SIZE;
+
+    // Distinct name pointers, in first-seen order
+    const char *names[Config::Trace::MAX_NAMES];
+    uint16_t nameCount = 0;
+    for (uint32_t i = 0; i < capturedEvents && nameCount < Config::Trace::MAX_NAMES; i++)
+    {
+        uint16_t n = 0;
+        while (n < nameCount && names[n] != events[i].name)
+            n++;
+        if (n == nameCount)
+            names[nameCount++] = events[i].name;
+    }
+
+    for (uint16_t n = 0; n < nameCount; n++)
+    {
+        uint32_t ptr = (uint32_t)(uintptr_t)names[n];
+        uint8_t len = strnlen(names[n], NAME_LENGTH);
+        memcpy(p, &ptr, sizeof(ptr));
+        p[sizeof(ptr)] = len;
+        memcpy(p + sizeof(ptr) + 1, names[n], len);
+        p += sizeof(ptr) + 1 + len;
+    }
+
+    uint16_t taskCount = 0;
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t status[Config::Memory::MAX_TASKS];
+    UBaseType_t n = uxTaskGetSystemState(status, Config::Memory::MAX_TASKS, nullptr);
+    for (UBaseType_t i = 0; i < n && p + sizeof(uint32_t) + 1 + configMAX_TASK_NAME_LEN <= end; i++)
+    {
+        uint32_t handle = (uint32_t)(uintptr_t)status[i].xHandle;
+        uint8_t len = strnlen(status[i].pcTaskName, configMAX_TASK_NAME_LEN);
+        memcpy(p, &handle, sizeof(handle));
+        p[sizeof(handle)] = len;
+        memcpy(p + sizeof(handle) + 1, status[i].pcTaskName, len);
+        p += sizeof(handle) + 1 + len;
+        taskCount++;
+    }
+#endif
+
+    Header header = {{'A', 'F', 'T', 'R'}, 1, sizeof(Event), getCpuFrequencyMhz(),
+                     capturedEvents, dropped.load(), nameCount, taskCount};
+    memcpy(buffer, &header, sizeof(header));
+    preambleSize = p - buffer;
+}
+
+size_t Trace::exportSize()
+{
+    if (recording || !preambleSize)
+        return 0;
+    return preambleSize + capturedEvents * sizeof(Event);
+}
+
+size_t Trace::read(uint8_t *out, size_t maxLen, size_t offset)
+{
+    size_t total = exportSize();
+    if (offset >= total)
+        return 0;
+
+    size_t n = min(maxLen, total - offset);
+    size_t copied = 0;
+    if (offset < preambleSize)
+    {
+        size_t chunk = min(n, preambleSize - offset);
+        memcpy(out, buffer + offset, chunk);
+        copied = chunk;
+        offset += chunk;
+    }
+    if (copied < n)
+    {
+        // Events sit right after the reserved preamble area, not right after the used part
+        memcpy(out + copied, (uint8_t *)events + (offset - preambleSize), n - copied);
+    }
+    return n;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Latest-wins handoff from one writer to one reader; also compiled into the
+// native host tests (test/). The writer fills its private slot and swaps it
+// into the shared index; the reader swaps the shared slot for its own when
+// the fresh bit is set. Neither side waits or locks, and values written
+// between two takes collapse into the last one. The index is a single 32-bit
+// word, which the Xtensa cores handle lock-free.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Writer only. Returns false when it replaced a value the reader had not
+    // taken yet.
+    bool write(const T &value);
+
+    // Reader only. True when a newer value was taken; read() then returns it
+    bool take();
+
+    // Reader only: the value last taken, T{} before the first
+    const T &read() const { return slots[reading]; }
+
+private:
+    static constexpr uint32_t FRESH = 4; // Shared word: slot index | FRESH
+
+    T slots[3] = {};
+    std::atomic<uint32_t> shared{1};
+    uint8_t writing = 0; // Writer's slot
+    uint8_t reading = 2; // Reader's slot
+};
+
+template <typename T>
+bool TripleBuffer<T>::write(const T &value)
+{
+    slots[writing] = value;
+    // Release publishes the slot contents along with its index
+    uint32_t previous = shared.exchange(writing | FRESH, std::memory_order_acq_rel);
+    writing = previous & (FRESH - 1);
+    return !(previous & FRESH);
+}
+
+template <typename T>
+bool TripleBuffer<T>::take()
+{
+    if (!(shared.load(std::memory_order_relaxed) & FRESH))
+        return false;
+
+    // Acquire makes the writer's slot contents visible
+    uint32_t previous = shared.exchange(reading, std::memory_order_acq_rel);
+    reading = previous & (FRESH - 1);
+    return true;
+}
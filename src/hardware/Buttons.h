@@ -2,13 +2,15 @@
 #include <EncButton.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
-#include "../network/WiFiManager.h"
+#include "../core/Log.h"
+#include "../core/PowerManager.h"
+#include "../core/Timebase.h"
 
 class Buttons
 {
 public:
     void begin();
-    void update(DeviceState &state, WiFiManager &wifi);
+    void update(DeviceState &state);
 
 private:
     Button up{Config::Pins::BTN_UP};
@@ -17,7 +19,7 @@ private:
 
     bool upWasPressed = false;
     bool downWasPressed = false;
-    unsigned long setupButtonPressTime = 0;
+    uint64_t setupButtonPressTime = 0;
     bool setupButtonWasPressed = false;
 };
 
@@ -28,52 +30,60 @@ void Buttons::begin()
     pinMode(Config::Pins::BTN_SETUP, INPUT_PULLUP);
 }
 
-void Buttons::update(DeviceState &state, WiFiManager &wifi)
+void Buttons::update(DeviceState &state)
 {
     up.tick();
     down.tick();
     setup.tick();
 
+    if (up.press() || down.press() || setup.press())
+        PowerManager::notifyActivity();
+
     // Motor control buttons - only control when pressed
     if (up.press())
         upWasPressed = true;
     if (down.press())
         downWasPressed = true;
 
+    AxisState &axis = state.axes[0];
     if (up.hold())
     {
-        state.motorSpeed = Config::Motor::MAX_SPEED;
+        axis.motorSpeed = Config::Motor::MAX_SPEED;
+        axis.stampCommand(CommandSource::Button, micros());
     }
     else if (down.hold())
     {
-        state.motorSpeed = -Config::Motor::MAX_SPEED;
+        axis.motorSpeed = -Config::Motor::MAX_SPEED;
+        axis.stampCommand(CommandSource::Button, micros());
     }
     else if (upWasPressed && up.release())
     {
-        state.motorSpeed = 0;
+        axis.motorSpeed = 0;
+        axis.stampCommand(CommandSource::Button, micros());
         upWasPressed = false;
     }
     else if (downWasPressed && down.release())
     {
-        state.motorSpeed = 0;
+        axis.motorSpeed = 0;
+        axis.stampCommand(CommandSource::Button, micros());
         downWasPressed = false;
     }
 
     // Setup button logic
     if (setup.press())
     {
-        setupButtonPressTime = millis();
+        setupButtonPressTime = Timebase::nowMs();
         setupButtonWasPressed = true;
-        Serial0.printf("%s Setup button pressed, hold for %d seconds...\n", Config::Debug::LOG_BTN, Config::Button::SETUP_HOLD_TIME_MS / 1000);
+        LOG_I(Button, "Setup button pressed, hold for %d seconds...", Config::Button::SETUP_HOLD_TIME_MS / 1000);
     }
 
     if (setupButtonWasPressed && setup.hold())
     {
-        unsigned long holdDuration = millis() - setupButtonPressTime;
+        uint64_t holdDuration = Timebase::nowMs() - setupButtonPressTime;
         if (holdDuration >= Config::Button::SETUP_HOLD_TIME_MS)
         {
-            Serial0.printf("%s Setup button held, enabling AP mode\n", Config::Debug::LOG_BTN);
-            wifi.enableSetupMode();
+            LOG_I(Button, "Setup button held, enabling AP mode");
+            state.setupModeRequested = true; // WiFiManager picks it up
             setupButtonWasPressed = false;
         }
     }
@@ -82,10 +92,10 @@ void Buttons::update(DeviceState &state, WiFiManager &wifi)
     {
         if (setupButtonWasPressed)
         {
-            unsigned long holdDuration = millis() - setupButtonPressTime;
+            uint64_t holdDuration = Timebase::nowMs() - setupButtonPressTime;
             if (holdDuration < Config::Button::SETUP_HOLD_TIME_MS)
             {
-                Serial0.printf("%s Setup button released after %lu ms (too short)\n", Config::Debug::LOG_BTN, holdDuration);
+                LOG_I(Button, "Setup button released after %llu ms (too short)", (unsigned long long)holdDuration);
             }
         }
         setupButtonWasPressed = false;
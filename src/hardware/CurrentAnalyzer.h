@@ -0,0 +1,261 @@
+#pragma once
+#include <esp_timer.h>
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/Axes.h"
+#include "../core/Dsp.h"
+
+// Samples every axis' current ADC at SAMPLE_RATE_HZ from a task on the app
+// core and runs RMS/peak/FFT over each full block. The loop only copies the
+// latest block features and turns them into stall/jam/vibration alarms.
+class CurrentAnalyzer
+{
+public:
+    void begin();
+    void update(DeviceState &state);
+
+private:
+    struct Features
+    {
+        Dsp::BlockStats stats;
+        Dsp::Spectrum spectrum;
+        uint32_t block = 0;
+    };
+
+    static constexpr size_t N = Config::Analysis::BLOCK_SIZE;
+    static_assert((N & (N - 1)) == 0, "Analysis block size must be a power of two");
+
+    static const uint8_t pins[Config::Axes::MAX_COUNT];
+
+    TaskHandle_t task = nullptr;
+    esp_timer_handle_t timer = nullptr;
+    bool sampling = false;
+    bool accelerated = false;
+
+    // Analysis task only
+    float samples[Config::Axes::COUNT][N];
+    size_t fill = 0;
+    float centered[N];
+    float work[2 * N];
+    float window[N];
+    float ones[N];
+
+    // Task -> loop handoff
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    Features latest[Config::Axes::COUNT];
+
+    // Loop only
+    uint32_t seenBlock[Config::Axes::COUNT] = {};
+    uint8_t stallBlocks[Config::Axes::COUNT] = {};
+
+    static void onSampleTimer(void *arg);
+    static void taskEntry(void *arg);
+    void run();
+    void analyze(uint8_t axis);
+    void benchmark();
+    CurrentAlarm classify(uint8_t axis, const AxisState &state, const Features &f);
+};
+
+const uint8_t CurrentAnalyzer::pins[Config::Axes::MAX_COUNT] = {
+    Axes::Axis0::CURRENT_ADC,
+    Axes::Axis1::CURRENT_ADC,
+    Axes::Axis2::CURRENT_ADC,
+    Axes::Axis3::CURRENT_ADC,
+};
+
+void CurrentAnalyzer::begin()
+{
+    if (!Config::Analysis::ENABLED)
+        return;
+
+    Dsp::hannWindow(window, N);
+    for (size_t i = 0; i < N; i++)
+        ones[i] = 1.0f;
+
+#if DSP_HAS_ESP_DSP
+    accelerated = Config::Analysis::USE_ESP_DSP && Dsp::initAccelerated(N);
+#endif
+
+    xTaskCreatePinnedToCore(taskEntry, "cur_analysis", Config::Analysis::TASK_STACK_SIZE, this,
+                            Config::Analysis::TASK_PRIORITY, &task, Config::Analysis::TASK_CORE);
+
+    esp_timer_create_args_t args = {};
+    args.callback = onSampleTimer;
+    args.arg = this;
+    args.name = "cur_sample";
+    esp_timer_create(&args, &timer);
+
+    LOG_I(Current, "Analysis: %lu Hz, block %u, %s kernels",
+          (unsigned long)Config::Analysis::SAMPLE_RATE_HZ, (unsigned)N, accelerated ? "esp-dsp" : "reference");
+}
+
+void CurrentAnalyzer::onSampleTimer(void *arg)
+{
+    CurrentAnalyzer *self = static_cast<CurrentAnalyzer *>(arg);
+    xTaskNotifyGive(self->task);
+}
+
+void CurrentAnalyzer::taskEntry(void *arg)
+{
+    static_cast<CurrentAnalyzer *>(arg)->run();
+}
+
+void CurrentAnalyzer::run()
+{
+    benchmark();
+
+    for (;;)
+    {
+        // Ticks missed during analysis are kept in the notification count and caught up
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+        for (uint8_t a = 0; a < Config::Axes::COUNT; a++)
+        {
+            samples[a][fill] = pins[a] != Config::Pins::NO_PIN ? (float)analogRead(pins[a]) : 0.0f;
+        }
+
+        if (++fill < N)
+            continue;
+
+        fill = 0;
+        for (uint8_t a = 0; a < Config::Axes::COUNT; a++)
+        {
+            if (pins[a] != Config::Pins::NO_PIN)
+                analyze(a);
+        }
+    }
+}
+
+void CurrentAnalyzer::analyze(uint8_t axis)
+{
+    Features f;
+
+#if DSP_HAS_ESP_DSP
+    if (accelerated)
+    {
+        f.stats = Dsp::statsAccelerated(samples[axis], centered, ones, N);
+        Dsp::loadWindowed(centered, window, work, N);
+        Dsp::fftAccelerated(work, N);
+    }
+    else
+#endif
+    {
+        f.stats = Dsp::statsReference(samples[axis], centered, N);
+        Dsp::loadWindowed(centered, window, work, N);
+        Dsp::fftReference(work, N);
+    }
+
+    f.spectrum = Dsp::summarize(work, N, Config::Analysis::SAMPLE_RATE_HZ,
+                                Config::Analysis::VIBRATION_BAND_LOW_HZ, Config::Analysis::VIBRATION_BAND_HIGH_HZ);
+
+    portENTER_CRITICAL(&mux);
+    f.block = latest[axis].block + 1;
+    latest[axis] = f;
+    portEXIT_CRITICAL(&mux);
+}
+
+void CurrentAnalyzer::benchmark()
+{
+    // Synthetic 50 Hz ripple on a DC level, timed for both kernel sets
+    for (size_t i = 0; i < N; i++)
+        samples[0][i] = 2000.0f + 300.0f * sinf(2.0f * (float)M_PI * 50.0f * i / Config::Analysis::SAMPLE_RATE_HZ);
+
+    constexpr int RUNS = 20;
+
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < RUNS; r++)
+    {
+        Dsp::statsReference(samples[0], centered, N);
+        Dsp::loadWindowed(centered, window, work, N);
+        Dsp::fftReference(work, N);
+    }
+    int64_t referenceUs = (esp_timer_get_time() - start) / RUNS;
+
+    int64_t acceleratedUs = -1;
+#if DSP_HAS_ESP_DSP
+    if (accelerated)
+    {
+        start = esp_timer_get_time();
+        for (int r = 0; r < RUNS; r++)
+        {
+            Dsp::statsAccelerated(samples[0], centered, ones, N);
+            Dsp::loadWindowed(centered, window, work, N);
+            Dsp::fftAccelerated(work, N);
+        }
+        acceleratedUs = (esp_timer_get_time() - start) / RUNS;
+    }
+#endif
+
+    LOG_I(Current, "Block benchmark (N=%u): reference %lld us, esp-dsp %lld us",
+          (unsigned)N, (long long)referenceUs, (long long)acceleratedUs);
+}
+
+void CurrentAnalyzer::update(DeviceState &state)
+{
+    if (!Config::Analysis::ENABLED)
+        return;
+
+    // Sampling would keep the chip out of light sleep; nothing to detect while idle anyway
+    if (state.powerIdle && sampling)
+    {
+        esp_timer_stop(timer);
+        sampling = false;
+    }
+    else if (!state.powerIdle && !sampling)
+    {
+        esp_timer_start_periodic(timer, 1000000UL / Config::Analysis::SAMPLE_RATE_HZ);
+        sampling = true;
+    }
+
+    for (uint8_t a = 0; a < Config::Axes::COUNT; a++)
+    {
+        portENTER_CRITICAL(&mux);
+        Features f = latest[a];
+        portEXIT_CRITICAL(&mux);
+
+        if (f.block == seenBlock[a])
+            continue;
+        seenBlock[a] = f.block;
+
+        AxisState &axis = state.axes[a];
+        axis.currentRms = f.stats.rms;
+        axis.currentPeak = f.stats.peak;
+        axis.vibrationHz = f.spectrum.dominantHz;
+        axis.currentAlarm = classify(a, axis, f);
+    }
+}
+
+CurrentAlarm CurrentAnalyzer::classify(uint8_t axis, const AxisState &state, const Features &f)
+{
+    if (state.motorSpeed == 0)
+    {
+        stallBlocks[axis] = 0;
+        return CurrentAlarm::None;
+    }
+
+    // Stall: sustained high load current
+    if (f.stats.mean > Config::Analysis::STALL_MEAN_ADC)
+    {
+        if (stallBlocks[axis] < Config::Analysis::STALL_BLOCKS)
+            stallBlocks[axis]++;
+        if (stallBlocks[axis] >= Config::Analysis::STALL_BLOCKS)
+            return CurrentAlarm::Stall;
+    }
+    else
+    {
+        stallBlocks[axis] = 0;
+    }
+
+    // Jam: short spikes far above the ripple level
+    if (f.stats.peak > Config::Analysis::JAM_PEAK_ADC && f.stats.rms > 0 &&
+        f.stats.peak / f.stats.rms > Config::Analysis::JAM_CREST_FACTOR)
+        return CurrentAlarm::Jam;
+
+    // Vibration: AC energy concentrated in the mechanical band
+    if (f.stats.rms > Config::Analysis::VIBRATION_MIN_RMS_ADC &&
+        f.spectrum.bandRatio > Config::Analysis::VIBRATION_BAND_RATIO)
+        return CurrentAlarm::Vibration;
+
+    return CurrentAlarm::None;
+}
@@ -1,29 +1,40 @@
 #pragma once
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Axes.h"
 
+template <typename Axis>
 class CurrentSensor
 {
 public:
     void begin();
-    void update(DeviceState &state);
-
-private:
-    int last = -999;
+    void sample(AxisInputs &in);
+    void update(AxisState &axis, const AxisInputs &in);
 };
 
-void CurrentSensor::begin()
+template <typename Axis>
+void CurrentSensor<Axis>::begin()
 {
+    if (!Axis::HAS_CURRENT)
+        return;
+
     analogReadResolution(Config::Current::ADC_RESOLUTION);
-    analogSetAttenuation(ADC_11db);
+    analogSetPinAttenuation(Axis::CURRENT_ADC, ADC_11db);
+}
+
+template <typename Axis>
+void CurrentSensor<Axis>::sample(AxisInputs &in)
+{
+    if (Axis::HAS_CURRENT)
+        in.currentAdc = analogRead(Axis::CURRENT_ADC);
 }
 
-void CurrentSensor::update(DeviceState &state)
+template <typename Axis>
+void CurrentSensor<Axis>::update(AxisState &axis, const AxisInputs &in)
 {
-    int val = analogRead(Config::Pins::CURRENT_ADC);
-    if (abs(val - last) > Config::Current::ADC_THRESHOLD)
-    {
-        state.currentAdc = val;
-        last = val;
-    }
+    if (!Axis::HAS_CURRENT)
+        return;
+
+    // Raw reading; consumers apply Config::Telemetry::CURRENT_ADC themselves
+    axis.currentAdc = in.currentAdc;
 }
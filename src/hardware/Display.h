@@ -4,6 +4,12 @@
 #include <TFT_eSPI.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/FixedString.h"
+#include "../core/ChangeTracker.h"
+#include "../core/Timebase.h"
+#include "../core/Replay.h"
+#include "TrendPlot.h"
 
 class Display
 {
@@ -14,16 +20,16 @@ public:
 private:
     TFT_eSPI tft;
     bool initialized = false;
-    unsigned long lastUpdate = 0;
+    uint64_t lastUpdate = 0;
 
-    // Предыдущие значения для отслеживания изменений
-    int32_t lastEncoderPos = 0;
-    int lastMotorSpeed = 0;
-    int16_t lastCurrentAdc = 0;
-    bool lastWifiConnected = false;
-    bool lastApActive = false;
-    bool lastMqttConnected = false;
-    String lastSsid = "";
+    // Отслеживание изменений (с зонами нечувствительности из Config::Telemetry)
+    TelemetryFrame frame;
+    ChangeTracker tracker;
+    uint64_t changed = 0;
+    FixedString<32> lastSsid;
+
+    // График скорости и тока оси 0 (своя частота кадров)
+    TrendPlot plot;
 
     // Флаги для полного обновления экрана
     bool fullRedraw = true;
@@ -44,29 +50,30 @@ private:
     void drawFooter(DeviceState &state);
     void drawStaticLayout();
     bool needsFullRedraw(DeviceState &state);
+    bool hasChanged(uint8_t field) const { return fullRedraw || (changed & ChangeTracker::bit(field)); }
 };
 
 void Display::begin()
 {
-    Serial0.println("[DISPLAY] Starting display init...");
+    LOG_D(Display, "Starting display init...");
 
     delay(500);
 
-    Serial0.println("[DISPLAY] Calling tft.init()...");
+    LOG_D(Display, "Calling tft.init()...");
 
     tft.init();
 
-    Serial0.println("[DISPLAY] tft.init() completed");
+    LOG_D(Display, "tft.init() completed");
 
     initialized = true;
 
-    Serial0.println("[DISPLAY] Setting rotation...");
+    LOG_D(Display, "Setting rotation...");
     tft.setRotation(0);
 
-    Serial0.println("[DISPLAY] Filling screen...");
+    LOG_D(Display, "Filling screen...");
     tft.fillScreen(TFT_BLACK);
 
-    Serial0.println("[DISPLAY] Display initialized successfully");
+    LOG_I(Display, "Display initialized successfully");
 }
 
 void Display::update(DeviceState &state)
@@ -74,11 +81,18 @@ void Display::update(DeviceState &state)
     if (!initialized)
         return;
 
-    unsigned long now = millis();
+    if constexpr (Config::Display::PLOT_ENABLED)
+        plot.update(tft, state.axes[0]);
+
+    uint64_t now = Timebase::nowMs();
     if (now - lastUpdate < Config::Display::UPDATE_INTERVAL_MS)
         return;
 
     lastUpdate = now;
+    uint32_t start = micros();
+
+    frame.capture(state);
+    changed = tracker.changes(frame);
 
     // Проверяем, нужно ли полное обновление
     if (needsFullRedraw(state))
@@ -86,6 +100,8 @@ void Display::update(DeviceState &state)
         fullRedraw = true;
         tft.fillScreen(COLOR_BG);
         drawStaticLayout();
+        if constexpr (Config::Display::PLOT_ENABLED)
+            plot.redraw(tft);
     }
 
     // Обновляем динамические данные
@@ -95,14 +111,12 @@ void Display::update(DeviceState &state)
     drawFooter(state);
 
     // Сохраняем текущие значения
-    lastEncoderPos = state.encoderPos;
-    lastMotorSpeed = state.motorSpeed;
-    lastCurrentAdc = state.currentAdc;
-    lastWifiConnected = state.wifiConnected;
-    lastApActive = state.apActive;
-    lastMqttConnected = state.mqttConnected;
+    uint64_t drawn = fullRedraw ? ChangeTracker::ALL : changed;
+    tracker.commit(frame, drawn);
     lastSsid = state.savedSsid;
     fullRedraw = false;
+
+    Replay::display(drawn, micros() - start);
 }
 
 void Display::drawStaticLayout()
@@ -124,10 +138,14 @@ void Display::drawStaticLayout()
     // Разделитель
     tft.drawLine(5, 85, Config::Display::WIDTH - 5, 85, COLOR_HEADER);
 
-    // Статические подписи для мотора
+    // Статические подписи для мотора (цвет линии на графике служит легендой)
+    tft.setTextColor(Config::Display::PLOT_ENABLED ? TrendPlot::COLOR_SPEED : COLOR_TEXT, COLOR_BG);
     tft.drawString("Motor Speed:", 10, 95, 2);
+    tft.setTextColor(COLOR_TEXT, COLOR_BG);
     tft.drawString("Encoder Pos:", 10, 115, 2);
+    tft.setTextColor(Config::Display::PLOT_ENABLED ? TrendPlot::COLOR_CURRENT : COLOR_TEXT, COLOR_BG);
     tft.drawString("Current:", 10, 135, 2);
+    tft.setTextColor(COLOR_TEXT, COLOR_BG);
 
     // Разделитель
     tft.drawLine(5, 160, Config::Display::WIDTH - 5, 160, COLOR_HEADER);
@@ -146,7 +164,7 @@ void Display::drawStatus(DeviceState &state)
     int x = 80;
 
     // WiFi статус
-    if (fullRedraw || lastWifiConnected != state.wifiConnected || lastApActive != state.apActive)
+    if (hasChanged(TelemetryFrame::field(TelemetryFrame::WifiConnected)) || hasChanged(TelemetryFrame::field(TelemetryFrame::ApActive)))
     {
         tft.setTextDatum(TL_DATUM);
         if (state.apActive)
@@ -167,7 +185,7 @@ void Display::drawStatus(DeviceState &state)
     }
 
     // MQTT статус
-    if (fullRedraw || lastMqttConnected != state.mqttConnected)
+    if (hasChanged(TelemetryFrame::field(TelemetryFrame::MqttConnected)))
     {
         tft.setTextDatum(TL_DATUM);
         if (state.mqttConnected)
@@ -189,16 +207,16 @@ void Display::drawMotorInfo(DeviceState &state)
     int x = 120;
 
     // Скорость мотора
-    if (fullRedraw || lastMotorSpeed != state.motorSpeed)
+    if (hasChanged(TelemetryFrame::field(0, TelemetryFrame::MotorSpeed)))
     {
         tft.setTextColor(COLOR_VALUE, COLOR_BG);
         tft.setTextDatum(TL_DATUM);
-        sprintf(buffer, "%4d/255   ", state.motorSpeed);
+        sprintf(buffer, "%6.1f%%   ", state.axes[0].motorSpeed / 10.0f);
         tft.drawString(buffer, x, 95, 2);
 
         // Визуальный индикатор скорости
-        int barWidth = map(abs(state.motorSpeed), 0, 255, 0, 80);
-        uint16_t barColor = (state.motorSpeed > 0) ? COLOR_OK : (state.motorSpeed < 0) ? COLOR_ALERT
+        int barWidth = map(abs(state.axes[0].motorSpeed), 0, Config::Motor::SPEED_SCALE, 0, 80);
+        uint16_t barColor = (state.axes[0].motorSpeed > 0) ? COLOR_OK : (state.axes[0].motorSpeed < 0) ? COLOR_ALERT
                                                                                        : COLOR_TEXT;
 
         // Фон индикатора
@@ -212,18 +230,18 @@ void Display::drawMotorInfo(DeviceState &state)
     }
 
     // Позиция энкодера
-    if (fullRedraw || lastEncoderPos != state.encoderPos)
+    if (hasChanged(TelemetryFrame::field(0, TelemetryFrame::Encoder)))
     {
         tft.setTextColor(COLOR_VALUE, COLOR_BG);
-        sprintf(buffer, "%8ld    ", state.encoderPos);
+        sprintf(buffer, "%8lld    ", (long long)state.axes[0].encoderPos);
         tft.drawString(buffer, x, 115, 2);
     }
 
     // Ток (ADC)
-    if (fullRedraw || lastCurrentAdc != state.currentAdc)
+    if (hasChanged(TelemetryFrame::field(0, TelemetryFrame::Current)))
     {
         tft.setTextColor(COLOR_VALUE, COLOR_BG);
-        sprintf(buffer, "%4d      ", state.currentAdc);
+        sprintf(buffer, "%4d      ", state.axes[0].currentAdc);
         tft.drawString(buffer, x, 135, 2);
     }
 }
@@ -233,13 +251,13 @@ void Display::drawNetworkInfo(DeviceState &state)
     char buffer[32];
 
     // IP адрес
-    if (fullRedraw || lastWifiConnected != state.wifiConnected)
+    if (hasChanged(TelemetryFrame::field(TelemetryFrame::WifiConnected)))
     {
         tft.setTextColor(COLOR_VALUE, COLOR_BG);
         tft.setTextDatum(TL_DATUM);
         if (state.wifiConnected || state.apActive)
         {
-            sprintf(buffer, "%-15s", state.localIP.toString().c_str());
+            sprintf(buffer, "%-15s", Fmt::ip(state.localIP).c_str());
         }
         else
         {
@@ -252,12 +270,9 @@ void Display::drawNetworkInfo(DeviceState &state)
     if (fullRedraw || lastSsid != state.savedSsid)
     {
         tft.setTextColor(COLOR_VALUE, COLOR_BG);
-        if (state.savedSsid.length() > 0)
+        if (!state.savedSsid.isEmpty())
         {
-            String ssid = state.savedSsid;
-            if (ssid.length() > 16)
-                ssid = ssid.substring(0, 13) + "...";
-            sprintf(buffer, "%-16s", ssid.c_str());
+            sprintf(buffer, "%-16s", Fmt::ellipsize<16>(state.savedSsid.c_str(), 16).c_str());
         }
         else
         {
@@ -267,7 +282,7 @@ void Display::drawNetworkInfo(DeviceState &state)
     }
 
     // Режим работы
-    if (fullRedraw || lastApActive != state.apActive)
+    if (hasChanged(TelemetryFrame::field(TelemetryFrame::ApActive)))
     {
         tft.setTextColor(COLOR_VALUE, COLOR_BG);
         if (state.apActive)
@@ -288,23 +303,35 @@ void Display::drawNetworkInfo(DeviceState &state)
 
 void Display::drawFooter(DeviceState &state)
 {
+    char buffer[32];
+
+    if constexpr (Config::Display::PLOT_ENABLED)
+    {
+        // Под графиком одна строка: время работы и шкала тока
+        snprintf(buffer, sizeof(buffer), "Up %s", Fmt::duration(Timebase::nowMs() / 1000).c_str());
+        tft.setTextColor(COLOR_TEXT, COLOR_BG);
+        tft.setTextDatum(TL_DATUM);
+        tft.drawString(buffer, 10, 302, 2);
+
+        snprintf(buffer, sizeof(buffer), "   I 0-%d", plot.currentScale());
+        tft.setTextColor(TrendPlot::COLOR_CURRENT, COLOR_BG);
+        tft.setTextDatum(TR_DATUM);
+        tft.drawString(buffer, Config::Display::WIDTH - 10, 302, 2);
+        return;
+    }
+
     // Версия прошивки
     tft.setTextColor(COLOR_TEXT, COLOR_BG);
     tft.setTextDatum(TC_DATUM);
-    tft.drawString("FW: " + String(Config::FIRMWARE_VERSION), Config::Display::WIDTH / 2, 250, 2);
+    snprintf(buffer, sizeof(buffer), "FW: %s", Config::FIRMWARE_VERSION);
+    tft.drawString(buffer, Config::Display::WIDTH / 2, 250, 2);
 
     // Подсказки по кнопкам
     tft.setTextColor(COLOR_HEADER, COLOR_BG);
     tft.drawString("UP: Start  DOWN: Stop  SETUP: 5s AP", Config::Display::WIDTH / 2, 275, 2);
 
     // Время работы (uptime)
-    unsigned long uptime = millis() / 1000;
-    int hours = uptime / 3600;
-    int minutes = (uptime % 3600) / 60;
-    int seconds = uptime % 60;
-
-    char buffer[32];
-    sprintf(buffer, "Uptime: %02d:%02d:%02d", hours, minutes, seconds);
+    snprintf(buffer, sizeof(buffer), "Uptime: %s", Fmt::duration(Timebase::nowMs() / 1000).c_str());
     tft.setTextColor(COLOR_TEXT, COLOR_BG);
     tft.drawString(buffer, Config::Display::WIDTH / 2, 300, 2);
 }
@@ -313,6 +340,6 @@ bool Display::needsFullRedraw(DeviceState &state)
 {
     // Полное обновление при первом запуске или при смене режима WiFi
     return fullRedraw ||
-           lastApActive != state.apActive ||
-           (lastWifiConnected != state.wifiConnected && !state.wifiConnected);
+           (changed & ChangeTracker::bit(TelemetryFrame::field(TelemetryFrame::ApActive))) ||
+           ((changed & ChangeTracker::bit(TelemetryFrame::field(TelemetryFrame::WifiConnected))) && !state.wifiConnected);
 }
\ No newline at end of file
@@ -2,34 +2,187 @@
 #include <ESP32Encoder.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/Trace.h"
+#include "../core/Axes.h"
+#include "../core/PowerManager.h"
+#include "../core/Replay.h"
+#include "../core/Timebase.h"
 
+template <typename Axis>
 class EncoderReader
 {
 public:
     void begin();
-    void update(DeviceState &state);
+    // Raw count and index latch, as the control pass sees them
+    void sample(AxisInputs &in);
+    void update(AxisState &axis, const AxisInputs &in);
 
 private:
+    // ESP32Encoder accumulates PCNT overflows into a 64-bit count in its ISR
     ESP32Encoder encoder;
-    int32_t lastPos = 0;
-};
+    int64_t lastPos = 0;
+    int64_t homeOffset = 0;
+
+    // Index (Z) pulse, flagged by the ISR. The count is taken by the next
+    // sample(): the encoder library and PCNT driver are not IRAM-safe, so
+    // the latch is resolved to one control pass.
+    volatile bool indexPulse = false;
+    bool indexLatched = false;
+    int64_t indexCount = 0;
+
+    uint64_t homingStartTime = 0;
 
+    // Live home, set aside while a replay homes on recorded counts
+    bool replayed = false;
+    int64_t liveHomeOffset = 0;
+    bool liveHomed = false;
+
+    static void IRAM_ATTR onIndex(void *arg);
+
+    void updateHoming(AxisState &axis, const AxisInputs &in);
+    void finishHoming(AxisState &axis, int64_t zero);
+    void switchSource(AxisState &axis, const AxisInputs &in, bool replay);
+};
 
-void EncoderReader::begin()
+template <typename Axis>
+void EncoderReader<Axis>::begin()
 {
-    pinMode(Config::Pins::ENCODER_A, INPUT_PULLUP);
-    pinMode(Config::Pins::ENCODER_B, INPUT_PULLUP);
+    pinMode(Axis::ENCODER_A, INPUT_PULLUP);
+    pinMode(Axis::ENCODER_B, INPUT_PULLUP);
 
-    encoder.attachHalfQuad(Config::Pins::ENCODER_A, Config::Pins::ENCODER_B);
+    switch (Config::Encoder::COUNT_MODE)
+    {
+    case Config::Encoder::CountMode::Single:
+        encoder.attachSingleEdge(Axis::ENCODER_A, Axis::ENCODER_B);
+        break;
+    case Config::Encoder::CountMode::Half:
+        encoder.attachHalfQuad(Axis::ENCODER_A, Axis::ENCODER_B);
+        break;
+    case Config::Encoder::CountMode::Full:
+        encoder.attachFullQuad(Axis::ENCODER_A, Axis::ENCODER_B);
+        break;
+    }
     encoder.setFilter(Config::Encoder::FILTER_VALUE);
+
+    if (Axis::HAS_INDEX)
+    {
+        pinMode(Axis::ENCODER_Z, INPUT_PULLUP);
+        attachInterruptArg(Axis::ENCODER_Z, onIndex, this, RISING);
+    }
 }
 
-void EncoderReader::update(DeviceState &state)
+template <typename Axis>
+void IRAM_ATTR EncoderReader<Axis>::onIndex(void *arg)
 {
-    int32_t pos = encoder.getCount();
+    EncoderReader *self = static_cast<EncoderReader *>(arg);
+    TRACE_INSTANT("enc_index", Axis::ENCODER_Z);
+    self->indexPulse = true;
+}
+
+template <typename Axis>
+void EncoderReader<Axis>::sample(AxisInputs &in)
+{
+    in.encoderCount = encoder.getCount();
+    if (indexPulse && !indexLatched)
+    {
+        indexCount = in.encoderCount;
+        indexLatched = true;
+    }
+    in.indexLatched = indexLatched;
+    in.indexCount = indexCount;
+}
+
+template <typename Axis>
+void EncoderReader<Axis>::update(AxisState &axis, const AxisInputs &in)
+{
+    bool replay = Replay::replaying();
+    if (replay != replayed)
+        switchSource(axis, in, replay);
+
+    if (axis.homingRequested || axis.homingActive)
+    {
+        updateHoming(axis, in);
+    }
+
+    int64_t pos = in.encoderCount - homeOffset;
     if (pos != lastPos)
     {
-        state.encoderPos = pos;
+        axis.encoderPos = pos;
         lastPos = pos;
+        PowerManager::notifyActivity();
     }
 }
+
+template <typename Axis>
+void EncoderReader<Axis>::updateHoming(AxisState &axis, const AxisInputs &in)
+{
+    if (axis.homingRequested)
+    {
+        axis.homingRequested = false;
+
+        // Without an index channel the current position becomes home
+        if (!Axis::HAS_INDEX)
+        {
+            finishHoming(axis, in.encoderCount);
+            return;
+        }
+
+        indexPulse = false;
+        indexLatched = false;
+        homingStartTime = Timebase::nowMs();
+        axis.homingActive = true;
+        axis.homed = false;
+        axis.motorSpeed = axis.homingSpeed;
+        LOG_I(Encoder, "Homing started, speed=%d", axis.homingSpeed);
+        return;
+    }
+
+    if (in.indexLatched)
+    {
+        axis.motorSpeed = 0;
+        finishHoming(axis, in.indexCount);
+    }
+    else if (axis.motorSpeed != axis.homingSpeed)
+    {
+        // Someone else commanded the motor - give up
+        axis.homingActive = false;
+        LOG_I(Encoder, "Homing aborted by motor command");
+    }
+    else if (Timebase::elapsed(homingStartTime, Config::Encoder::HOMING_TIMEOUT_MS))
+    {
+        axis.motorSpeed = 0;
+        axis.homingActive = false;
+        LOG_W(Encoder, "Homing timeout, index not found");
+    }
+}
+
+template <typename Axis>
+void EncoderReader<Axis>::finishHoming(AxisState &axis, int64_t zero)
+{
+    homeOffset = zero;
+    axis.homingActive = false;
+    axis.homed = true;
+    LOG_I(Encoder, "Homed at raw count %lld", (long long)zero);
+}
+
+// A replay starts from the live home and may home again on the recorded
+// counts; the live home comes back when it ends, and the position is taken
+// from the live count on that same pass
+template <typename Axis>
+void EncoderReader<Axis>::switchSource(AxisState &axis, const AxisInputs &in, bool replay)
+{
+    replayed = replay;
+    if (replay)
+    {
+        liveHomeOffset = homeOffset;
+        liveHomed = axis.homed;
+        return;
+    }
+
+    homeOffset = liveHomeOffset;
+    axis.homed = liveHomed;
+    axis.homingActive = false;
+    lastPos = in.encoderCount - homeOffset;
+    axis.encoderPos = lastPos;
+}
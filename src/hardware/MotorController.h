@@ -1,24 +1,138 @@
 #pragma once
-#include <GyverMotor2.h>
+#include <driver/ledc.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Axes.h"
+#include "../core/Log.h"
+#include "../core/LatencyTracker.h"
 
+// LEDC channels are handed out in begin() order, across all axes
+namespace MotorChannels
+{
+    inline uint8_t next = Config::Motor::LEDC_FIRST_CHANNEL;
+}
+
+// PWM/DIR/EN output on an LEDC channel. All axes share one LEDC timer, so
+// their periods are aligned. A control pass first stages every axis' duty
+// with update() and then latches them back to back with apply(); the new
+// duties start together on the next PWM period.
+//
+// Speed is per-mille of full scale. Non-zero speeds are mapped onto
+// [DEADBAND, SPEED_SCALE] so the first step above zero already turns the
+// motor; zero brakes or coasts according to the axis' stop mode.
+//
+// DIR never flips under a running duty: a reversal first drives one pass at
+// zero duty and changes direction on the next, by which time the zero has
+// been latched at a PWM period boundary. Its command closes on that pass.
+template <typename Axis>
 class MotorController
 {
+    static_assert(Axis::MOTOR_PWM != Config::Pins::NO_PIN, "Motor axis has no pins assigned");
+    static_assert((Config::Motor::PWM_FREQUENCY_HZ << Config::Motor::PWM_RESOLUTION_BITS) <= 80000000,
+                  "LEDC: frequency x 2^resolution must not exceed the 80 MHz APB clock");
+
 public:
     void begin();
-    void update(DeviceState &state);
+
+    // Stages the axis' duty and direction
+    void update(AxisState &axis);
+    // Latches what update() staged; closes the axis' pending command
+    void apply(AxisState &axis);
+
+    // LEDC duty for a speed, dead-band compensated
+    static uint32_t dutyFor(int speed);
 
 private:
-    GMotor2<DRIVER3WIRE> motor{Config::Pins::MOTOR_PWM, Config::Pins::MOTOR_EN, Config::Pins::MOTOR_DIR};
+    static constexpr uint32_t FULL_DUTY = 1u << Config::Motor::PWM_RESOLUTION_BITS;
+
+    ledc_channel_t channel = LEDC_CHANNEL_0;
+    uint32_t duty = 0;
+    bool forward = true;
+    bool enabled = false;
+    bool staged = false;
+    bool reversing = false; // Zero duty staged ahead of a direction change
 };
 
-void MotorController::begin()
+template <typename Axis>
+void MotorController<Axis>::begin()
+{
+    // Axes share the timer; configuring it again with equal settings is harmless
+    ledc_timer_config_t timer = {};
+    timer.speed_mode = LEDC_LOW_SPEED_MODE;
+    timer.duty_resolution = (ledc_timer_bit_t)Config::Motor::PWM_RESOLUTION_BITS;
+    timer.timer_num = (ledc_timer_t)Config::Motor::LEDC_TIMER;
+    timer.freq_hz = Config::Motor::PWM_FREQUENCY_HZ;
+    timer.clk_cfg = LEDC_USE_APB_CLK;
+    if (ledc_timer_config(&timer) != ESP_OK)
+        LOG_E(Motor, "LEDC timer rejected %lu Hz at %u bits", (unsigned long)Config::Motor::PWM_FREQUENCY_HZ, Config::Motor::PWM_RESOLUTION_BITS);
+
+    channel = (ledc_channel_t)MotorChannels::next++;
+    ledc_channel_config_t out = {};
+    out.gpio_num = Axis::MOTOR_PWM;
+    out.speed_mode = LEDC_LOW_SPEED_MODE;
+    out.channel = channel;
+    out.timer_sel = (ledc_timer_t)Config::Motor::LEDC_TIMER;
+    out.duty = 0;
+    out.hpoint = 0;
+    ledc_channel_config(&out);
+
+    pinMode(Axis::MOTOR_DIR, OUTPUT);
+    digitalWrite(Axis::MOTOR_DIR, HIGH);
+    if constexpr (Axis::MOTOR_EN != Config::Pins::NO_PIN)
+    {
+        pinMode(Axis::MOTOR_EN, OUTPUT);
+        digitalWrite(Axis::MOTOR_EN, LOW); // Coast until the first pass applies the stop mode
+    }
+}
+
+template <typename Axis>
+uint32_t MotorController<Axis>::dutyFor(int speed)
+{
+    uint32_t magnitude = min((uint32_t)abs(speed), (uint32_t)Config::Motor::SPEED_SCALE);
+    if (magnitude == 0)
+        return 0;
+
+    uint32_t scaled = Config::Motor::DEADBAND + (Config::Motor::SPEED_SCALE - Config::Motor::DEADBAND) * magnitude / Config::Motor::SPEED_SCALE;
+    return (uint64_t)scaled * FULL_DUTY / Config::Motor::SPEED_SCALE;
+}
+
+template <typename Axis>
+void MotorController<Axis>::update(AxisState &axis)
 {
-    motor.setMinDuty(Config::Motor::MIN_DUTY);
+    uint32_t nextDuty = dutyFor(axis.motorSpeed);
+    bool nextForward = axis.motorSpeed != 0 ? axis.motorSpeed > 0 : forward;
+    bool nextEnabled = axis.motorSpeed != 0 || axis.stopMode == Config::Motor::StopMode::Brake;
+
+    // Still driving the old way: stop first, reverse on the next pass
+    reversing = nextForward != forward && duty != 0;
+    if (reversing)
+    {
+        nextDuty = 0;
+        nextForward = forward;
+    }
+
+    staged = nextDuty != duty || nextForward != forward || nextEnabled != enabled;
+    if (!staged)
+        return;
+
+    duty = nextDuty;
+    forward = nextForward;
+    enabled = nextEnabled;
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, channel, duty);
 }
 
-void MotorController::update(DeviceState &state)
+template <typename Axis>
+void MotorController<Axis>::apply(AxisState &axis)
 {
-    motor.setSpeed(state.motorSpeed);
+    if (staged)
+    {
+        digitalWrite(Axis::MOTOR_DIR, forward ? HIGH : LOW);
+        if constexpr (Axis::MOTOR_EN != Config::Pins::NO_PIN)
+            digitalWrite(Axis::MOTOR_EN, enabled ? HIGH : LOW);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, channel);
+        staged = false;
+    }
+
+    if (axis.commandPending && !reversing)
+        LatencyTracker::close(axis, micros());
 }
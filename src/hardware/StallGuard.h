@@ -0,0 +1,123 @@
+#pragma once
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/LoadEstimator.h"
+#include "../core/Timebase.h"
+
+// Per-axis supervisor: runs the load estimator between the sensor reads and
+// the motor output of a control pass and applies the configured stall reaction.
+class StallGuard
+{
+public:
+    void update(AxisState &axis, Config::Stall::Reaction reaction);
+
+private:
+    enum class Phase : uint8_t
+    {
+        Running,
+        Reversing,
+        Stopped
+    };
+
+    LoadEstimator estimator;
+    Phase phase = Phase::Running;
+    int resumeSpeed = 0;
+    int reverseSpeed = 0;
+    uint8_t retries = 0;
+    bool stallLatched = false; // Reacted to; cleared once the estimator recovers
+    uint64_t phaseStart = 0;
+    uint64_t lastStall = 0;
+
+    void onStall(AxisState &axis, Config::Stall::Reaction reaction);
+};
+
+void StallGuard::update(AxisState &axis, Config::Stall::Reaction reaction)
+{
+    uint64_t now = Timebase::nowMs();
+    estimator.update(axis.motorSpeed, axis.encoderPos, axis.currentAdc, micros());
+
+    axis.velocity = estimator.velocity();
+    axis.loadEstimate = estimator.load();
+
+    switch (phase)
+    {
+    case Phase::Running:
+        if (estimator.stalled())
+        {
+            // Act on the rising edge only; with AlarmOnly the stall persists
+            if (!stallLatched)
+            {
+                stallLatched = true;
+                onStall(axis, reaction);
+            }
+        }
+        else
+        {
+            stallLatched = false;
+            axis.loadStall = false;
+            if (retries > 0 && now - lastStall > Config::Stall::RETRY_RESET_MS)
+                retries = 0;
+        }
+        break;
+
+    case Phase::Reversing:
+        if (axis.motorSpeed != reverseSpeed)
+        {
+            // New command arrived while backing off - it wins
+            phase = Phase::Running;
+        }
+        else if (now - phaseStart >= Config::Stall::REVERSE_MS)
+        {
+            axis.motorSpeed = resumeSpeed;
+            phase = Phase::Running;
+            LOG_D(Motor, "Stall retry %d, resuming speed=%d", retries, resumeSpeed);
+        }
+        break;
+
+    case Phase::Stopped:
+        // Latched until the next non-zero command
+        if (axis.motorSpeed != 0)
+        {
+            phase = Phase::Running;
+            retries = 0;
+            axis.loadStall = false;
+        }
+        break;
+    }
+}
+
+void StallGuard::onStall(AxisState &axis, Config::Stall::Reaction reaction)
+{
+    uint64_t now = Timebase::nowMs();
+    lastStall = now;
+    axis.loadStall = true;
+
+    LOG_W(Motor, "Stall: speed=%d velocity=%.0f/%.0f load=%.0f",
+          axis.motorSpeed, estimator.velocity(), estimator.expectedVelocity(), estimator.load());
+
+    switch (reaction)
+    {
+    case Config::Stall::Reaction::AlarmOnly:
+        break;
+
+    case Config::Stall::Reaction::ReverseRetry:
+        if (retries < Config::Stall::MAX_RETRIES)
+        {
+            retries++;
+            resumeSpeed = axis.motorSpeed;
+            reverseSpeed = axis.motorSpeed > 0 ? -Config::Stall::REVERSE_SPEED : Config::Stall::REVERSE_SPEED;
+            axis.motorSpeed = reverseSpeed;
+            phase = Phase::Reversing;
+            phaseStart = now;
+            break;
+        }
+        // Out of retries - fall through to stop
+        [[fallthrough]];
+
+    case Config::Stall::Reaction::Stop:
+        axis.motorSpeed = 0;
+        phase = Phase::Stopped;
+        break;
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <TFT_eSPI.h>
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/Timebase.h"
+
+// Strip chart of one axis' speed and current over the last
+// COLUMNS * PLOT_INTERVAL_MS. Samples live in a ring buffer with one entry
+// per screen column. Each frame renders only the column at the write cursor
+// plus a blank gap column after it, into a line buffer pushed as one
+// 1-pixel-wide window, so a frame costs O(PLOT_HEIGHT) pixels regardless of
+// the chart width. The trace sweeps left to right and overwrites the oldest
+// column, like a patient monitor.
+//
+// Speed uses a fixed ±SPEED_SCALE axis around the centre line. Current is
+// auto-scaled to a 1-2-5 step above the largest sample in the buffer; a new
+// scale applies to columns as the sweep reaches them, so rescaling never
+// repaints the chart. Loop task only.
+class TrendPlot
+{
+public:
+    static constexpr uint16_t COLUMNS = Config::Display::PLOT_WIDTH - 2; // Inside the border
+    static constexpr uint16_t ROWS = Config::Display::PLOT_HEIGHT - 2;
+
+    static constexpr uint16_t COLOR_SPEED = TFT_GREEN;
+    static constexpr uint16_t COLOR_CURRENT = TFT_YELLOW;
+
+    // Border and every column from the buffer; after the screen was cleared
+    void redraw(TFT_eSPI &tft);
+
+    // Samples `axis` and draws one column once PLOT_INTERVAL_MS has passed
+    void update(TFT_eSPI &tft, const AxisState &axis);
+
+    // Full-scale current (ADC counts) of the newest column
+    int16_t currentScale() const { return scale; }
+
+private:
+    static constexpr uint16_t COLOR_BG = TFT_BLACK;
+    static constexpr uint16_t COLOR_GRID = TFT_DARKGREY;
+
+    struct Sample
+    {
+        int16_t speed;
+        int16_t current;
+    };
+
+    Sample samples[COLUMNS] = {};
+    uint16_t cursor = 0; // Next column to write
+    uint16_t filled = 0;
+    int16_t scale = Config::Display::PLOT_MIN_CURRENT_ADC;
+    uint64_t lastColumnMs = 0;
+    uint16_t line[ROWS];
+
+    void render(uint16_t column, bool gap);
+    void push(TFT_eSPI &tft, uint16_t column);
+    void rescale();
+
+    static uint16_t speedRow(int speed);
+    uint16_t currentRow(int current) const;
+    void segment(uint16_t from, uint16_t to, uint16_t color);
+};
+
+void TrendPlot::redraw(TFT_eSPI &tft)
+{
+    tft.drawRect(Config::Display::PLOT_X, Config::Display::PLOT_Y,
+                 Config::Display::PLOT_WIDTH, Config::Display::PLOT_HEIGHT, COLOR_GRID);
+
+    // Rare (screen mode changes), so a full pass is fine here
+    tft.startWrite();
+    for (uint16_t column = 0; column < COLUMNS; column++)
+    {
+        render(column, column == cursor && filled == COLUMNS);
+        push(tft, column);
+    }
+    tft.endWrite();
+}
+
+void TrendPlot::update(TFT_eSPI &tft, const AxisState &axis)
+{
+    uint64_t now = Timebase::nowMs();
+    if (now - lastColumnMs < Config::Display::PLOT_INTERVAL_MS)
+        return;
+    lastColumnMs = now;
+
+    samples[cursor] = {(int16_t)axis.motorSpeed, axis.currentAdc};
+    if (filled < COLUMNS)
+        filled++;
+    rescale();
+
+    uint16_t gap = (cursor + 1) % COLUMNS;
+    tft.startWrite();
+    render(cursor, false);
+    push(tft, cursor);
+    render(gap, true);
+    push(tft, gap);
+    tft.endWrite();
+
+    cursor = gap;
+}
+
+void TrendPlot::rescale()
+{
+    int16_t peak = 0;
+    for (uint16_t i = 0; i < filled; i++)
+        peak = max(peak, samples[i].current);
+
+    // Smallest 1-2-5 step at or above the peak
+    int32_t step = 1;
+    while (step * 10 <= peak)
+        step *= 10;
+    int32_t nice = step;
+    for (int32_t m : {1, 2, 5, 10})
+    {
+        nice = step * m;
+        if (nice >= peak)
+            break;
+    }
+    scale = (int16_t)constrain(nice, (int32_t)Config::Display::PLOT_MIN_CURRENT_ADC, (int32_t)INT16_MAX);
+}
+
+void TrendPlot::render(uint16_t column, bool gap)
+{
+    for (uint16_t row = 0; row < ROWS; row++)
+        line[row] = COLOR_BG;
+
+    // Zero-speed centre line, dotted quarter lines
+    line[speedRow(0)] = COLOR_GRID;
+    if (column % 4 == 0)
+    {
+        line[ROWS / 4] = COLOR_GRID;
+        line[ROWS * 3 / 4] = COLOR_GRID;
+    }
+
+    // Columns not written yet stay blank, as does the gap at the sweep head
+    bool written = filled == COLUMNS || column < filled;
+    if (gap || !written)
+        return;
+
+    // Connect to the previous column so steep edges stay continuous
+    const Sample &now = samples[column];
+    uint16_t previous = (column + COLUMNS - 1) % COLUMNS;
+    bool connected = column != 0 || filled == COLUMNS;
+    const Sample &before = connected ? samples[previous] : now;
+
+    segment(currentRow(before.current), currentRow(now.current), COLOR_CURRENT);
+    segment(speedRow(before.speed), speedRow(now.speed), COLOR_SPEED);
+}
+
+void TrendPlot::push(TFT_eSPI &tft, uint16_t column)
+{
+    tft.setAddrWindow(Config::Display::PLOT_X + 1 + column, Config::Display::PLOT_Y + 1, 1, ROWS);
+    tft.pushColors(line, ROWS, true);
+}
+
+uint16_t TrendPlot::speedRow(int speed)
+{
+    constexpr int half = (ROWS - 1) / 2;
+    int clamped = constrain(speed, -Config::Motor::SPEED_SCALE, Config::Motor::SPEED_SCALE);
+    return half - clamped * half / Config::Motor::SPEED_SCALE;
+}
+
+uint16_t TrendPlot::currentRow(int current) const
+{
+    int clamped = constrain(current, 0, (int)scale);
+    return (ROWS - 1) - clamped * (ROWS - 1) / scale;
+}
+
+void TrendPlot::segment(uint16_t from, uint16_t to, uint16_t color)
+{
+    uint16_t top = min(from, to);
+    uint16_t bottom = max(from, to);
+    for (uint16_t row = top; row <= bottom; row++)
+        line[row] = color;
+}
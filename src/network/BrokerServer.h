@@ -0,0 +1,193 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PicoMQTT.h>
+#include <esp_heap_caps.h>
+#include "../core/AllocCounter.h"
+#include "../core/Config.h"
+#include "../core/Log.h"
+
+// PicoMQTT server with capacity limits. CONNECTs beyond MAX_CLIENTS are
+// refused, and a subscriber whose socket stays full for SOCKET_TIMEOUT_MS is
+// dropped by PicoMQTT's write timeout instead of stalling the loop for the
+// library default of 5 s. In capacity mode the blocks PicoMQTT allocates
+// during a pass (client objects and their outbound buffers) come from PSRAM
+// when they reach PSRAM_ALLOC_THRESHOLD, so internal heap stays with
+// WiFi/LWIP. Only the loop task's own allocations are redirected, through
+// AllocCounter::preferPsram().
+//
+// Memory per client is the drop in free heap since the broker last had no
+// clients, divided by the client count; /api/broker reports it with the
+// connection counters. Loop task only, apart from report().
+class BrokerServer : public PicoMQTT::Server
+{
+public:
+    BrokerServer() : PicoMQTT::Server(Config::Mqtt::PORT, Config::Broker::KEEP_ALIVE_TOLERANCE_MS, Config::Broker::SOCKET_TIMEOUT_MS) {}
+
+    // Replaces loop(): accept, read, fan out, then sample
+    void update();
+
+    static void report(JsonObject out);
+
+protected:
+    PicoMQTT::ConnectReturnCode auth(const char *clientId, const char *username, const char *password) override;
+    void on_connected(const char *clientId) override;
+    void on_disconnected(const char *clientId) override;
+    void on_subscribe(const char *clientId, const char *topic) override;
+    void on_unsubscribe(const char *clientId, const char *topic) override;
+
+private:
+    struct Stats
+    {
+        uint8_t clients = 0;
+        uint8_t peakClients = 0;
+        uint32_t connects = 0;
+        uint32_t rejected = 0;       // Refused at MAX_CLIENTS
+        uint32_t disconnects = 0;
+        uint32_t slowDisconnects = 0; // Dropped during a pass that hit the write timeout
+        uint32_t subscriptions = 0;
+        uint32_t lastPassUs = 0;
+        uint32_t longestPassUs = 0;
+        int32_t internalPerClient = 0;
+        int32_t psramPerClient = 0;
+    };
+
+    static portMUX_TYPE mux;
+    static Stats stats;
+
+    // Free heap while no client was connected
+    size_t idleInternal = 0;
+    size_t idlePsram = 0;
+    uint32_t disconnectsThisPass = 0;
+
+    void sampleMemory();
+};
+
+portMUX_TYPE BrokerServer::mux = portMUX_INITIALIZER_UNLOCKED;
+BrokerServer::Stats BrokerServer::stats;
+
+void BrokerServer::update()
+{
+    disconnectsThisPass = 0;
+    uint32_t start = micros();
+
+    // PicoMQTT allocates with plain new, so its blocks are steered by the
+    // malloc wrap; WiFi, async_tcp and the other tasks keep their placement
+    if constexpr (Config::Broker::CAPACITY_MODE)
+        AllocCounter::preferPsram(Config::Broker::PSRAM_ALLOC_THRESHOLD);
+
+    loop();
+
+    if constexpr (Config::Broker::CAPACITY_MODE)
+        AllocCounter::preferPsram(0);
+
+    uint32_t elapsed = micros() - start;
+    bool timedOut = elapsed >= Config::Broker::SOCKET_TIMEOUT_MS * 1000;
+
+    portENTER_CRITICAL(&mux);
+    stats.lastPassUs = elapsed;
+    if (elapsed > stats.longestPassUs)
+        stats.longestPassUs = elapsed;
+    if (timedOut)
+        stats.slowDisconnects += disconnectsThisPass;
+    portEXIT_CRITICAL(&mux);
+
+    if (timedOut && disconnectsThisPass)
+        LOG_W(Mqtt, "Dropped %lu slow subscriber(s), pass took %lu us", (unsigned long)disconnectsThisPass, (unsigned long)elapsed);
+
+    sampleMemory();
+}
+
+void BrokerServer::sampleMemory()
+{
+    size_t internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    portENTER_CRITICAL(&mux);
+    uint8_t clients = stats.clients;
+    if (clients == 0)
+    {
+        idleInternal = internal;
+        idlePsram = psram;
+        stats.internalPerClient = stats.psramPerClient = 0;
+    }
+    else if (idleInternal)
+    {
+        stats.internalPerClient = ((int32_t)idleInternal - (int32_t)internal) / clients;
+        stats.psramPerClient = ((int32_t)idlePsram - (int32_t)psram) / clients;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+PicoMQTT::ConnectReturnCode BrokerServer::auth(const char *clientId, const char *username, const char *password)
+{
+    if (stats.clients < Config::Broker::MAX_CLIENTS)
+        return PicoMQTT::CRC_ACCEPTED;
+
+    portENTER_CRITICAL(&mux);
+    stats.rejected++;
+    portEXIT_CRITICAL(&mux);
+    LOG_W(Mqtt, "Refused %s: %u clients connected", clientId, Config::Broker::MAX_CLIENTS);
+    return PicoMQTT::CRC_SERVER_UNAVAILABLE;
+}
+
+void BrokerServer::on_connected(const char *clientId)
+{
+    portENTER_CRITICAL(&mux);
+    stats.clients++;
+    stats.connects++;
+    if (stats.clients > stats.peakClients)
+        stats.peakClients = stats.clients;
+    portEXIT_CRITICAL(&mux);
+    LOG_D(Mqtt, "Client connected: %s", clientId);
+}
+
+void BrokerServer::on_disconnected(const char *clientId)
+{
+    disconnectsThisPass++;
+    portENTER_CRITICAL(&mux);
+    if (stats.clients)
+        stats.clients--;
+    stats.disconnects++;
+    portEXIT_CRITICAL(&mux);
+    LOG_D(Mqtt, "Client disconnected: %s", clientId);
+}
+
+void BrokerServer::on_subscribe(const char *clientId, const char *topic)
+{
+    portENTER_CRITICAL(&mux);
+    stats.subscriptions++;
+    portEXIT_CRITICAL(&mux);
+}
+
+void BrokerServer::on_unsubscribe(const char *clientId, const char *topic)
+{
+    portENTER_CRITICAL(&mux);
+    if (stats.subscriptions)
+        stats.subscriptions--;
+    portEXIT_CRITICAL(&mux);
+}
+
+void BrokerServer::report(JsonObject out)
+{
+    portENTER_CRITICAL(&mux);
+    Stats s = stats;
+    portEXIT_CRITICAL(&mux);
+
+    out["capacityMode"] = Config::Broker::CAPACITY_MODE;
+    out["clients"] = s.clients;
+    out["maxClients"] = Config::Broker::MAX_CLIENTS;
+    out["peakClients"] = s.peakClients;
+    out["connects"] = s.connects;
+    out["rejected"] = s.rejected;
+    out["disconnects"] = s.disconnects;
+    out["slowDisconnects"] = s.slowDisconnects;
+    out["subscriptions"] = s.subscriptions;
+    out["lastPassUs"] = s.lastPassUs;
+    out["longestPassUs"] = s.longestPassUs;
+    out["internalPerClient"] = s.internalPerClient;
+    out["psramPerClient"] = s.psramPerClient;
+    out["internalFree"] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out["psramFree"] = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+}
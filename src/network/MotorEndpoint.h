@@ -0,0 +1,226 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <IPAddress.h>
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/JsonArena.h"
+#include "../core/LatencyTracker.h"
+#include "../core/MotorMailbox.h"
+#include "../core/Replay.h"
+#include "../core/Log.h"
+
+// POST /api/motor: jog commands from browsers and scripts. Decoding and
+// rate limiting run on the async_tcp task; commands only reach the motors
+// through MotorMailbox, taken by the next control pass.
+//
+//   JSON    {"axis":0,"action":"set","speed":500,"id":7}  (hub/cmd/motor actions)
+//   Binary  application/octet-stream, one 8-byte frame per axis:
+//           axis u8, op u8 (0 set, 1 stop, 2 brake, 3 coast), speed i16, id u32
+//
+// Each client address gets a token bucket of BURST requests refilled at
+// RATE_PER_SECOND. async_tcp task only, so nothing here is locked.
+class MotorEndpoint
+{
+public:
+    enum class Result : uint8_t
+    {
+        Accepted,
+        RateLimited,
+        Invalid,
+        TooLarge,
+        Replaying,
+        COUNT
+    };
+
+    static const char *resultName(Result result);
+
+    // Called once per request, before its body is read
+    bool admit(uint32_t address, uint32_t nowUs);
+
+    // Decodes a whole body and posts its commands, all or none
+    Result handle(const uint8_t *body, size_t len, bool binary, uint32_t ingressUs, JsonArena &arena);
+
+    // Requests turned away before handle(), e.g. oversized bodies
+    void reject(Result result) { results[(uint8_t)result]++; }
+
+    void report(JsonObject out);
+
+private:
+    // Bucket level in microseconds of refill; a request costs COST_US
+    static constexpr uint32_t COST_US = 1000000UL / Config::HttpMotor::RATE_PER_SECOND;
+    static constexpr uint32_t CAPACITY_US = COST_US * Config::HttpMotor::BURST;
+
+    struct Client
+    {
+        uint32_t address = 0;
+        uint32_t creditUs = 0;
+        uint32_t lastUs = 0;
+        uint32_t requests = 0; // 0: slot unused
+        uint32_t rejected = 0;
+    };
+
+    Client clients[Config::HttpMotor::MAX_CLIENTS];
+    uint32_t results[(uint8_t)Result::COUNT] = {};
+
+    Client &clientFor(uint32_t address, uint32_t nowUs);
+    static bool decodeJson(JsonVariantConst doc, uint8_t &axis, MotorMailbox::Command &command);
+};
+
+const char *MotorEndpoint::resultName(Result result)
+{
+    switch (result)
+    {
+    case Result::Accepted:
+        return "accepted";
+    case Result::RateLimited:
+        return "rate_limited";
+    case Result::TooLarge:
+        return "too_large";
+    case Result::Replaying:
+        return "replaying";
+    default:
+        return "invalid";
+    }
+}
+
+MotorEndpoint::Client &MotorEndpoint::clientFor(uint32_t address, uint32_t nowUs)
+{
+    Client *oldest = &clients[0];
+    for (Client &client : clients)
+    {
+        if (client.requests && client.address == address)
+            return client;
+        if (!client.requests)
+        {
+            oldest = &client;
+            break;
+        }
+        if (nowUs - client.lastUs > nowUs - oldest->lastUs)
+            oldest = &client;
+    }
+
+    // New or evicted: starts with a full bucket
+    *oldest = Client();
+    oldest->address = address;
+    oldest->creditUs = CAPACITY_US;
+    oldest->lastUs = nowUs;
+    return *oldest;
+}
+
+bool MotorEndpoint::admit(uint32_t address, uint32_t nowUs)
+{
+    Client &client = clientFor(address, nowUs);
+    uint32_t elapsed = nowUs - client.lastUs;
+    client.creditUs = elapsed >= CAPACITY_US - client.creditUs ? CAPACITY_US : client.creditUs + elapsed;
+    client.lastUs = nowUs;
+    client.requests++;
+
+    if (client.creditUs < COST_US)
+    {
+        client.rejected++;
+        results[(uint8_t)Result::RateLimited]++;
+        LOG_D(Web, "Motor request from %s rate limited", IPAddress(address).toString().c_str());
+        return false;
+    }
+    client.creditUs -= COST_US;
+    return true;
+}
+
+bool MotorEndpoint::decodeJson(JsonVariantConst doc, uint8_t &axis, MotorMailbox::Command &command)
+{
+    // Both are required: a stray {} must not stop axis 0
+    if (!doc["axis"].is<unsigned>() || !doc["action"].is<const char *>())
+        return false;
+    unsigned axisIndex = doc["axis"];
+    const char *action = doc["action"];
+    if (axisIndex >= Config::Axes::COUNT)
+        return false;
+    axis = axisIndex;
+    command.id = doc["id"] | 0u;
+
+    // forward/backward take a magnitude, as on hub/cmd/motor
+    if (strcmp(action, "forward") == 0 || strcmp(action, "backward") == 0)
+    {
+        int speed = constrain(doc["speed"] | Config::Motor::MAX_SPEED, 0, Config::Motor::MAX_SPEED);
+        command.op = MotorMailbox::Op::Set;
+        command.speed = action[0] == 'f' ? speed : -speed;
+        return true;
+    }
+    if (!MotorMailbox::parseOp(action, command.op))
+        return false;
+    command.speed = constrain(doc["speed"] | 0, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
+    return true;
+}
+
+MotorEndpoint::Result MotorEndpoint::handle(const uint8_t *body, size_t len, bool binary, uint32_t ingressUs, JsonArena &arena)
+{
+    uint8_t axes[Config::Axes::COUNT];
+    MotorMailbox::Command commands[Config::Axes::COUNT];
+    uint8_t count = 0;
+    Result result = Result::Accepted;
+
+    if (Replay::replaying())
+    {
+        result = Result::Replaying;
+    }
+    else if (binary)
+    {
+        if (len == 0 || len % Config::HttpMotor::FRAME_BYTES || len / Config::HttpMotor::FRAME_BYTES > Config::Axes::COUNT)
+            result = Result::Invalid;
+
+        for (size_t offset = 0; result == Result::Accepted && offset < len; offset += Config::HttpMotor::FRAME_BYTES)
+        {
+            const uint8_t *frame = body + offset;
+            MotorMailbox::Command &command = commands[count];
+            axes[count] = frame[0];
+            command.op = (MotorMailbox::Op)frame[1];
+            command.speed = (int16_t)(frame[2] | frame[3] << 8);
+            command.id = frame[4] | frame[5] << 8 | frame[6] << 16 | (uint32_t)frame[7] << 24;
+            if (axes[count] >= Config::Axes::COUNT || frame[1] >= (uint8_t)MotorMailbox::Op::COUNT)
+                result = Result::Invalid;
+            count++;
+        }
+    }
+    else
+    {
+        JsonArena::Scope scope(arena, "motor");
+        JsonDocument doc(&arena);
+        if (deserializeJson(doc, body, len) || !decodeJson(doc.as<JsonVariantConst>(), axes[0], commands[0]))
+            result = Result::Invalid;
+        count = 1;
+    }
+
+    results[(uint8_t)result]++;
+    if (result != Result::Accepted)
+        return result;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        commands[i].ingressUs = ingressUs;
+        MotorMailbox::post(axes[i], commands[i]);
+    }
+    return result;
+}
+
+void MotorEndpoint::report(JsonObject out)
+{
+    JsonObject requests = out["requests"].to<JsonObject>();
+    for (uint8_t i = 0; i < (uint8_t)Result::COUNT; i++)
+        requests[resultName((Result)i)] = results[i];
+
+    MotorMailbox::report(out["commands"].to<JsonObject>());
+    LatencyTracker::report(out["latency"].to<JsonObject>(), CommandSource::Http);
+
+    JsonArray list = out["clients"].to<JsonArray>();
+    for (const Client &client : clients)
+    {
+        if (!client.requests)
+            continue;
+        JsonObject entry = list.add<JsonObject>();
+        entry["address"] = IPAddress(client.address).toString();
+        entry["requests"] = client.requests;
+        entry["rejected"] = client.rejected;
+    }
+}
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include <PicoMQTT.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <esp_mac.h>
+#include <rom/miniz.h>
+#include <atomic>
+#include <utility>
+#include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/FixedString.h"
+#include "../core/Timebase.h"
+
+// Upstream bridge: topics matching Config::Bridge::FORWARD are batched and
+// published to an upstream broker as <ROOT>/<device>/batch (or batch/z when
+// deflate wins), and upstream <ROOT>/<device>/cmd/... and .../axis/+/cmd are
+// injected locally as hub/.... The client runs in its own task, since a
+// connect attempt can block for seconds; the loop only appends to the
+// current batch and drains the command inbox.
+//
+// Nothing is copied inside a critical section: the batch ring holds
+// pointers, so the task takes a sealed batch by swapping it with its
+// `sending` buffer, and the loop appends to the open batch after reserving
+// the space. The inbox is a single-producer ring the loop dispatches from
+// in place.
+//
+// Batch body: one "<topic>\t<payload>\n" line per message, oldest first.
+class MqttBridge
+{
+public:
+    // Loop task; the bridge stays off when no upstream host is configured
+    void begin();
+    bool enabled() const { return task != nullptr; }
+
+    // Loop task: queues the message if its topic is forwarded
+    void offer(const char *topic, const char *payload);
+
+    // Loop task: hands upstream commands to `dispatch(topic, payload)`
+    template <typename Dispatch>
+    void poll(Dispatch &&dispatch);
+
+    static void report(JsonObject out);
+
+    // MQTT filter match with + and # wildcards
+    static bool matches(const char *filter, const char *topic);
+
+private:
+    struct Batch
+    {
+        uint64_t openedMs;
+        uint16_t size;
+        uint16_t messages;
+        char data[Config::Bridge::BATCH_MAX_BYTES];
+    };
+
+    struct Command
+    {
+        FixedString<Config::Mqtt::MAX_TOPIC_SIZE> topic;
+        FixedString<Config::Mqtt::MAX_MESSAGE_SIZE> payload;
+    };
+
+    struct Stats
+    {
+        bool connected = false;
+        uint32_t forwarded = 0;  // Messages accepted into a batch
+        uint32_t batches = 0;    // Batches published upstream
+        uint32_t rawBytes = 0;   // Batch bodies before compression
+        uint32_t sentBytes = 0;  // Bytes actually published
+        uint32_t dropped = 0;    // Messages lost to a full queue
+        uint32_t injected = 0;   // Upstream commands handed to the loop
+        uint32_t backlog = 0;    // Messages waiting upstream
+        uint32_t backlogBytes = 0;
+    };
+
+    PicoMQTT::Client client;
+    FixedString<Config::Mqtt::MAX_TOPIC_SIZE> prefix; // <ROOT>/<device>
+    FixedString<64> host;
+    TaskHandle_t task = nullptr;
+
+    // Batch ring: [first, first + count), the newest one open while `open`.
+    // `filling` is set while the loop copies into the newest batch.
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    Batch *ring[Config::Bridge::QUEUE_BATCHES] = {};
+    uint8_t first = 0;
+    uint8_t count = 0;
+    bool open = false;
+    bool filling = false;
+
+    // Written by the bridge task at inboxTail, read by the loop at inboxHead
+    static_assert((Config::Bridge::INBOX_SIZE & (Config::Bridge::INBOX_SIZE - 1)) == 0, "Bridge inbox size must be a power of two");
+    Command inbox[Config::Bridge::INBOX_SIZE];
+    std::atomic<uint32_t> inboxHead{0};
+    std::atomic<uint32_t> inboxTail{0};
+
+    // Bridge task only; swapped with the ring slot it takes
+    Batch *sending = nullptr;
+    uint8_t *compressed = nullptr;
+    tdefl_compressor *compressor = nullptr;
+
+    static portMUX_TYPE statsMux;
+    static Stats stats;
+
+    static void taskEntry(void *self);
+    void run();
+    void onCommand(const char *topic, const char *payload);
+    bool takeSealed(uint64_t now);
+    bool send(const Batch &batch);
+};
+
+portMUX_TYPE MqttBridge::statsMux = portMUX_INITIALIZER_UNLOCKED;
+MqttBridge::Stats MqttBridge::stats;
+
+void MqttBridge::begin()
+{
+    Preferences prefs;
+    prefs.begin("wifi-cfg", true);
+    char stored[64] = "";
+    prefs.getString("bridge_host", stored, sizeof(stored));
+    prefs.end();
+
+    host = stored[0] ? stored : Config::Bridge::HOST;
+    if (host.isEmpty())
+    {
+        LOG_I(MqttCtrl, "Bridge off (no upstream host)");
+        return;
+    }
+
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    prefix.format("%s/hub-%02x%02x%02x", Config::Bridge::TOPIC_ROOT, mac[3], mac[4], mac[5]);
+
+    size_t ringBytes = Config::Bridge::QUEUE_BATCHES * sizeof(Batch);
+    Batch *batches = (Batch *)heap_caps_malloc(ringBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    sending = (Batch *)heap_caps_malloc(sizeof(Batch), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    compressed = (uint8_t *)heap_caps_malloc(Config::Bridge::BATCH_MAX_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (Config::Bridge::COMPRESS)
+        compressor = (tdefl_compressor *)heap_caps_malloc(sizeof(tdefl_compressor), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!batches || !sending || !compressed)
+    {
+        LOG_E(MqttCtrl, "Bridge off: no PSRAM for %u byte batch queue", (unsigned)ringBytes);
+        return;
+    }
+    for (uint8_t i = 0; i < Config::Bridge::QUEUE_BATCHES; i++)
+        ring[i] = &batches[i];
+
+    client.host = host.c_str();
+    client.port = Config::Bridge::PORT;
+    client.client_id = prefix.c_str() + strlen(Config::Bridge::TOPIC_ROOT) + 1;
+
+    FixedString<Config::Mqtt::MAX_TOPIC_SIZE> filter;
+    filter.format("%s/cmd/#", prefix.c_str());
+    client.subscribe(filter.c_str(), [this](const char *topic, const char *payload) { onCommand(topic, payload); });
+    filter.format("%s/axis/+/cmd", prefix.c_str());
+    client.subscribe(filter.c_str(), [this](const char *topic, const char *payload) { onCommand(topic, payload); });
+
+    xTaskCreatePinnedToCore(taskEntry, "mqtt_bridge", Config::Bridge::TASK_STACK_SIZE, this,
+                            Config::Bridge::TASK_PRIORITY, &task, Config::Bridge::TASK_CORE);
+    LOG_I(MqttCtrl, "Bridge to %s:%u as %s", host.c_str(), Config::Bridge::PORT, prefix.c_str());
+}
+
+// MQTT filter match with + and # wildcards
+bool MqttBridge::matches(const char *filter, const char *topic)
+{
+    while (*filter)
+    {
+        if (*filter == '#')
+            return true;
+        if (*filter == '+')
+        {
+            while (*topic && *topic != '/')
+                topic++;
+            filter++;
+            continue;
+        }
+        if (*filter != *topic)
+            return false;
+        filter++;
+        topic++;
+    }
+    return *topic == '\0';
+}
+
+void MqttBridge::offer(const char *topic, const char *payload)
+{
+    if (!task)
+        return;
+
+    bool forward = false;
+    for (const char *filter : Config::Bridge::FORWARD)
+        forward = forward || matches(filter, topic);
+    if (!forward)
+        return;
+
+    size_t topicLen = strlen(topic);
+    size_t payloadLen = strlen(payload);
+    size_t need = topicLen + payloadLen + 2;
+    if (need > Config::Bridge::BATCH_MAX_BYTES)
+    {
+        portENTER_CRITICAL(&statsMux);
+        stats.dropped++;
+        portEXIT_CRITICAL(&statsMux);
+        return;
+    }
+
+    uint32_t lost = 0;
+    uint32_t lostBytes = 0;
+    // Reserve the space under the lock, copy outside it. The newest batch
+    // stays in the ring while `filling`, and only this task drops batches.
+    portENTER_CRITICAL(&mux);
+    Batch *batch = open ? ring[(first + count - 1) % Config::Bridge::QUEUE_BATCHES] : nullptr;
+    if (!batch || batch->size + need > Config::Bridge::BATCH_MAX_BYTES)
+    {
+        if (count == Config::Bridge::QUEUE_BATCHES)
+        {
+            // Upstream is behind: the oldest batch goes
+            lost = ring[first]->messages;
+            lostBytes = ring[first]->size;
+            first = (first + 1) % Config::Bridge::QUEUE_BATCHES;
+            count--;
+        }
+        batch = ring[(first + count) % Config::Bridge::QUEUE_BATCHES];
+        batch->openedMs = Timebase::nowMs();
+        batch->size = 0;
+        batch->messages = 0;
+        count++;
+        open = true;
+    }
+    char *p = batch->data + batch->size;
+    batch->size += need;
+    batch->messages++;
+    filling = true;
+    portEXIT_CRITICAL(&mux);
+
+    memcpy(p, topic, topicLen);
+    p[topicLen] = '\t';
+    memcpy(p + topicLen + 1, payload, payloadLen);
+    p[need - 1] = '\n';
+
+    portENTER_CRITICAL(&mux);
+    filling = false;
+    portEXIT_CRITICAL(&mux);
+
+    portENTER_CRITICAL(&statsMux);
+    stats.forwarded++;
+    stats.dropped += lost;
+    stats.backlog = stats.backlog + 1 - lost;
+    stats.backlogBytes = stats.backlogBytes + need - lostBytes;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Upstream <prefix>/cmd/motor -> hub/cmd/motor; queued for the loop
+void MqttBridge::onCommand(const char *topic, const char *payload)
+{
+    uint32_t tail = inboxTail.load(std::memory_order_relaxed);
+    if (tail - inboxHead.load(std::memory_order_acquire) >= Config::Bridge::INBOX_SIZE)
+    {
+        LOG_W(MqttCtrl, "Bridge inbox full, dropped %s", topic);
+        return;
+    }
+
+    // The slot is the bridge task's until the tail moves past it
+    Command &cmd = inbox[tail % Config::Bridge::INBOX_SIZE];
+    cmd.topic = "hub";
+    cmd.topic += topic + prefix.length();
+    cmd.payload = payload;
+    inboxTail.store(tail + 1, std::memory_order_release);
+}
+
+template <typename Dispatch>
+void MqttBridge::poll(Dispatch &&dispatch)
+{
+    while (task)
+    {
+        uint32_t head = inboxHead.load(std::memory_order_relaxed);
+        if (head == inboxTail.load(std::memory_order_acquire))
+            return;
+
+        // Dispatched in place; the slot is released afterwards
+        const Command &cmd = inbox[head % Config::Bridge::INBOX_SIZE];
+        dispatch(cmd.topic.c_str(), cmd.payload.c_str());
+        inboxHead.store(head + 1, std::memory_order_release);
+
+        portENTER_CRITICAL(&statsMux);
+        stats.injected++;
+        portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+void MqttBridge::taskEntry(void *self)
+{
+    static_cast<MqttBridge *>(self)->run();
+}
+
+// Takes the oldest batch into `sending` once it is sealed (full, or open for
+// BATCH_INTERVAL_MS). A sole batch the loop is still copying into waits for
+// the next poll.
+bool MqttBridge::takeSealed(uint64_t now)
+{
+    bool taken = false;
+    portENTER_CRITICAL(&mux);
+    if (count > 0 && !(filling && count == 1))
+    {
+        bool stillOpen = open && count == 1;
+        if (stillOpen && now - ring[first]->openedMs >= Config::Bridge::BATCH_INTERVAL_MS)
+        {
+            open = false;
+            stillOpen = false;
+        }
+        if (!stillOpen)
+        {
+            std::swap(ring[first], sending);
+            first = (first + 1) % Config::Bridge::QUEUE_BATCHES;
+            count--;
+            taken = true;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+    return taken;
+}
+
+bool MqttBridge::send(const Batch &batch)
+{
+    FixedString<Config::Mqtt::MAX_TOPIC_SIZE> topic;
+    const uint8_t *body = (const uint8_t *)batch.data;
+    size_t size = batch.size;
+
+    // Raw deflate (zlib.decompress(data, -15)); kept only when it is smaller
+    if (compressor)
+    {
+        size_t inSize = batch.size;
+        size_t outSize = Config::Bridge::BATCH_MAX_BYTES;
+        tdefl_init(compressor, nullptr, nullptr, Config::Bridge::DEFLATE_PROBES);
+        if (tdefl_compress(compressor, batch.data, &inSize, compressed, &outSize, TDEFL_FINISH) == TDEFL_STATUS_DONE &&
+            outSize < size)
+        {
+            body = compressed;
+            size = outSize;
+        }
+    }
+
+    topic.format(body == compressed ? "%s/batch/z" : "%s/batch", prefix.c_str());
+    if (!client.publish(topic.c_str(), body, size))
+        return false;
+
+    portENTER_CRITICAL(&statsMux);
+    stats.batches++;
+    stats.rawBytes += batch.size;
+    stats.sentBytes += size;
+    stats.backlog -= min(stats.backlog, (uint32_t)batch.messages);
+    stats.backlogBytes -= min(stats.backlogBytes, (uint32_t)batch.size);
+    portEXIT_CRITICAL(&statsMux);
+    return true;
+}
+
+void MqttBridge::run()
+{
+    client.begin();
+    bool pending = false;
+
+    for (;;)
+    {
+        client.loop();
+        bool connected = client.connected();
+
+        portENTER_CRITICAL(&statsMux);
+        stats.connected = connected;
+        portEXIT_CRITICAL(&statsMux);
+
+        // One batch in hand at a time; retried until the upstream takes it
+        uint64_t now = Timebase::nowMs();
+        if (!pending)
+            pending = takeSealed(now);
+        while (pending && connected && send(*sending))
+            pending = takeSealed(now);
+
+        vTaskDelay(pdMS_TO_TICKS(Config::Bridge::POLL_INTERVAL_MS));
+    }
+}
+
+void MqttBridge::report(JsonObject out)
+{
+    portENTER_CRITICAL(&statsMux);
+    Stats s = stats;
+    portEXIT_CRITICAL(&statsMux);
+
+    out["connected"] = s.connected;
+    out["forwarded"] = s.forwarded;
+    out["batches"] = s.batches;
+    out["rawBytes"] = s.rawBytes;
+    out["sentBytes"] = s.sentBytes;
+    out["compression"] = s.rawBytes ? (float)s.sentBytes / s.rawBytes : 1.0f;
+    out["backlog"] = s.backlog;
+    out["backlogBytes"] = s.backlogBytes;
+    out["dropped"] = s.dropped;
+    out["injected"] = s.injected;
+}
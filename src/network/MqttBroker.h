@@ -6,7 +6,13 @@
 #include <PicoMQTT.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/Trace.h"
+#include "../core/PowerManager.h"
+#include "../core/Replay.h"
 #include "MqttController.h"
+#include "MqttBridge.h"
+#include "BrokerServer.h"
 
 class MqttBroker
 {
@@ -16,36 +22,72 @@ public:
 
     PicoMQTT::Server& getBroker() { return mqttBroker; }
 
+    // Replayed command, handled as if it had just arrived
+    void inject(DeviceState &state, const char *topic, const char *payload);
+
 private:
-    PicoMQTT::Server mqttBroker;
+    BrokerServer mqttBroker;
     MqttController controller;
+    MqttBridge bridge;
     bool mdnsStarted = false;
 
     void startMDNS();
+    // Commands from local clients and the bridge; recorded, or dropped while a replay runs
+    void route(DeviceState &state, const char *topic, const char *payload);
+    void dispatch(DeviceState &state, const char *topic, const char *payload);
 };
 
 void MqttBroker::begin(DeviceState &state)
 {
     // Setup MQTT broker
     mqttBroker.begin();
-    Serial0.printf("%s Broker started on port %d\n", Config::Debug::LOG_MQTT, Config::Mqtt::PORT);
+    LOG_I(Mqtt, "Broker started on port %d, up to %u clients", Config::Mqtt::PORT, Config::Broker::MAX_CLIENTS);
 
-    // Initialize controller with broker reference
-    controller.begin(mqttBroker);
+    // Initialize controller with broker and upstream bridge
+    bridge.begin();
+    controller.begin(mqttBroker, bridge);
 
     // Subscribe to command topics
     mqttBroker.subscribe(Config::Mqtt::TOPIC_CMD_MOTOR, [&state, this](const char* topic, const char* payload) {
-        this->controller.processMotorCommand(state, payload);
+        TRACE_SCOPE("mqtt_motor");
+        PowerManager::notifyActivity();
+        this->route(state, topic, payload);
+    });
+
+    mqttBroker.subscribe(Config::Mqtt::TOPIC_AXIS_CMD, [&state, this](const char* topic, const char* payload) {
+        TRACE_SCOPE("mqtt_axis");
+        PowerManager::notifyActivity();
+        this->route(state, topic, payload);
+    });
+
+    mqttBroker.subscribe(Config::Mqtt::TOPIC_CMD_SYNC, [&state, this](const char* topic, const char* payload) {
+        TRACE_SCOPE("mqtt_sync");
+        PowerManager::notifyActivity();
+        this->route(state, topic, payload);
     });
 
     mqttBroker.subscribe(Config::Mqtt::TOPIC_CMD_CONFIG, [&state, this](const char* topic, const char* payload) {
-        this->controller.processConfigCommand(state, payload);
+        TRACE_SCOPE("mqtt_config");
+        PowerManager::notifyActivity();
+        this->route(state, topic, payload);
+    });
+
+    mqttBroker.subscribe(Config::Mqtt::TOPIC_CMD_HOME, [&state, this](const char* topic, const char* payload) {
+        TRACE_SCOPE("mqtt_home");
+        PowerManager::notifyActivity();
+        this->route(state, topic, payload);
+    });
+
+    mqttBroker.subscribe(Config::Mqtt::TOPIC_CMD_SEQUENCE, [&state, this](const char* topic, const char* payload) {
+        TRACE_SCOPE("mqtt_sequence");
+        PowerManager::notifyActivity();
+        this->route(state, topic, payload);
     });
 
     // Publish online status
     controller.publish(Config::Mqtt::TOPIC_STATUS, R"({"status":"online"})");
 
-    Serial0.printf("%s Subscriptions setup complete\n", Config::Debug::LOG_MQTT);
+    LOG_I(Mqtt, "Subscriptions setup complete");
 
     startMDNS();
 }
@@ -57,18 +99,59 @@ void MqttBroker::startMDNS()
         if (MDNS.begin(Config::Mqtt::MDNS_HOSTNAME))
         {
             mdnsStarted = true;
-            Serial0.printf("[mDNS] Responder started: %s.local\n", Config::Mqtt::MDNS_HOSTNAME);
+            LOG_I(Mdns, "Responder started: %s.local", Config::Mqtt::MDNS_HOSTNAME);
             // Advertise MQTT service
             MDNS.addService(Config::Mqtt::MDNS_SERVICE, Config::Mqtt::MDNS_PROTOCOL, Config::Mqtt::PORT);
-            Serial0.printf("[mDNS] Service advertised: %s on port %d\n", Config::Mqtt::MDNS_SERVICE, Config::Mqtt::PORT);
+            LOG_I(Mdns, "Service advertised: %s on port %d", Config::Mqtt::MDNS_SERVICE, Config::Mqtt::PORT);
         }
         else
         {
-            Serial0.println("[mDNS] Error setting up MDNS responder");
+            LOG_E(Mdns, "Error setting up MDNS responder");
         }
     }
 }
 
+void MqttBroker::route(DeviceState &state, const char *topic, const char *payload)
+{
+    // Live commands would interleave with the replayed ones
+    if (Replay::replaying())
+    {
+        LOG_D(Mqtt, "Replay running, dropped command on %s", topic);
+        return;
+    }
+
+    Replay::command(topic, payload);
+    uint32_t start = micros();
+    dispatch(state, topic, payload);
+    Replay::handled(topic, micros() - start);
+}
+
+void MqttBroker::inject(DeviceState &state, const char *topic, const char *payload)
+{
+    TRACE_SCOPE("replay_cmd");
+    uint32_t start = micros();
+    dispatch(state, topic, payload);
+    Replay::handled(topic, micros() - start);
+}
+
+void MqttBroker::dispatch(DeviceState &state, const char *topic, const char *payload)
+{
+    if (strcmp(topic, Config::Mqtt::TOPIC_CMD_MOTOR) == 0)
+        controller.processMotorCommand(state.axes[0], payload);
+    else if (strcmp(topic, Config::Mqtt::TOPIC_CMD_SYNC) == 0)
+        controller.processSyncCommand(state, payload);
+    else if (strcmp(topic, Config::Mqtt::TOPIC_CMD_CONFIG) == 0)
+        controller.processConfigCommand(state, payload);
+    else if (strcmp(topic, Config::Mqtt::TOPIC_CMD_HOME) == 0)
+        controller.processHomeCommand(state, payload);
+    else if (strcmp(topic, Config::Mqtt::TOPIC_CMD_SEQUENCE) == 0)
+        controller.processSequenceCommand(payload);
+    else if (MqttBridge::matches(Config::Mqtt::TOPIC_AXIS_CMD, topic))
+        controller.processAxisCommand(state, topic, payload);
+    else
+        LOG_W(Mqtt, "No handler for %s", topic);
+}
+
 void MqttBroker::update(DeviceState &state)
 {
     // Only run MQTT when WiFi is connected to save CPU
@@ -77,10 +160,7 @@ void MqttBroker::update(DeviceState &state)
         state.mqttConnected = true;
         
         // MQTT broker loop
-        mqttBroker.loop();
-
-        // Update controller (telemetry publish)
-        controller.update(state);
+        mqttBroker.update();
 
         // Start MDNS if not started
         if (!mdnsStarted)
@@ -92,4 +172,14 @@ void MqttBroker::update(DeviceState &state)
     {
         state.mqttConnected = false;
     }
+
+    // Upstream commands arrive over the bridge's own connection
+    bridge.poll([&](const char *topic, const char *payload) {
+        TRACE_SCOPE("bridge_cmd");
+        PowerManager::notifyActivity();
+        route(state, topic, payload);
+    });
+
+    // Telemetry keeps being sampled offline, into the backlog
+    controller.update(state);
 }
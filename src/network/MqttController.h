@@ -5,63 +5,156 @@
 #include <PicoMQTT.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/JsonArena.h"
+#include "../core/MemoryMonitor.h"
+#include "../core/FixedString.h"
+#include "../core/ChangeTracker.h"
+#include "../core/Timebase.h"
+#include "../core/SequenceEngine.h"
+#include "../core/Replay.h"
+#include "TelemetryStore.h"
+#include "MqttBridge.h"
 
 class MqttController
 {
 public:
-    void begin(PicoMQTT::Server &broker);
+    void begin(PicoMQTT::Server &broker, MqttBridge &bridge);
     void update(DeviceState &state);
 
     // Process incoming MQTT messages
     void handleMessage(const char* topic, const char* payload);
 
     // Process commands (called by broker)
-    void processMotorCommand(DeviceState &state, const char* payload);
+    void processMotorCommand(AxisState &axis, const char* payload);
+    void processAxisCommand(DeviceState &state, const char* topic, const char* payload);
+    void processSyncCommand(DeviceState &state, const char* payload);
     void processConfigCommand(DeviceState &state, const char* payload);
+    void processHomeCommand(DeviceState &state, const char* payload);
+    void processSequenceCommand(const char* payload);
 
     // Publish message through broker
     void publish(const char* topic, const char* payload);
 
 private:
     PicoMQTT::Server* mqttBroker = nullptr;
+    MqttBridge* bridge = nullptr;
+    JsonArena arena; // Loop task only
+    TelemetryStore backlog;
+    bool wasOnline = false;
+    uint64_t onlineSinceMs = 0;
 
-    unsigned long lastTelemetryTime = 0;
+    TelemetryFrame frame;
+    ChangeTracker deltaTracker; // Reference: what subscribers last received
+    char keyframe[Config::Telemetry::KEYFRAME_BYTES];
+    uint64_t lastKeyframeTime = 0;
+    uint64_t lastDeltaTime = 0;
+    uint32_t telemetrySeq = 0;
+    uint64_t lastMemoryTime = 0;
+    bool lastMemoryLow = false;
+    CurrentAlarm lastAlarm[Config::Axes::COUNT] = {};
+    bool lastLoadStall[Config::Axes::COUNT] = {};
+    uint32_t lastActuatedSeq[Config::Axes::COUNT] = {};
+    uint32_t lastLogSeq = 0;
 
-    String pendingTopic;
-    String pendingPayload;
+    FixedString<Config::Mqtt::MAX_TOPIC_SIZE> pendingTopic;
+    FixedString<Config::Mqtt::MAX_MESSAGE_SIZE> pendingPayload;
     bool hasPendingPublish = false;
 
     void publishTelemetry(DeviceState &state);
+    void publishDelta(DeviceState &state);
+    void publishAlarms(DeviceState &state);
+    void publishLoadStall(DeviceState &state, uint8_t index);
+    void publishMemory(DeviceState &state);
+    void publishEchoes(DeviceState &state);
+    void publishLogs();
+
+    // Live while the broker runs, otherwise into the backlog
+    void emit(DeviceState &state, const char *topic, const char *payload);
+    // Local broker plus the upstream bridge
+    void send(const char *topic, const char *payload);
 };
 
-void MqttController::begin(PicoMQTT::Server &broker)
+void MqttController::begin(PicoMQTT::Server &broker, MqttBridge &upstream)
 {
     mqttBroker = &broker;
+    bridge = &upstream;
+    arena.begin("mqtt", Config::Json::MQTT_ARENA_SIZE);
+    backlog.begin();
 
-    Serial0.printf("%s Controller initialized\n", Config::Debug::LOG_MQTT_CTRL);
+    LOG_I(MqttCtrl, "Controller initialized");
 }
 
 void MqttController::update(DeviceState &state)
 {
-    // Publish telemetry periodically
-    unsigned long now = millis();
-    if (now - lastTelemetryTime >= Config::Mqtt::TELEMETRY_INTERVAL_MS)
-    {
-        lastTelemetryTime = now;
+    // Keyframes and alarms are produced online or not; the backlog covers
+    // outages. Deltas only make sense live, so offline keyframes run faster.
+    uint64_t now = Timebase::nowMs();
+    unsigned long keyframeInterval = state.mqttConnected ? Config::Telemetry::KEYFRAME_INTERVAL_MS
+                                                         : Config::Telemetry::OFFLINE_INTERVAL_MS;
+    if (now - lastKeyframeTime >= keyframeInterval || (state.mqttConnected && !wasOnline))
         publishTelemetry(state);
+    else if (state.mqttConnected && now - lastDeltaTime >= Config::Telemetry::MIN_INTERVAL_MS)
+        publishDelta(state);
+
+    publishAlarms(state);
+    backlog.report(state);
+
+    if (!state.mqttConnected)
+    {
+        wasOnline = false;
+        return;
+    }
+    if (!wasOnline)
+    {
+        wasOnline = true;
+        onlineSinceMs = now;
     }
 
+    if (now - lastMemoryTime >= Config::Memory::PUBLISH_INTERVAL_MS || state.memoryLow != lastMemoryLow)
+    {
+        lastMemoryTime = now;
+        publishMemory(state);
+    }
+
+    publishEchoes(state);
+    publishLogs();
+
     // Publish pending message
     if (hasPendingPublish && mqttBroker)
     {
-        mqttBroker->publish(pendingTopic.c_str(), pendingPayload.c_str());
+        send(pendingTopic.c_str(), pendingPayload.c_str());
         hasPendingPublish = false;
     }
+
+    // Give subscribers time to reconnect before draining the backlog
+    if (mqttBroker && now - onlineSinceMs >= Config::Store::REPLAY_HOLDOFF_MS)
+        backlog.replay([this](const char *topic, const char *payload) { send(topic, payload); });
 }
 
 void MqttController::handleMessage(const char* topic, const char* payload)
 {
-    Serial0.printf("%s Received: %s -> %s\n", Config::Debug::LOG_MQTT_CTRL, topic, payload);
+    LOG_D(MqttCtrl, "Received: %s -> %s", topic, payload);
+}
+
+void MqttController::emit(DeviceState &state, const char *topic, const char *payload)
+{
+    if (state.mqttConnected && mqttBroker)
+    {
+        send(topic, payload);
+    }
+    else
+    {
+        Replay::publish(topic, payload);
+        backlog.push(topic, payload);
+    }
+}
+
+void MqttController::send(const char *topic, const char *payload)
+{
+    Replay::publish(topic, payload);
+    mqttBroker->publish(topic, payload);
+    bridge->offer(topic, payload);
 }
 
 void MqttController::publish(const char* topic, const char* payload)
@@ -74,77 +167,399 @@ void MqttController::publish(const char* topic, const char* payload)
     }
 }
 
-void MqttController::processMotorCommand(DeviceState &state, const char* payload)
+void MqttController::processMotorCommand(AxisState &axis, const char* payload)
 {
-    JsonDocument doc;
+    uint32_t ingress = micros();
+    JsonArena::Scope scope(arena, "motor");
+    JsonDocument doc(&arena);
     DeserializationError error = deserializeJson(doc, payload);
 
     if (error)
     {
-        Serial0.printf("%s Failed to parse motor command: %s\n", Config::Debug::LOG_MQTT_CTRL, error.c_str());
+        LOG_W(MqttCtrl, "Failed to parse motor command: %s", error.c_str());
         return;
     }
 
     const char* action = doc["action"] | "stop";
+    uint32_t id = doc["id"] | 0;
 
     if (strcmp(action, "forward") == 0)
     {
         int speed = doc["speed"] | Config::Motor::MAX_SPEED;
-        state.motorSpeed = constrain(speed, 0, Config::Motor::MAX_SPEED);
-        Serial0.printf("%s Motor forward: speed=%d\n", Config::Debug::LOG_MQTT_CTRL, state.motorSpeed);
+        axis.motorSpeed = constrain(speed, 0, Config::Motor::MAX_SPEED);
+        LOG_D(MqttCtrl, "Motor forward: speed=%d", axis.motorSpeed);
     }
     else if (strcmp(action, "backward") == 0)
     {
         int speed = doc["speed"] | Config::Motor::MAX_SPEED;
-        state.motorSpeed = constrain(-speed, -Config::Motor::MAX_SPEED, 0);
-        Serial0.printf("%s Motor backward: speed=%d\n", Config::Debug::LOG_MQTT_CTRL, state.motorSpeed);
+        axis.motorSpeed = constrain(-speed, -Config::Motor::MAX_SPEED, 0);
+        LOG_D(MqttCtrl, "Motor backward: speed=%d", axis.motorSpeed);
     }
     else if (strcmp(action, "stop") == 0)
     {
-        state.motorSpeed = 0;
-        Serial0.printf("%s Motor stop\n", Config::Debug::LOG_MQTT_CTRL);
+        axis.motorSpeed = 0;
+        axis.stopMode = Config::Motor::STOP_MODE;
+        LOG_D(MqttCtrl, "Motor stop");
+    }
+    else if (strcmp(action, "brake") == 0 || strcmp(action, "coast") == 0)
+    {
+        axis.motorSpeed = 0;
+        axis.stopMode = action[0] == 'b' ? Config::Motor::StopMode::Brake : Config::Motor::StopMode::Coast;
+        LOG_D(MqttCtrl, "Motor %s", action);
     }
     else if (strcmp(action, "set") == 0)
     {
         int speed = doc["speed"] | 0;
-        state.motorSpeed = constrain(speed, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
-        Serial0.printf("%s Motor set: speed=%d\n", Config::Debug::LOG_MQTT_CTRL, state.motorSpeed);
+        axis.motorSpeed = constrain(speed, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
+        LOG_D(MqttCtrl, "Motor set: speed=%d", axis.motorSpeed);
+    }
+    else
+    {
+        return;
     }
+
+    axis.stampCommand(CommandSource::Mqtt, ingress, id);
+}
+
+void MqttController::processAxisCommand(DeviceState &state, const char* topic, const char* payload)
+{
+    // hub/axis/<n>/cmd
+    const char* index = topic + strlen(Config::Mqtt::TOPIC_AXIS_PREFIX);
+    char* end = nullptr;
+    unsigned long axis = strtoul(index, &end, 10);
+
+    if (end == index || *end != '/' || axis >= Config::Axes::COUNT)
+    {
+        LOG_W(MqttCtrl, "Unknown axis topic: %s", topic);
+        return;
+    }
+
+    processMotorCommand(state.axes[axis], payload);
+}
+
+void MqttController::processSyncCommand(DeviceState &state, const char* payload)
+{
+    uint32_t ingress = micros();
+    JsonArena::Scope scope(arena, "sync");
+    JsonDocument doc(&arena);
+    DeserializationError error = deserializeJson(doc, payload);
+
+    if (error)
+    {
+        LOG_W(MqttCtrl, "Failed to parse sync command: %s", error.c_str());
+        return;
+    }
+
+    JsonArray speeds = doc["speeds"];
+    if (speeds.isNull() || speeds.size() > Config::Axes::COUNT)
+    {
+        LOG_W(MqttCtrl, "Sync command needs 1..%d speeds", Config::Axes::COUNT);
+        return;
+    }
+
+    // All setpoints land before the next control pass, so every axis starts on the same tick
+    uint32_t id = doc["id"] | 0;
+    uint8_t i = 0;
+    for (JsonVariant speed : speeds)
+    {
+        AxisState &axis = state.axes[i++];
+        axis.motorSpeed = constrain(speed.as<int>(), -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
+        axis.stampCommand(CommandSource::Mqtt, ingress, id);
+    }
+    LOG_D(MqttCtrl, "Sync move: %d axes", i);
 }
 
 void MqttController::processConfigCommand(DeviceState &state, const char* payload)
 {
-    JsonDocument doc;
+    uint32_t ingress = micros();
+    JsonArena::Scope scope(arena, "config");
+    JsonDocument doc(&arena);
     DeserializationError error = deserializeJson(doc, payload);
 
     if (error)
     {
-        Serial0.printf("%s Failed to parse config: %s\n", Config::Debug::LOG_MQTT_CTRL, error.c_str());
+        LOG_W(MqttCtrl, "Failed to parse config: %s", error.c_str());
         return;
     }
 
     const char* param = doc["param"] | "";
     int value = doc["value"] | 0;
+    uint8_t axis = doc["axis"] | 0;
+
+    if (axis >= Config::Axes::COUNT)
+    {
+        LOG_W(MqttCtrl, "Config: invalid axis %d", axis);
+        return;
+    }
+
+    LOG_D(MqttCtrl, "Config: %s = %d", param, value);
+
+    if (strcmp(param, "stallReaction") == 0)
+    {
+        if (value < 0 || value > (int)Config::Stall::Reaction::ReverseRetry)
+        {
+            LOG_W(MqttCtrl, "Config: invalid stall reaction %d", value);
+            return;
+        }
+        state.stallReaction = (Config::Stall::Reaction)value;
+    }
+    else if (strcmp(param, "speed") == 0)
+    {
+        state.axes[axis].motorSpeed = constrain(value, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
+        state.axes[axis].stampCommand(CommandSource::Mqtt, ingress, doc["id"] | 0);
+        LOG_D(MqttCtrl, "Motor %d speed set to %d via config", axis, state.axes[axis].motorSpeed);
+    }
+}
+
+void MqttController::processHomeCommand(DeviceState &state, const char* payload)
+{
+    JsonArena::Scope scope(arena, "home");
+    JsonDocument doc(&arena);
+    DeserializationError error = deserializeJson(doc, payload);
+
+    if (error)
+    {
+        LOG_W(MqttCtrl, "Failed to parse home command: %s", error.c_str());
+        return;
+    }
+
+    uint8_t index = doc["axis"] | 0;
+    if (index >= Config::Axes::COUNT)
+    {
+        LOG_W(MqttCtrl, "Home: invalid axis %d", index);
+        return;
+    }
+
+    AxisState &axis = state.axes[index];
+    int speed = doc["speed"] | Config::Encoder::HOMING_SPEED;
+    axis.homingSpeed = constrain(speed, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
+    axis.homingRequested = true;
+    LOG_I(MqttCtrl, "Homing requested: axis=%d speed=%d", index, axis.homingSpeed);
+}
 
-    Serial0.printf("%s Config: %s = %d\n", Config::Debug::LOG_MQTT_CTRL, param, value);
+void MqttController::processSequenceCommand(const char* payload)
+{
+    JsonArena::Scope scope(arena, "sequence");
+    JsonDocument doc(&arena);
+    DeserializationError error = deserializeJson(doc, payload);
 
-    if (strcmp(param, "speed") == 0)
+    if (error)
     {
-        state.motorSpeed = constrain(value, -Config::Motor::MAX_SPEED, Config::Motor::MAX_SPEED);
-        Serial0.printf("%s Motor speed set to %d via config\n", Config::Debug::LOG_MQTT_CTRL, state.motorSpeed);
+        LOG_W(MqttCtrl, "Failed to parse sequence command: %s", error.c_str());
+        return;
     }
+
+    const char *reason = nullptr;
+    if (!SequenceEngine::handle(doc.as<JsonVariantConst>(), reason))
+        LOG_W(MqttCtrl, "Sequence %s rejected: %s", doc["action"] | "?", reason);
 }
 
+// Every field, in the delta layout, so deltas apply on top of it
 void MqttController::publishTelemetry(DeviceState &state)
 {
-    JsonDocument doc;
-    doc["encoder"] = state.encoderPos;
-    doc["current"] = state.currentAdc;
-    doc["motorSpeed"] = state.motorSpeed;
-    doc["wifiConnected"] = state.wifiConnected;
+    uint64_t now = Timebase::nowMs();
+    lastKeyframeTime = now;
+
+    JsonArena::Scope scope(arena, "telemetry");
+    JsonDocument doc(&arena);
+    JsonObject out = doc.to<JsonObject>();
+    Timebase::stamp(out);
+    out["seq"] = telemetrySeq + 1;
+    frame.capture(state);
+    frame.write(out, ChangeTracker::ALL);
+
+    // A cut keyframe would not parse; nothing is marked as delivered
+    size_t size = measureJson(doc);
+    if (size >= sizeof(keyframe))
+    {
+        LOG_E(MqttCtrl, "Keyframe needs %u bytes, KEYFRAME_BYTES is %u", (unsigned)size, (unsigned)sizeof(keyframe));
+        return;
+    }
+    serializeJson(doc, keyframe, sizeof(keyframe));
+
+    telemetrySeq++;
+    emit(state, Config::Mqtt::TOPIC_TELEMETRY, keyframe);
+
+    // Deltas continue from what this keyframe carried
+    deltaTracker.commit(frame, ChangeTracker::ALL);
+    lastDeltaTime = now;
+}
+
+// Changed fields since the last keyframe/delta; an empty one (ts and seq
+// only) every MAX_INTERVAL_MS tells subscribers the hub is alive. A gap in
+// seq means a lost delta: wait for the next keyframe.
+void MqttController::publishDelta(DeviceState &state)
+{
+    int64_t nowUs = Timebase::nowUs();
+    uint64_t now = nowUs / 1000;
+    frame.capture(state);
+    uint64_t mask = deltaTracker.changes(frame);
+    if (!mask && now - lastDeltaTime < Config::Telemetry::MAX_INTERVAL_MS)
+        return;
+
+    JsonArena::Scope scope(arena, "delta");
+    JsonDocument doc(&arena);
+    JsonObject out = doc.to<JsonObject>();
+    Timebase::stamp(out, nowUs);
+    out["seq"] = telemetrySeq + 1;
+    frame.write(out, mask);
 
     char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+    if (measureJson(doc) >= sizeof(buffer))
+    {
+        // Nearly everything moved at once: a keyframe says it as well
+        publishTelemetry(state);
+        return;
+    }
     serializeJson(doc, buffer, sizeof(buffer));
 
-    publish(Config::Mqtt::TOPIC_TELEMETRY, buffer);
+    telemetrySeq++;
+    send(Config::Mqtt::TOPIC_TELEMETRY_DELTA, buffer);
+    deltaTracker.commit(frame, mask);
+    lastDeltaTime = now;
+}
+
+void MqttController::publishAlarms(DeviceState &state)
+{
+    // Events go out on transitions only (raise and clear)
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        const AxisState &axis = state.axes[i];
+        if (axis.loadStall != lastLoadStall[i])
+        {
+            lastLoadStall[i] = axis.loadStall;
+            publishLoadStall(state, i);
+        }
+
+        if (axis.currentAlarm == lastAlarm[i])
+            continue;
+        lastAlarm[i] = axis.currentAlarm;
+
+        JsonArena::Scope scope(arena, "alarm");
+        JsonDocument doc(&arena);
+        Timebase::stamp(doc.to<JsonObject>());
+        doc["axis"] = i;
+        doc["source"] = "current";
+        doc["alarm"] = currentAlarmName(axis.currentAlarm);
+        doc["motorSpeed"] = axis.motorSpeed;
+        doc["currentRms"] = axis.currentRms;
+        doc["currentPeak"] = axis.currentPeak;
+        doc["vibrationHz"] = axis.vibrationHz;
+
+        char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+        serializeJson(doc, buffer, sizeof(buffer));
+        emit(state, Config::Mqtt::TOPIC_EVENT_ALARM, buffer);
+
+        LOG_W(MqttCtrl, "Axis %d alarm: %s", i, currentAlarmName(axis.currentAlarm));
+    }
+}
+
+void MqttController::publishLoadStall(DeviceState &state, uint8_t index)
+{
+    static const char *reactions[] = {"alarm", "stop", "reverse"};
+    const AxisState &axis = state.axes[index];
+
+    JsonArena::Scope scope(arena, "loadStall");
+    JsonDocument doc(&arena);
+    Timebase::stamp(doc.to<JsonObject>());
+    doc["axis"] = index;
+    doc["source"] = "estimator";
+    doc["alarm"] = axis.loadStall ? "stall" : "none";
+    doc["reaction"] = reactions[(uint8_t)state.stallReaction];
+    doc["velocity"] = axis.velocity;
+    doc["load"] = axis.loadEstimate;
+
+    char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+    serializeJson(doc, buffer, sizeof(buffer));
+    emit(state, Config::Mqtt::TOPIC_EVENT_ALARM, buffer);
+}
+
+void MqttController::publishMemory(DeviceState &state)
+{
+    if (!mqttBroker)
+        return;
+
+    // Larger than MAX_MESSAGE_SIZE with the task table, so stream it out
+    {
+        JsonArena::Scope scope(arena, "memory");
+        JsonDocument doc(&arena);
+        MemoryMonitor::report(doc.to<JsonObject>());
+
+        auto publish = mqttBroker->begin_publish(Config::Mqtt::TOPIC_MEMORY, measureJson(doc));
+        serializeJson(doc, publish);
+        publish.send();
+    }
+
+    if (state.memoryLow == lastMemoryLow)
+        return;
+    lastMemoryLow = state.memoryLow;
+
+    JsonArena::Scope scope(arena, "memoryAlarm");
+    JsonDocument doc(&arena);
+    Timebase::stamp(doc.to<JsonObject>());
+    doc["source"] = "memory";
+    doc["alarm"] = state.memoryLow ? "low" : "none";
+    doc["heapFree"] = state.heapFree;
+    doc["heapMinFree"] = state.heapMinFree;
+    doc["heapLargestBlock"] = state.heapLargestBlock;
+    doc["minStackFree"] = state.minStackFree;
+
+    char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+    serializeJson(doc, buffer, sizeof(buffer));
+    send(Config::Mqtt::TOPIC_EVENT_ALARM, buffer);
+}
+
+void MqttController::publishEchoes(DeviceState &state)
+{
+    for (uint8_t i = 0; i < Config::Axes::COUNT; i++)
+    {
+        const AxisState &axis = state.axes[i];
+        if (axis.actuatedSeq == lastActuatedSeq[i])
+            continue;
+        lastActuatedSeq[i] = axis.actuatedSeq;
+
+        // Only tagged commands are echoed, so clients can match the reply
+        if (!Config::Latency::ECHO_ENABLED || !mqttBroker || axis.actuatedId == 0)
+            continue;
+
+        JsonArena::Scope scope(arena, "echo");
+        JsonDocument doc(&arena);
+        Timebase::stamp(doc.to<JsonObject>());
+        doc["id"] = axis.actuatedId;
+        doc["axis"] = i;
+        doc["source"] = commandSourceName(axis.commandSource);
+        doc["latencyUs"] = axis.actuatedLatencyUs;
+        doc["motorSpeed"] = axis.motorSpeed;
+
+        char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+        serializeJson(doc, buffer, sizeof(buffer));
+        send(Config::Mqtt::TOPIC_ECHO, buffer);
+    }
+}
+
+// Forwards warnings and errors from the log history, a few lines per pass
+void MqttController::publishLogs()
+{
+    if (!mqttBroker || Log::lastSeq() == lastLogSeq)
+        return;
+
+    Log::Line lines[Config::Log::MQTT_MAX_PER_UPDATE];
+    size_t n = Log::history(lastLogSeq, lines, Config::Log::MQTT_MAX_PER_UPDATE);
+    for (size_t i = 0; i < n; i++)
+    {
+        lastLogSeq = lines[i].seq;
+        if ((uint8_t)lines[i].level > (uint8_t)Config::Log::MQTT_LEVEL)
+            continue;
+
+        JsonArena::Scope scope(arena, "log");
+        JsonDocument doc(&arena);
+        Timebase::stamp(doc.to<JsonObject>(), lines[i].timeUs);
+        doc["seq"] = lines[i].seq;
+        doc["level"] = Log::levelName(lines[i].level);
+        doc["line"] = lines[i].text.c_str();
+
+        char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+        serializeJson(doc, buffer, sizeof(buffer));
+        send(Config::Mqtt::TOPIC_LOG, buffer);
+    }
 }
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/version.h>
+#include <mbedtls/sha256.h>
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/SequenceEngine.h"
+#include "../core/Timebase.h"
+
+// Streams an HTTP request body into flash in sector-aligned 4 KiB writes,
+// hashed incrementally. Only one sector is ever held in RAM: chunks are
+// gathered into it, and whole sectors that arrive aligned in one chunk go
+// from the TCP buffer to esp_ota_write / esp_partition_write directly.
+// The filesystem partition is erased sector by sector just before each write.
+class OtaUpdater
+{
+public:
+    enum class Target : uint8_t
+    {
+        Firmware,
+        Filesystem
+    };
+
+    void begin();
+    void update(DeviceState &state);
+
+    bool busy() const { return active; }
+    bool start(Target target, size_t total, const char *sha256Hex, const char *&error);
+    bool write(const uint8_t *data, size_t len, size_t index);
+    bool finish(const char *&error);
+    void abort();
+
+    // Last upload stats (and time-to-reboot of the previous one, from RTC memory)
+    size_t bytesWritten() const { return written; }
+    unsigned long uploadMs() const { return (unsigned long)(finishedAt - startedAt); }
+    uint32_t throughputKBps() const;
+    uint32_t lastRebootMs() const { return previousRebootMs; }
+    uint32_t lastThroughputKBps() const { return previousThroughputKBps; }
+
+private:
+    Target target = Target::Firmware;
+    bool active = false;
+    bool failed = false;
+    bool rebootPending = false;
+    uint64_t startedAt = 0;
+    uint64_t finishedAt = 0;
+    uint64_t rebootAt = 0;
+    size_t written = 0; // Received and hashed
+    size_t flashed = 0; // Committed to flash, a multiple of the sector size until finish()
+
+    uint8_t *sector = nullptr; // Internal RAM, only while an upload runs
+    size_t sectorFill = 0;
+
+    const esp_partition_t *partition = nullptr;
+    esp_ota_handle_t otaHandle = 0;
+
+    mbedtls_sha256_context sha;
+    uint8_t expectedSha[32];
+    bool verifySha = false;
+
+    uint32_t previousRebootMs = 0;
+    uint32_t previousThroughputKBps = 0;
+
+    static bool parseHex(const char *hex, uint8_t *out, size_t len);
+    bool flush(const uint8_t *data, size_t len);
+    void release();
+    void hashStart();
+    void hashUpdate(const uint8_t *data, size_t len);
+    void hashFinish(uint8_t *out);
+};
+
+// Survives esp_restart(); lets the next boot report how long the reboot took
+struct OtaRebootRecord
+{
+    uint32_t magic;
+    uint32_t shutdownMs; // Upload end -> esp_restart()
+    uint32_t throughputKBps;
+};
+
+static constexpr uint32_t OTA_REBOOT_MAGIC = 0x0A7A5EED;
+RTC_NOINIT_ATTR OtaRebootRecord otaRebootRecord;
+
+void OtaUpdater::begin()
+{
+    mbedtls_sha256_init(&sha);
+
+    if (otaRebootRecord.magic == OTA_REBOOT_MAGIC)
+    {
+        previousRebootMs = otaRebootRecord.shutdownMs + Timebase::nowMs();
+        previousThroughputKBps = otaRebootRecord.throughputKBps;
+        LOG_I(Ota, "Update applied: %lu KB/s upload, %lu ms to reboot",
+              (unsigned long)previousThroughputKBps, (unsigned long)previousRebootMs);
+    }
+    otaRebootRecord.magic = 0;
+}
+
+bool OtaUpdater::start(Target newTarget, size_t total, const char *sha256Hex, const char *&error)
+{
+    if (active || rebootPending)
+    {
+        error = "busy";
+        return false;
+    }
+
+    verifySha = sha256Hex && *sha256Hex;
+    if (verifySha && !parseHex(sha256Hex, expectedSha, sizeof(expectedSha)))
+    {
+        error = "invalid_sha256";
+        return false;
+    }
+
+    target = newTarget;
+    partition = target == Target::Firmware
+                    ? esp_ota_get_next_update_partition(nullptr)
+                    : esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    if (!partition)
+    {
+        error = "no_partition";
+        return false;
+    }
+
+    if (total > partition->size)
+    {
+        error = "image_too_large";
+        return false;
+    }
+
+    sector = (uint8_t *)heap_caps_malloc(SPI_FLASH_SEC_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!sector)
+    {
+        error = "no_memory";
+        return false;
+    }
+
+    if (target == Target::Firmware)
+    {
+        // Sequential mode erases sector by sector instead of the whole slot up front
+        if (esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &otaHandle) != ESP_OK)
+        {
+            release();
+            error = "ota_begin_failed";
+            return false;
+        }
+    }
+    else
+    {
+        LittleFS.end();
+    }
+
+    hashStart();
+    written = 0;
+    flashed = 0;
+    sectorFill = 0;
+    failed = false;
+    active = true;
+    startedAt = Timebase::nowMs();
+
+    LOG_I(Ota, "Upload started: %s, %u bytes -> %s",
+          target == Target::Firmware ? "firmware" : "filesystem", (unsigned)total, partition->label);
+    return true;
+}
+
+bool OtaUpdater::write(const uint8_t *data, size_t len, size_t index)
+{
+    if (!active || failed)
+        return false;
+
+    if (index != written || written + len > partition->size)
+    {
+        failed = true;
+        return false;
+    }
+
+    hashUpdate(data, len);
+    written += len;
+
+    while (len > 0)
+    {
+        const uint8_t *block = data;
+        size_t n = SPI_FLASH_SEC_SIZE;
+        if (sectorFill > 0 || len < SPI_FLASH_SEC_SIZE)
+        {
+            n = min(len, SPI_FLASH_SEC_SIZE - sectorFill);
+            memcpy(sector + sectorFill, data, n);
+            sectorFill += n;
+            block = sector;
+        }
+        data += n;
+        len -= n;
+
+        if (block == sector && sectorFill < SPI_FLASH_SEC_SIZE)
+            break;
+        sectorFill = 0;
+        if (!flush(block, SPI_FLASH_SEC_SIZE))
+        {
+            failed = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes one sector (or the tail of the image) at the flash pointer
+bool OtaUpdater::flush(const uint8_t *data, size_t len)
+{
+    esp_err_t err;
+    if (target == Target::Firmware)
+    {
+        err = esp_ota_write(otaHandle, data, len);
+    }
+    else
+    {
+        err = esp_partition_erase_range(partition, flashed, SPI_FLASH_SEC_SIZE);
+        if (err == ESP_OK)
+            err = esp_partition_write(partition, flashed, data, len);
+    }
+
+    if (err != ESP_OK)
+        return false;
+    flashed += len;
+    return true;
+}
+
+void OtaUpdater::release()
+{
+    heap_caps_free(sector);
+    sector = nullptr;
+    sectorFill = 0;
+}
+
+bool OtaUpdater::finish(const char *&error)
+{
+    if (!active)
+    {
+        error = "not_started";
+        return false;
+    }
+
+    finishedAt = Timebase::nowMs();
+
+    uint8_t digest[32];
+    hashFinish(digest);
+
+    // The tail is the only write shorter than a sector
+    if (!failed && sectorFill > 0 && !flush(sector, sectorFill))
+        failed = true;
+    release();
+
+    if (failed)
+        error = "write_failed";
+    else if (verifySha && memcmp(digest, expectedSha, sizeof(digest)) != 0)
+        error = "sha256_mismatch";
+    else
+        error = nullptr;
+
+    if (error)
+    {
+        abort();
+        return false;
+    }
+
+    if (target == Target::Firmware)
+    {
+        esp_err_t err = esp_ota_end(otaHandle);
+        otaHandle = 0;
+        if (err != ESP_OK || esp_ota_set_boot_partition(partition) != ESP_OK)
+        {
+            active = false;
+            error = "invalid_image";
+            return false;
+        }
+    }
+
+    active = false;
+    rebootPending = true;
+    rebootAt = Timebase::nowMs() + Config::Ota::REBOOT_DELAY_MS;
+
+    LOG_I(Ota, "Upload complete: %u bytes in %lu ms (%lu KB/s)",
+          (unsigned)written, uploadMs(), (unsigned long)throughputKBps());
+    return true;
+}
+
+void OtaUpdater::abort()
+{
+    if (target == Target::Firmware && otaHandle)
+        esp_ota_abort(otaHandle);
+    otaHandle = 0;
+    release();
+
+    if (active)
+    {
+        // A partial filesystem image will not mount; the upload endpoint still works for a retry
+        if (target == Target::Filesystem)
+            LittleFS.begin(false);
+        mbedtls_sha256_free(&sha);
+    }
+
+    active = false;
+    LOG_W(Ota, "Upload aborted after %u bytes", (unsigned)written);
+}
+
+uint32_t OtaUpdater::throughputKBps() const
+{
+    unsigned long ms = uploadMs();
+    return ms ? (uint32_t)(written / ms) : 0; // bytes/ms ~= KB/s
+}
+
+void OtaUpdater::update(DeviceState &state)
+{
+    state.otaActive = active;
+
+    if (!rebootPending || Timebase::nowMs() < rebootAt)
+        return;
+
+    // Bring every axis to a stop and give the control pass one loop to apply it
+    if (state.anyMotorRunning() || state.sequenceState == SequenceState::Running)
+    {
+        SequenceEngine::stop();
+        for (AxisState &axis : state.axes)
+            axis.motorSpeed = 0;
+        return;
+    }
+
+    otaRebootRecord.magic = OTA_REBOOT_MAGIC;
+    otaRebootRecord.shutdownMs = Timebase::nowMs() - finishedAt;
+    otaRebootRecord.throughputKBps = throughputKBps();
+
+    LOG_I(Ota, "Rebooting into new image");
+    Log::flush();
+    esp_restart();
+}
+
+bool OtaUpdater::parseHex(const char *hex, uint8_t *out, size_t len)
+{
+    if (strlen(hex) != len * 2)
+        return false;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+        char *end = nullptr;
+        out[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != 0)
+            return false;
+    }
+    return true;
+}
+
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+void OtaUpdater::hashStart()
+{
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+}
+void OtaUpdater::hashUpdate(const uint8_t *data, size_t len) { mbedtls_sha256_update(&sha, data, len); }
+void OtaUpdater::hashFinish(uint8_t *out)
+{
+    mbedtls_sha256_finish(&sha, out);
+    mbedtls_sha256_free(&sha);
+}
+#else
+void OtaUpdater::hashStart()
+{
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+}
+void OtaUpdater::hashUpdate(const uint8_t *data, size_t len) { mbedtls_sha256_update_ret(&sha, data, len); }
+void OtaUpdater::hashFinish(uint8_t *out)
+{
+    mbedtls_sha256_finish_ret(&sha, out);
+    mbedtls_sha256_free(&sha);
+}
+#endif
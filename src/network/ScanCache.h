@@ -0,0 +1,176 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/FixedString.h"
+#include "../core/Timebase.h"
+
+// Shared WiFi scan results. Scans are only started from the loop, never more
+// often than SCAN_MIN_INTERVAL_MS, and refreshed in the background while the
+// setup AP is up. Results are kept de-duplicated by SSID (strongest wins) and
+// sorted by RSSI, so /api/scan can answer every client from memory.
+class ScanCache
+{
+public:
+    struct Network
+    {
+        FixedString<32> ssid;
+        int8_t rssi;
+        bool secure;
+    };
+
+    void update(DeviceState &state);
+
+    // Safe from any task: asks the loop for a fresh scan if the cache is stale
+    void request();
+
+    // Copies the cached list; returns the count, or -1 if nothing was scanned yet
+    int snapshot(Network *out, size_t max, unsigned long &ageMs);
+
+private:
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    Network networks[Config::WiFi::SCAN_MAX_NETWORKS];
+    uint8_t count = 0;
+    bool valid = false;
+    uint64_t scannedAt = 0;
+
+    volatile bool requested = false;
+    bool scanning = false;
+    uint64_t lastStart = 0;
+
+    bool stale(uint64_t now) const { return !valid || now - scannedAt >= Config::WiFi::SCAN_TTL_MS; }
+    void start(uint64_t now);
+    void collect(int found);
+};
+
+void ScanCache::request()
+{
+    requested = true;
+}
+
+void ScanCache::update(DeviceState &state)
+{
+    uint64_t now = Timebase::nowMs();
+
+    if (scanning)
+    {
+        int found = WiFi.scanComplete();
+        if (found == WIFI_SCAN_RUNNING)
+            return;
+
+        scanning = false;
+        if (found >= 0)
+            collect(found);
+        WiFi.scanDelete();
+        return;
+    }
+
+    // Background refresh only while someone may be looking at the setup page
+    bool wanted = requested || state.apActive;
+    if (wanted && stale(now) && now - lastStart >= Config::WiFi::SCAN_MIN_INTERVAL_MS)
+    {
+        start(now);
+    }
+}
+
+void ScanCache::start(uint64_t now)
+{
+    lastStart = now;
+    requested = false;
+
+    // Async scan; a STA connect in progress can refuse it, the next interval retries
+    if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED)
+    {
+        LOG_W(WiFi, "Scan refused, retrying in %lu ms", Config::WiFi::SCAN_MIN_INTERVAL_MS);
+        return;
+    }
+    scanning = true;
+}
+
+void ScanCache::collect(int found)
+{
+    Network fresh[Config::WiFi::SCAN_MAX_NETWORKS];
+    uint8_t n = 0;
+
+    for (int i = 0; i < found; i++)
+    {
+        String ssid = WiFi.SSID(i);
+        if (ssid.isEmpty())
+            continue; // Hidden network
+
+        int8_t rssi = WiFi.RSSI(i);
+        bool secure = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
+
+        // Same SSID from several APs: keep the strongest
+        uint8_t at = 0;
+        while (at < n && fresh[at].ssid != ssid.c_str())
+            at++;
+
+        if (at < n)
+        {
+            if (rssi <= fresh[at].rssi)
+                continue;
+        }
+        else if (n < Config::WiFi::SCAN_MAX_NETWORKS)
+        {
+            at = n++;
+        }
+        else if (rssi > fresh[n - 1].rssi)
+        {
+            at = n - 1; // Full: replace the weakest
+        }
+        else
+        {
+            continue;
+        }
+
+        fresh[at].ssid = ssid.c_str();
+        fresh[at].rssi = rssi;
+        fresh[at].secure = secure;
+
+        // Insertion step keeps the list sorted by RSSI, strongest first
+        while (at > 0 && fresh[at].rssi > fresh[at - 1].rssi)
+        {
+            Network tmp = fresh[at];
+            fresh[at] = fresh[at - 1];
+            fresh[at - 1] = tmp;
+            at--;
+        }
+        while (at + 1 < n && fresh[at].rssi < fresh[at + 1].rssi)
+        {
+            Network tmp = fresh[at];
+            fresh[at] = fresh[at + 1];
+            fresh[at + 1] = tmp;
+            at++;
+        }
+    }
+
+    portENTER_CRITICAL(&mux);
+    memcpy(networks, fresh, n * sizeof(Network));
+    count = n;
+    valid = true;
+    scannedAt = Timebase::nowMs();
+    portEXIT_CRITICAL(&mux);
+
+    LOG_I(WiFi, "Scan: %d results, %d networks cached", found, n);
+}
+
+int ScanCache::snapshot(Network *out, size_t max, unsigned long &ageMs)
+{
+    portENTER_CRITICAL(&mux);
+    bool ok = valid;
+    size_t n = min((size_t)count, max);
+    memcpy(out, networks, n * sizeof(Network));
+    ageMs = Timebase::nowMs() - scannedAt;
+    portEXIT_CRITICAL(&mux);
+
+    if (!ok)
+        return -1;
+
+    if (ageMs >= Config::WiFi::SCAN_TTL_MS)
+        request();
+    return n;
+}
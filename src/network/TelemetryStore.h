@@ -0,0 +1,279 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+#include "../core/DeviceState.h"
+#include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/Timebase.h"
+
+// Store-and-forward backlog for telemetry and events produced while WiFi is
+// down. Records go into a PSRAM byte ring; once it is full they continue in
+// a LittleFS file, and as long as that file holds anything every new record
+// follows it there, so ring-then-file is always oldest-first. Replay runs
+// from the loop once the broker is back, paced by a token bucket so live
+// traffic keeps flowing. Payloads carry their own "ts", so replays keep the
+// original capture time. Loop task only.
+class TelemetryStore
+{
+public:
+    bool begin();
+
+    // Queues a payload for one of the buffered topics; false if it was dropped
+    bool push(const char *topic, const char *payload);
+
+    // Hands a few queued records to `publish(topic, payload)` if the pacing allows
+    template <typename Publish>
+    void replay(Publish &&publish);
+
+    bool empty() const { return records == 0; }
+
+    // Occupancy and progress into DeviceState (for /api/backlog and telemetry)
+    void report(DeviceState &state) const;
+
+private:
+    struct Header
+    {
+        uint32_t ms;   // Capture time, low 32 bits of Timebase::nowMs(); ages are wrap-safe
+        uint16_t size; // Payload bytes, WRAP marks the unused tail of the ring
+        uint8_t topic;
+        uint8_t reserved;
+    };
+
+    static constexpr uint16_t WRAP = 0xFFFF;
+    static constexpr const char *const topics[] = {Config::Mqtt::TOPIC_TELEMETRY, Config::Mqtt::TOPIC_EVENT_ALARM};
+    static constexpr uint8_t TOPIC_COUNT = sizeof(topics) / sizeof(topics[0]);
+
+    uint8_t *ring = nullptr;
+    size_t head = 0; // Next write offset
+    size_t tail = 0; // Oldest record
+    size_t used = 0; // Bytes between tail and head, wrap gaps included
+
+    uint32_t records = 0;
+    uint32_t ringRecords = 0;
+    uint32_t fileBytes = 0;
+    uint32_t fileReadOffset = 0;
+    uint32_t oldestMs = 0;
+    uint32_t dropped = 0;
+    uint32_t replayed = 0;
+
+    float tokens = 0;
+    uint64_t lastReplayMs = 0;
+    bool replaying = false;
+    char replayBuffer[Config::Telemetry::KEYFRAME_BYTES]; // replay() only
+
+    bool pushRing(const Header &header, const char *payload);
+    bool pushFile(const Header &header, const char *payload);
+    bool peek(Header &header, char *payload);
+    void pop(const Header &header);
+    void trimFile();
+};
+
+bool TelemetryStore::begin()
+{
+    ring = (uint8_t *)heap_caps_malloc(Config::Store::RING_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring)
+    {
+        LOG_E(MqttCtrl, "No PSRAM for the %u byte telemetry backlog", (unsigned)Config::Store::RING_BYTES);
+        return false;
+    }
+
+    // Anything left from before a reboot is stale against the new uptime clock
+    if (Config::Store::SPILL_ENABLED && LittleFS.exists(Config::Store::SPILL_PATH))
+        LittleFS.remove(Config::Store::SPILL_PATH);
+    return true;
+}
+
+bool TelemetryStore::push(const char *topic, const char *payload)
+{
+    uint8_t id = 0;
+    while (id < TOPIC_COUNT && strcmp(topics[id], topic) != 0)
+        id++;
+
+    size_t size = strlen(payload);
+    if (id == TOPIC_COUNT || size >= Config::Telemetry::KEYFRAME_BYTES)
+    {
+        dropped++;
+        return false;
+    }
+
+    Header header{(uint32_t)Timebase::nowMs(), (uint16_t)size, id, 0};
+
+    // Once the file is in use it takes everything, so replay order stays intact
+    bool stored = (fileBytes == 0 && pushRing(header, payload)) || pushFile(header, payload);
+    if (!stored)
+    {
+        dropped++;
+        return false;
+    }
+
+    if (records++ == 0)
+        oldestMs = header.ms;
+    return true;
+}
+
+bool TelemetryStore::pushRing(const Header &header, const char *payload)
+{
+    if (!ring)
+        return false;
+
+    size_t need = sizeof(Header) + header.size;
+    size_t tailRoom = Config::Store::RING_BYTES - head;
+    size_t wrapGap = tailRoom < need ? tailRoom : 0;
+    if (used + wrapGap + need > Config::Store::RING_BYTES)
+        return false;
+
+    if (wrapGap)
+    {
+        // Records never straddle the end; mark the gap and continue at 0
+        if (tailRoom >= sizeof(Header))
+        {
+            Header wrap{0, WRAP, 0, 0};
+            memcpy(ring + head, &wrap, sizeof(Header));
+        }
+        used += wrapGap;
+        head = 0;
+    }
+
+    memcpy(ring + head, &header, sizeof(Header));
+    memcpy(ring + head + sizeof(Header), payload, header.size);
+    head = (head + need) % Config::Store::RING_BYTES;
+    used += need;
+    ringRecords++;
+    return true;
+}
+
+bool TelemetryStore::pushFile(const Header &header, const char *payload)
+{
+    if (!Config::Store::SPILL_ENABLED || fileBytes + sizeof(Header) + header.size > Config::Store::SPILL_MAX_BYTES)
+        return false;
+
+    File file = LittleFS.open(Config::Store::SPILL_PATH, FILE_APPEND);
+    if (!file)
+        return false;
+
+    bool ok = file.write((const uint8_t *)&header, sizeof(Header)) == sizeof(Header) &&
+              file.write((const uint8_t *)payload, header.size) == header.size;
+    file.close();
+    if (!ok)
+        return false;
+
+    if (fileBytes == 0)
+        LOG_W(MqttCtrl, "Backlog ring full, spilling to %s", Config::Store::SPILL_PATH);
+    fileBytes += sizeof(Header) + header.size;
+    return true;
+}
+
+// Oldest record, ring first; payload is NUL-terminated
+bool TelemetryStore::peek(Header &header, char *payload)
+{
+    if (ringRecords > 0)
+    {
+        size_t tailRoom = Config::Store::RING_BYTES - tail;
+        if (tailRoom >= sizeof(Header))
+            memcpy(&header, ring + tail, sizeof(Header));
+        if (tailRoom < sizeof(Header) || header.size == WRAP)
+        {
+            used -= tailRoom;
+            tail = 0;
+            memcpy(&header, ring, sizeof(Header));
+        }
+        memcpy(payload, ring + tail + sizeof(Header), header.size);
+        payload[header.size] = '\0';
+        return true;
+    }
+
+    if (fileReadOffset < fileBytes)
+    {
+        File file = LittleFS.open(Config::Store::SPILL_PATH, FILE_READ);
+        bool ok = file && file.seek(fileReadOffset) &&
+                  file.read((uint8_t *)&header, sizeof(Header)) == sizeof(Header) &&
+                  header.size < Config::Telemetry::KEYFRAME_BYTES &&
+                  file.read((uint8_t *)payload, header.size) == header.size;
+        if (file)
+            file.close();
+        if (ok)
+        {
+            payload[header.size] = '\0';
+            return true;
+        }
+
+        // Unreadable spill file: give up on it rather than stall replay forever
+        LOG_E(MqttCtrl, "Backlog file unreadable at %lu, discarding", (unsigned long)fileReadOffset);
+        dropped += records - ringRecords;
+        records = ringRecords;
+        trimFile();
+    }
+    return false;
+}
+
+void TelemetryStore::pop(const Header &header)
+{
+    size_t size = sizeof(Header) + header.size;
+    if (ringRecords > 0)
+    {
+        tail = (tail + size) % Config::Store::RING_BYTES;
+        used -= size;
+        ringRecords--;
+        if (ringRecords == 0)
+            head = tail = used = 0;
+    }
+    else
+    {
+        fileReadOffset += size;
+        if (fileReadOffset >= fileBytes)
+            trimFile();
+    }
+    records--;
+}
+
+void TelemetryStore::trimFile()
+{
+    LittleFS.remove(Config::Store::SPILL_PATH);
+    fileBytes = fileReadOffset = 0;
+}
+
+template <typename Publish>
+void TelemetryStore::replay(Publish &&publish)
+{
+    uint64_t now = Timebase::nowMs();
+    tokens = min(tokens + (now - lastReplayMs) * Config::Store::REPLAY_PER_SECOND / 1000.0f, (float)Config::Store::REPLAY_BURST);
+    lastReplayMs = now;
+
+    if (records == 0)
+        return;
+
+    if (!replaying)
+    {
+        replaying = true;
+        LOG_I(MqttCtrl, "Replaying backlog: %lu records (%lu bytes on flash)", (unsigned long)records, (unsigned long)fileBytes);
+    }
+
+    Header header;
+    while (tokens >= 1 && records > 0 && peek(header, replayBuffer))
+    {
+        // Reported age trails by at most one record; saves a flash read per pass
+        oldestMs = header.ms;
+        publish(topics[header.topic], replayBuffer);
+        pop(header);
+        replayed++;
+        tokens -= 1;
+    }
+
+    if (records == 0)
+    {
+        replaying = false;
+        LOG_I(MqttCtrl, "Backlog replay done, %lu records total", (unsigned long)replayed);
+    }
+}
+
+void TelemetryStore::report(DeviceState &state) const
+{
+    state.backlogRecords = records;
+    state.backlogBytes = used + fileBytes - fileReadOffset;
+    state.backlogFlashBytes = fileBytes - fileReadOffset;
+    state.backlogOldestMs = records ? oldestMs : 0;
+    state.backlogDropped = dropped;
+    state.backlogReplayed = replayed;
+}
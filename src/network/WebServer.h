@@ -9,6 +9,21 @@
 #include <esp_task_wdt.h>
 
 #include "../core/DeviceState.h"
+#include "../core/PowerManager.h"
+#include "../core/JsonArena.h"
+#include "../core/MemoryMonitor.h"
+#include "../core/FixedString.h"
+#include "../core/LatencyTracker.h"
+#include "../core/Log.h"
+#include "../core/Trace.h"
+#include "../core/Timebase.h"
+#include "../core/SequenceEngine.h"
+#include "../core/Replay.h"
+#include "OtaUpdater.h"
+#include "MotorEndpoint.h"
+#include "ScanCache.h"
+#include "MqttBridge.h"
+#include "BrokerServer.h"
 
 class WebServer
 {
@@ -19,13 +34,51 @@ public:
 private:
     AsyncWebServer server{80};
     Preferences prefs;
+    OtaUpdater ota;
+    ScanCache scans;
+    MotorEndpoint motor;
+    JsonArena arena; // Request documents, async_tcp task only
+
+    // /api/status body is built by the loop; the version changes only with the text
+    JsonArena statusArena; // Loop task only
+    portMUX_TYPE statusMux = portMUX_INITIALIZER_UNLOCKED;
+    FixedString<Config::Web::STATUS_JSON_SIZE> statusJson;
+    uint32_t statusVersion = 1;
+    // Versions restart every boot; the nonce keeps an ETag from a previous
+    // boot from matching a different body with the same version
+    uint32_t bootNonce = 0;
+    uint64_t lastStatusBuild = 0;
+
+    // Long-poll requests waiting for the next version. Filled by async_tcp,
+    // answered by the loop through the library's weak request handle.
+    struct ParkedPoll
+    {
+        AsyncWebServerRequestPtr request;
+        uint32_t since = 0;
+        uint64_t deadline = 0; // Timebase::nowMs()
+        bool used = false;
+    };
+    ParkedPoll parked[Config::Web::MAX_PARKED_POLLS];
+
+    // Upload currently streaming into flash (compared only, never dereferenced)
+    AsyncWebServerRequest *otaRequest = nullptr;
+    const char *otaError = nullptr;
 
     void serveGz(const char *url, const char *file, const char *type);
     void setupRoutes(DeviceState &state);
+    void setupOtaRoutes();
+
+    void refreshStatus(DeviceState &state);
+    void sendStatus(AsyncWebServerRequest *request);
+    void formatTag(char *out, size_t size, uint32_t version) const;
+    bool parseTag(const char *tag, uint32_t &version) const;
+    bool parkPoll(AsyncWebServerRequest *request, uint32_t since, unsigned long waitMs);
+    void releasePolls();
 
     void sendJsonResponse(AsyncWebServerRequest *request, int code, bool ok, String error = "")
     {
-        JsonDocument doc;
+        JsonArena::Scope scope(arena, "response");
+        JsonDocument doc(&arena);
         doc["ok"] = ok;
         if (error != "")
             doc["error"] = error;
@@ -37,15 +90,20 @@ private:
 
 void WebServer::begin(DeviceState &state)
 {
+    // Keep serving the API without a filesystem so /api/ota can restore it
     if (!LittleFS.begin())
     {
-        Serial0.println("[WEB] Failed to mount LittleFS");
-        return;
+        LOG_E(Web, "Failed to mount LittleFS");
     }
     prefs.begin("wifi-cfg", false);
+    bootNonce = esp_random();
+    arena.begin("web", Config::Json::WEB_ARENA_SIZE);
+    statusArena.begin("status", Config::Json::STATUS_ARENA_SIZE);
+    refreshStatus(state);
+    ota.begin();
     setupRoutes(state);
     server.begin();
-    Serial0.println("[WEB] Server started");
+    LOG_I(Web, "Server started");
 }
 
 void WebServer::serveGz(const char *url, const char *file, const char *type)
@@ -73,48 +131,404 @@ void WebServer::setupRoutes(DeviceState &state)
         if (req->method() == HTTP_OPTIONS) { req->send(200); }
         else { req->redirect("/"); } });
 
-    server.on("/api/status", HTTP_GET, [&state](AsyncWebServerRequest *req)
+    // GET /api/status[?wait=ms&since=tag] - `since` is the ETag without quotes
+    server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            PowerManager::notifyActivity();
+            TRACE_SCOPE("web_status");
+            MemoryMonitor::Probe probe(MemoryMonitor::Module::Web);
+
+            if (req->hasParam("wait") && req->hasParam("since")) {
+                uint32_t since = 0;
+                bool sameBoot = parseTag(req->getParam("since")->value().c_str(), since);
+                unsigned long wait = strtoul(req->getParam("wait")->value().c_str(), nullptr, 10);
+                wait = min(wait, Config::Web::LONG_POLL_MAX_MS);
+
+                // A tag from an earlier boot is always stale
+                portENTER_CRITICAL(&statusMux);
+                bool unchanged = sameBoot && since == statusVersion;
+                portEXIT_CRITICAL(&statusMux);
+
+                // All slots taken: answer now and let the client fall back to polling
+                if (unchanged && wait > 0 && parkPoll(req, since, wait)) {
+                    return;
+                }
+            }
+
+            sendStatus(req); });
+
+    // Served from the scan cache; streamed straight into the response
+    server.on("/api/scan", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+        PowerManager::notifyActivity();
+        TRACE_SCOPE("web_scan");
+        MemoryMonitor::Probe probe(MemoryMonitor::Module::Web);
+
+        ScanCache::Network list[Config::WiFi::SCAN_MAX_NETWORKS];
+        unsigned long ageMs = 0;
+        int n = scans.snapshot(list, Config::WiFi::SCAN_MAX_NETWORKS, ageMs);
+
+        if (n < 0) {
+            scans.request();
+            AsyncWebServerResponse *response = req->beginResponse(202, "application/json", "{\"status\":\"scanning\"}");
+            response->addHeader("Retry-After", "2");
+            req->send(response);
+            return;
+        }
+
+        AsyncResponseStream *response = req->beginResponseStream("application/json");
+        response->printf("{\"ageMs\":%lu,\"networks\":[", ageMs);
+        for (int i = 0; i < n; i++) {
+            response->print(i ? ",{\"ssid\":" : "{\"ssid\":");
+            Fmt::jsonString(*response, list[i].ssid.c_str());
+            response->printf(",\"rssi\":%d,\"secure\":%s}", list[i].rssi, list[i].secure ? "true" : "false");
+        }
+        response->print("]}");
+        req->send(response); });
+
+    setupOtaRoutes();
+
+    server.on("/api/memory", HTTP_GET, [this](AsyncWebServerRequest *req)
               {
-            JsonDocument doc;
-            doc["connected"] = (WiFi.status() == WL_CONNECTED);
-            doc["ip"] = WiFi.localIP().toString();
-            doc["savedSsid"] = state.savedSsid;
-                        
+            JsonArena::Scope scope(arena, "memory");
+            JsonDocument doc(&arena);
+            MemoryMonitor::report(doc.to<JsonObject>());
+
             AsyncResponseStream *response = req->beginResponseStream("application/json");
             serializeJson(doc, *response);
             req->send(response); });
 
-    server.on("/api/scan", HTTP_GET, [](AsyncWebServerRequest *req)
+    server.on("/api/backlog", HTTP_GET, [this, &state](AsyncWebServerRequest *req)
               {
-        int n = WiFi.scanComplete();
-        if (n == -2) { 
-            if (WiFi.status() != WL_CONNECTED) {
-            WiFi.disconnect(); 
+            JsonArena::Scope scope(arena, "backlog");
+            JsonDocument doc(&arena);
+            doc["records"] = state.backlogRecords;
+            doc["bytes"] = state.backlogBytes;
+            doc["flashBytes"] = state.backlogFlashBytes;
+            doc["capacityBytes"] = Config::Store::RING_BYTES + (Config::Store::SPILL_ENABLED ? Config::Store::SPILL_MAX_BYTES : 0);
+            doc["oldestAgeMs"] = state.backlogRecords ? (uint32_t)Timebase::nowMs() - state.backlogOldestMs : 0;
+            doc["replayed"] = state.backlogReplayed;
+            doc["dropped"] = state.backlogDropped;
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    server.on("/api/time", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "time");
+            JsonDocument doc(&arena);
+            Timebase::report(doc.to<JsonObject>());
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    server.on("/api/sequence", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "sequence");
+            JsonDocument doc(&arena);
+            SequenceEngine::report(doc.to<JsonObject>());
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    // Same payloads as hub/cmd/sequence; uploads may span several body chunks
+    server.on("/api/sequence", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            PowerManager::notifyActivity();
+            TRACE_SCOPE("web_sequence");
+
+            if (total > Config::Sequence::MAX_UPLOAD_BYTES) {
+                if (index == 0) {
+                    sendJsonResponse(request, 413, false, "too_large");
+                }
+                return;
+            }
+
+            const uint8_t *body = data;
+            if (len < total) {
+                // Freed with the request
+                if (index == 0) {
+                    request->_tempObject = heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                    if (!request->_tempObject) {
+                        sendJsonResponse(request, 500, false, "no_memory");
+                        return;
+                    }
+                }
+                uint8_t *buffer = (uint8_t *)request->_tempObject;
+                if (!buffer) {
+                    return;
+                }
+                memcpy(buffer + index, data, len);
+                if (index + len < total) {
+                    return;
+                }
+                body = buffer;
             }
 
-            WiFi.scanNetworks(true); 
-            req->send(202, "application/json", "{\"status\":\"started\"}");
-        } else if (n == -1) {
-            req->send(202, "application/json", "{\"status\":\"scanning\"}");
-        } else {
+            JsonArena::Scope scope(arena, "sequence");
+            JsonDocument doc(&arena);
+            if (deserializeJson(doc, body, total)) {
+                sendJsonResponse(request, 400, false, "invalid_json");
+                return;
+            }
+
+            const char *error = nullptr;
+            if (SequenceEngine::handle(doc.as<JsonVariantConst>(), error)) {
+                sendJsonResponse(request, 200, true);
+            } else {
+                sendJsonResponse(request, strcmp(error, "busy") == 0 ? 409 : 400, false, error);
+            } });
+
+    server.on("/api/broker", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "broker");
+            JsonDocument doc(&arena);
+            BrokerServer::report(doc.to<JsonObject>());
+
             AsyncResponseStream *response = req->beginResponseStream("application/json");
-            JsonDocument doc; 
-            JsonArray arr = doc["networks"].to<JsonArray>(); 
+            serializeJson(doc, *response);
+            req->send(response); });
 
-            for (int i = 0; i < n; i++) {
-                JsonObject net = arr.add<JsonObject>(); 
-                net["ssid"] = WiFi.SSID(i);
-                net["rssi"] = WiFi.RSSI(i);
-                net["secure"] = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
+    server.on("/api/bridge", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "bridge");
+            JsonDocument doc(&arena);
+            MqttBridge::report(doc.to<JsonObject>());
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    server.on("/api/latency", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "latency");
+            JsonDocument doc(&arena);
+            LatencyTracker::report(doc.to<JsonObject>());
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    // Jog commands, JSON or 8-byte binary frames (network/MotorEndpoint.h);
+    // binary requests are answered with an empty 204 to keep the round trip short
+    server.on("/api/motor", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+            if (!request->contentLength()) {
+                motor.reject(MotorEndpoint::Result::Invalid);
+                sendJsonResponse(request, 400, false, "empty_body");
+            } }, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            TRACE_SCOPE("web_motor");
+            bool binary = request->contentType() == "application/octet-stream";
+
+            if (index == 0) {
+                PowerManager::notifyActivity();
+                if (!motor.admit(request->client()->getRemoteAddress(), micros())) {
+                    sendJsonResponse(request, 429, false, "rate_limited");
+                    return;
+                }
+                size_t limit = binary ? Config::HttpMotor::FRAME_BYTES * Config::Axes::COUNT : Config::HttpMotor::MAX_JSON_BYTES;
+                if (total > limit) {
+                    motor.reject(MotorEndpoint::Result::TooLarge);
+                    sendJsonResponse(request, 413, false, "too_large");
+                    return;
+                }
+            }
+
+            const uint8_t *body = data;
+            if (len < total) {
+                // Split bodies are rare at this size; freed with the request
+                if (index == 0) {
+                    request->_tempObject = malloc(total);
+                    if (!request->_tempObject) {
+                        sendJsonResponse(request, 500, false, "no_memory");
+                        return;
+                    }
+                }
+                uint8_t *buffer = (uint8_t *)request->_tempObject;
+                if (!buffer) {
+                    return;
+                }
+                memcpy(buffer + index, data, len);
+                if (index + len < total) {
+                    return;
+                }
+                body = buffer;
             }
+
+            MotorEndpoint::Result result = motor.handle(body, total, binary, micros(), arena);
+            if (result == MotorEndpoint::Result::Accepted) {
+                if (binary) {
+                    request->send(204);
+                } else {
+                    sendJsonResponse(request, 202, true);
+                }
+            } else {
+                sendJsonResponse(request, result == MotorEndpoint::Result::Replaying ? 409 : 400, false, MotorEndpoint::resultName(result));
+            } });
+
+    server.on("/api/motor", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "motor");
+            JsonDocument doc(&arena);
+            motor.report(doc.to<JsonObject>());
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
             serializeJson(doc, *response);
-            req->send(response);
-            WiFi.scanDelete(); 
-        } });
+            req->send(response); });
+
+    server.on("/api/log", HTTP_GET, [](AsyncWebServerRequest *req)
+              {
+            uint32_t since = req->hasParam("since") ? req->getParam("since")->value().toInt() : 0;
+            Log::Stats stats = Log::stats();
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            response->printf("{\"written\":%lu,\"dropped\":%lu,\"truncated\":%lu,\"lines\":[",
+                             (unsigned long)stats.written, (unsigned long)stats.dropped, (unsigned long)stats.truncated);
+
+            // Small batches keep the copy off the async_tcp stack
+            Log::Line lines[8];
+            bool first = true;
+            size_t n;
+            while ((n = Log::history(since, lines, 8)) > 0) {
+                for (size_t i = 0; i < n; i++) {
+                    response->printf("%s{\"seq\":%lu,\"us\":%lld,\"utc\":%lld,\"level\":\"%s\",\"line\":", first ? "" : ",",
+                                     (unsigned long)lines[i].seq, (long long)lines[i].timeUs,
+                                     (long long)(Timebase::wallUs(lines[i].timeUs) / 1000), Log::levelName(lines[i].level));
+                    Fmt::jsonString(*response, lines[i].text.c_str());
+                    response->print("}");
+                    first = false;
+                }
+                since = lines[n - 1].seq;
+            }
+            response->print("]}");
+            req->send(response); });
+
+    // POST /api/trace?ms=N arms a capture; GET downloads the last one (tools/trace_to_chrome.py)
+    server.on("/api/trace", HTTP_POST, [this](AsyncWebServerRequest *req)
+              {
+            if (Trace::busy()) {
+                sendJsonResponse(req, 409, false, "recording");
+                return;
+            }
+            uint32_t ms = req->hasParam("ms") ? req->getParam("ms")->value().toInt() : Config::Trace::DEFAULT_DURATION_MS;
+            Trace::request(ms);
+            sendJsonResponse(req, 202, true); });
+
+    server.on("/api/trace", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            if (Trace::busy()) {
+                AsyncResponseStream *response = req->beginResponseStream("application/json");
+                response->setCode(409);
+                response->printf("{\"status\":\"recording\",\"events\":%lu}", (unsigned long)Trace::eventCount());
+                req->send(response);
+                return;
+            }
+
+            size_t size = Trace::exportSize();
+            if (!size) {
+                sendJsonResponse(req, 404, false, "no_trace");
+                return;
+            }
+
+            AsyncWebServerResponse *response = req->beginResponse("application/octet-stream", size,
+                [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t { return Trace::read(buffer, maxLen, index); });
+            response->addHeader("Content-Disposition", "attachment; filename=trace.bin");
+            req->send(response); });
+
+    // Record/replay files (tools/replay_tool.py). Registered before
+    // /api/replay, which would otherwise match these paths as a prefix
+    for (bool output : {false, true})
+    {
+        server.on(output ? "/api/replay/output" : "/api/replay/input", HTTP_GET, [this, output](AsyncWebServerRequest *req)
+                  {
+                size_t size = Replay::exportSize(output);
+                if (!size) {
+                    sendJsonResponse(req, Replay::busy() ? 409 : 404, false, Replay::busy() ? "busy" : "empty");
+                    return;
+                }
+
+                AsyncWebServerResponse *response = req->beginResponse("application/octet-stream", size,
+                    [output](uint8_t *buffer, size_t maxLen, size_t index) -> size_t { return Replay::read(output, buffer, maxLen, index); });
+                response->addHeader("Content-Disposition", output ? "attachment; filename=replay-output.bin" : "attachment; filename=replay-input.bin");
+                req->send(response); });
+    }
+
+    // Input for the next replay; the body is written straight into the PSRAM buffer
+    server.on("/api/replay/input", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            if (index == 0) {
+                // A dropped connection must not leave the buffer claimed;
+                // only the owning request's disconnect releases it
+                request->onDisconnect([request] { Replay::cancelUpload(request); });
+            }
+
+            const char *error = nullptr;
+            bool ok = Replay::upload(request, data, len, index, total, error);
+            if (!ok && error) {
+                sendJsonResponse(request, strcmp(error, "busy") == 0 ? 409 : 400, false, error);
+            } else if (ok && index + len == total) {
+                sendJsonResponse(request, 200, true);
+            } });
+
+    server.on("/api/replay", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "replay");
+            JsonDocument doc(&arena);
+            Replay::report(doc.to<JsonObject>());
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    // POST /api/replay?action=record&ms=N | play&speed=N | stop
+    server.on("/api/replay", HTTP_POST, [this](AsyncWebServerRequest *req)
+              {
+            String action = req->hasParam("action") ? req->getParam("action")->value() : "";
+            bool ok;
+            if (action == "record") {
+                uint32_t ms = req->hasParam("ms") ? req->getParam("ms")->value().toInt() : Config::Replay::DEFAULT_DURATION_MS;
+                ok = Replay::requestRecord(ms);
+            } else if (action == "play") {
+                uint8_t speed = req->hasParam("speed") ? req->getParam("speed")->value().toInt() : 1;
+                ok = Replay::requestReplay(speed);
+            } else if (action == "stop") {
+                Replay::requestStop();
+                ok = true;
+            } else {
+                sendJsonResponse(req, 400, false, "unknown_action");
+                return;
+            }
+
+            if (ok) {
+                sendJsonResponse(req, 202, true);
+            } else {
+                sendJsonResponse(req, 409, false, Replay::busy() ? "busy" : "no_input");
+            } });
+
+    server.on("/api/arenas", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "arenas");
+            JsonDocument doc(&arena);
+            JsonArray list = doc.to<JsonArray>();
+            for (uint8_t i = 0; i < JsonArena::count(); i++) {
+                JsonArena::all()[i]->report(list.add<JsonObject>());
+            }
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
 
     server.on("/api/save", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
               {
-            JsonDocument doc;
+            PowerManager::notifyActivity();
+            TRACE_SCOPE("web_save");
+            MemoryMonitor::Probe probe(MemoryMonitor::Module::Web);
+            JsonArena::Scope scope(arena, "save");
+            JsonDocument doc(&arena);
             DeserializationError error = deserializeJson(doc, data, len);
 
             if (error) {
@@ -133,6 +547,12 @@ void WebServer::setupRoutes(DeviceState &state)
             prefs.putString("ssid", ssid);
             prefs.putString("pass", pass);
 
+            // Optional upstream broker and NTP server; empty turns them off
+            if (doc["bridgeHost"].is<const char *>())
+                prefs.putString("bridge_host", doc["bridgeHost"].as<const char *>());
+            if (doc["ntpServer"].is<const char *>())
+                prefs.putString("ntp_server", doc["ntpServer"].as<const char *>());
+
             sendJsonResponse(request, 200, true);
 
             xTaskCreate([](void *) {
@@ -141,4 +561,228 @@ void WebServer::setupRoutes(DeviceState &state)
             }, "reboot", 2048, nullptr, 1, nullptr); });
 }
 
-void WebServer::update(DeviceState &state) {}
\ No newline at end of file
+void WebServer::setupOtaRoutes()
+{
+    server.on("/api/ota", HTTP_GET, [this](AsyncWebServerRequest *req)
+              {
+            JsonArena::Scope scope(arena, "ota");
+            JsonDocument doc(&arena);
+            doc["busy"] = ota.busy();
+            doc["lastRebootMs"] = ota.lastRebootMs();
+            doc["lastThroughputKBps"] = ota.lastThroughputKBps();
+
+            AsyncResponseStream *response = req->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            req->send(response); });
+
+    // POST raw image body: /api/ota?target=firmware|fs&sha256=<hex>
+    server.on("/api/ota", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+            if (request != otaRequest) {
+                sendJsonResponse(request, request->contentLength() ? 409 : 400, false, request->contentLength() ? "busy" : "empty_body");
+                return;
+            }
+
+            if (!otaError) {
+                ota.finish(otaError);
+            } else if (ota.busy()) {
+                ota.abort();
+            }
+            otaRequest = nullptr;
+
+            if (otaError) {
+                sendJsonResponse(request, 400, false, otaError);
+                return;
+            }
+
+            JsonArena::Scope scope(arena, "ota");
+            JsonDocument doc(&arena);
+            doc["ok"] = true;
+            doc["bytes"] = ota.bytesWritten();
+            doc["uploadMs"] = ota.uploadMs();
+            doc["throughputKBps"] = ota.throughputKBps();
+            doc["rebootInMs"] = Config::Ota::REBOOT_DELAY_MS;
+
+            AsyncResponseStream *response = request->beginResponseStream("application/json");
+            serializeJson(doc, *response);
+            request->send(response); }, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            PowerManager::notifyActivity();
+            TRACE_SCOPE("web_ota");
+
+            if (index == 0) {
+                if (otaRequest) {
+                    return; // Another upload owns the flash; answered with 409
+                }
+                otaRequest = request;
+                otaError = nullptr;
+
+                // Registered before start(): a failed start or a dropped
+                // connection must not leave the upload slot claimed
+                request->onDisconnect([this, request]() {
+                    if (otaRequest == request) {
+                        if (ota.busy()) {
+                            ota.abort();
+                        }
+                        otaRequest = nullptr;
+                    }
+                });
+
+                bool fs = request->hasParam("target") && request->getParam("target")->value() == "fs";
+                String sha = request->hasParam("sha256") ? request->getParam("sha256")->value() : request->header("X-SHA256");
+                if (!ota.start(fs ? OtaUpdater::Target::Filesystem : OtaUpdater::Target::Firmware, total, sha.c_str(), otaError)) {
+                    return;
+                }
+            }
+
+            if (request != otaRequest || otaError) {
+                return;
+            }
+
+            // Gathered into sector-aligned flash writes; no image buffer
+            if (!ota.write(data, len, index)) {
+                otaError = "write_failed";
+                ota.abort();
+            } });
+}
+
+void WebServer::refreshStatus(DeviceState &state)
+{
+    FixedString<Config::Web::STATUS_JSON_SIZE> json;
+    {
+        JsonArena::Scope scope(statusArena, "status");
+        JsonDocument doc(&statusArena);
+        doc["connected"] = state.wifiConnected;
+        doc["ip"] = Fmt::ip(state.localIP).c_str();
+        doc["savedSsid"] = state.savedSsid.c_str();
+        doc["powerIdle"] = state.powerIdle;
+        doc["avgCurrentMa"] = state.avgCurrentMa;
+        doc["wakeLatencyUs"] = state.wakeLatencyUs;
+        doc["heapFree"] = state.heapFree & ~1023u; // KB steps, so heap churn alone is not a change
+        doc["memoryLow"] = state.memoryLow;
+        doc["backlog"] = state.backlogRecords;
+
+        char buffer[Config::Web::STATUS_JSON_SIZE + 1];
+        serializeJson(doc, buffer, sizeof(buffer));
+        json = buffer;
+    }
+
+    portENTER_CRITICAL(&statusMux);
+    if (json != statusJson)
+    {
+        statusJson = json;
+        statusVersion++;
+    }
+    portEXIT_CRITICAL(&statusMux);
+}
+
+void WebServer::sendStatus(AsyncWebServerRequest *request)
+{
+    portENTER_CRITICAL(&statusMux);
+    FixedString<Config::Web::STATUS_JSON_SIZE> json = statusJson;
+    uint32_t version = statusVersion;
+    portEXIT_CRITICAL(&statusMux);
+
+    char etag[24];
+    formatTag(etag, sizeof(etag), version);
+
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag)
+    {
+        response = request->beginResponse(304);
+    }
+    else
+    {
+        response = request->beginResponse(200, "application/json", json.c_str());
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+// "<boot nonce, hex>-<version>", quoted as an ETag
+void WebServer::formatTag(char *out, size_t size, uint32_t version) const
+{
+    snprintf(out, size, "\"%08lx-%lu\"", (unsigned long)bootNonce, (unsigned long)version);
+}
+
+// Accepts the tag with or without quotes; false if it is not from this boot
+bool WebServer::parseTag(const char *tag, uint32_t &version) const
+{
+    if (*tag == '"')
+        tag++;
+    char *end;
+    uint32_t nonce = strtoul(tag, &end, 16);
+    if (end == tag || *end != '-' || nonce != bootNonce)
+        return false;
+    version = strtoul(end + 1, nullptr, 10);
+    return true;
+}
+
+bool WebServer::parkPoll(AsyncWebServerRequest *request, uint32_t since, unsigned long waitMs)
+{
+    // Only async_tcp fills slots and only the loop frees them, so a free slot stays free
+    ParkedPoll *slot = nullptr;
+    portENTER_CRITICAL(&statusMux);
+    for (ParkedPoll &p : parked)
+    {
+        if (!p.used)
+        {
+            slot = &p;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&statusMux);
+
+    if (!slot)
+        return false;
+
+    AsyncWebServerRequestPtr handle = request->pause();
+
+    portENTER_CRITICAL(&statusMux);
+    slot->request = handle;
+    slot->since = since;
+    slot->deadline = Timebase::nowMs() + waitMs;
+    slot->used = true;
+    portEXIT_CRITICAL(&statusMux);
+    return true;
+}
+
+void WebServer::releasePolls()
+{
+    uint64_t now = Timebase::nowMs();
+
+    for (ParkedPoll &p : parked)
+    {
+        AsyncWebServerRequestPtr handle;
+
+        portENTER_CRITICAL(&statusMux);
+        if (p.used && (p.since != statusVersion || now >= p.deadline))
+        {
+            handle = p.request;
+            p.request.reset();
+            p.used = false;
+        }
+        portEXIT_CRITICAL(&statusMux);
+
+        // Expired handle: the client went away while parked
+        if (auto request = handle.lock())
+        {
+            sendStatus(request.get());
+        }
+    }
+}
+
+void WebServer::update(DeviceState &state)
+{
+    ota.update(state);
+    scans.update(state);
+
+    uint64_t now = Timebase::nowMs();
+    if (now - lastStatusBuild >= Config::Web::STATUS_REFRESH_MS)
+    {
+        lastStatusBuild = now;
+        refreshStatus(state);
+    }
+    releasePolls();
+}
\ No newline at end of file
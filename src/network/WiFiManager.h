@@ -5,6 +5,9 @@
 #include <Preferences.h>
 #include "../core/DeviceState.h"
 #include "../core/Config.h"
+#include "../core/Log.h"
+#include "../core/FixedString.h"
+#include "../core/Timebase.h"
 
 class WiFiManager
 {
@@ -16,41 +19,56 @@ public:
 
 private:
     Preferences prefs;
+
+    // Loaded once; /api/save reboots the device after storing new credentials
+    FixedString<32> savedSsid;
+    FixedString<64> savedPass;
     bool setupModeActive = false;
     bool apEnabled = false;
-    unsigned long setupModeStartTime = 0;
-    unsigned long lastActivityTime = 0;
+    uint64_t setupModeStartTime = 0;
+    uint64_t lastActivityTime = 0;
 
     // Reconnection logic
-    unsigned long connectStartTime = 0;
-    unsigned long lastReconnectAttempt = 0;
+    uint64_t connectStartTime = 0;
+    uint64_t lastReconnectAttempt = 0;
     bool isReconnectPending = false;
 
     void startAP();
     void stopAP();
-    void connectSTA(const String &ssid, const String &pass);
+    void connectSTA(const char *ssid, const char *pass);
     void checkActivityTimeout();
-    void handleReconnect(const String &ssid, const String &pass);
 };
 
 void WiFiManager::begin(DeviceState &state)
 {
     prefs.begin("wifi-cfg", false);
 
-    String ssid = prefs.getString("ssid", "");
-    String pass = prefs.getString("pass", "");
-    state.savedSsid = ssid;
+    char ssid[33] = "";
+    char pass[65] = "";
+    prefs.getString("ssid", ssid, sizeof(ssid));
+    prefs.getString("pass", pass, sizeof(pass));
+    savedSsid = ssid;
+    savedPass = pass;
+    state.savedSsid = savedSsid;
 
     WiFi.mode(WIFI_STA);
     WiFi.setSleep(false);
 
-    connectSTA(ssid, pass);
+    connectSTA(savedSsid.c_str(), savedPass.c_str());
 }
 
 void WiFiManager::update(DeviceState &state)
 {
     wl_status_t st = WiFi.status();
     state.wifiConnected = (st == WL_CONNECTED);
+    state.apActive = apEnabled;
+    state.localIP = apEnabled ? WiFi.softAPIP() : WiFi.localIP();
+
+    if (state.setupModeRequested)
+    {
+        state.setupModeRequested = false;
+        enableSetupMode();
+    }
 
     if (!setupModeActive)
     {
@@ -67,27 +85,27 @@ void WiFiManager::update(DeviceState &state)
             if (isReconnectPending)
             {
                 // Waiting to retry - check if delay passed
-                if (millis() - lastReconnectAttempt >= Config::WiFi::RECONNECT_DELAY_MS)
+                if (Timebase::nowMs() - lastReconnectAttempt >= Config::WiFi::RECONNECT_DELAY_MS)
                 {
-                    Serial0.printf("%s Retrying connection...\n", Config::Debug::LOG_WIFI);
+                    LOG_D(WiFi, "Retrying connection...");
                     isReconnectPending = false;
-                    connectStartTime = millis();
-                    connectSTA(state.savedSsid, prefs.getString("pass", ""));
+                    connectStartTime = Timebase::nowMs();
+                    connectSTA(savedSsid.c_str(), savedPass.c_str());
                 }
             }
             else if (connectStartTime == 0)
             {
                 // Not trying yet - start now
-                connectStartTime = millis();
-                connectSTA(state.savedSsid, prefs.getString("pass", ""));
+                connectStartTime = Timebase::nowMs();
+                connectSTA(savedSsid.c_str(), savedPass.c_str());
             }
-            else if (millis() - connectStartTime > Config::WiFi::CONNECT_TIMEOUT_MS)
+            else if (Timebase::nowMs() - connectStartTime > Config::WiFi::CONNECT_TIMEOUT_MS)
             {
                 // Timeout - disconnect and schedule retry
-                Serial0.printf("%s Connect timeout. Will retry in %d seconds...\n", Config::Debug::LOG_WIFI, Config::WiFi::RECONNECT_DELAY_MS / 1000);
+                LOG_W(WiFi, "Connect timeout. Will retry in %d seconds...", Config::WiFi::RECONNECT_DELAY_MS / 1000);
                 WiFi.disconnect();
                 isReconnectPending = true;
-                lastReconnectAttempt = millis();
+                lastReconnectAttempt = Timebase::nowMs();
                 connectStartTime = 0;
             }
         }
@@ -104,33 +122,31 @@ void WiFiManager::enableSetupMode()
     if (!setupModeActive)
     {
         setupModeActive = true;
-        setupModeStartTime = millis();
-        lastActivityTime = millis();
+        setupModeStartTime = Timebase::nowMs();
+        lastActivityTime = Timebase::nowMs();
         startAP();
-        Serial0.printf("%s Setup mode enabled (AP active for %d minutes)\n", Config::Debug::LOG_WIFI, Config::WiFi::SETUP_MODE_TIMEOUT_MS / 60000);
+        LOG_I(WiFi, "Setup mode enabled (AP active for %d minutes)", Config::WiFi::SETUP_MODE_TIMEOUT_MS / 60000);
     }
     else
     {
         // Reset activity timer on button press
-        lastActivityTime = millis();
-        Serial0.printf("%s Activity detected, resetting timeout\n", Config::Debug::LOG_WIFI);
+        lastActivityTime = Timebase::nowMs();
+        LOG_D(WiFi, "Activity detected, resetting timeout");
     }
 }
 
 void WiFiManager::checkActivityTimeout()
 {
-    if (setupModeActive && millis() - lastActivityTime > Config::WiFi::SETUP_MODE_TIMEOUT_MS)
+    if (setupModeActive && Timebase::nowMs() - lastActivityTime > Config::WiFi::SETUP_MODE_TIMEOUT_MS)
     {
-        Serial0.printf("%s Setup mode timeout - disabling AP\n", Config::Debug::LOG_WIFI);
+        LOG_I(WiFi, "Setup mode timeout - disabling AP");
         stopAP();
         setupModeActive = false;
 
         // Try to reconnect to saved WiFi if exists
-        String ssid = prefs.getString("ssid", "");
-        String pass = prefs.getString("pass", "");
-        if (!ssid.isEmpty())
+        if (!savedSsid.isEmpty())
         {
-            connectSTA(ssid, pass);
+            connectSTA(savedSsid.c_str(), savedPass.c_str());
         }
     }
 }
@@ -144,7 +160,7 @@ void WiFiManager::startAP()
     if (WiFi.softAP(Config::WiFi::AP_SSID, Config::WiFi::AP_PASSWORD, Config::WiFi::AP_CHANNEL, 0, Config::WiFi::AP_MAX_CONNECTIONS))
     {
         apEnabled = true;
-        Serial0.printf("%s AP started: 192.168.4.1\n", Config::Debug::LOG_WIFI);
+        LOG_I(WiFi, "AP started: 192.168.4.1");
     }
 }
 
@@ -152,21 +168,20 @@ void WiFiManager::stopAP()
 {
     WiFi.softAPdisconnect(true);
     apEnabled = false;
-    Serial0.printf("%s AP stopped\n", Config::Debug::LOG_WIFI);
+    LOG_I(WiFi, "AP stopped");
 
     // Switch back to STA mode only
     WiFi.mode(WIFI_STA);
 }
 
-void WiFiManager::connectSTA(const String &ssid, const String &pass)
+void WiFiManager::connectSTA(const char *ssid, const char *pass)
 {
-    if (ssid.isEmpty())
+    if (!*ssid)
         return;
 
-    Serial0.printf("%s Connecting to ", Config::Debug::LOG_WIFI);
-    Serial0.println(ssid);
+    LOG_I(WiFi, "Connecting to %s", ssid);
 
     WiFi.disconnect();
 
-    WiFi.begin(ssid.c_str(), pass.c_str());
+    WiFi.begin(ssid, pass);
 }
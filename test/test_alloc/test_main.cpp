@@ -0,0 +1,305 @@
+// Heap call counting (core/AllocCounter.h) and the loop-path helpers that
+// must not allocate. On the target the calls come from the linker wraps of
+// malloc/calloc/realloc; here the test replaces the allocator itself.
+// The last tests repeat, step for step, the per-pass JSON and text work of
+// MqttController::publishDelta/publishTelemetry, WebServer::refreshStatus
+// and Display, whose own classes need the network and TFT libraries.
+#include <unity.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include "core/Config.h"
+#include "core/AllocCounter.h"
+#include "core/ChangeTracker.h"
+#include "core/Dsp.h"
+#include "core/FixedString.h"
+#include "core/JsonArena.h"
+#include "core/LoadEstimator.h"
+#include "core/Timebase.h"
+
+#ifdef __GLIBC__
+// glibc lets a program interpose malloc; operator new goes through it too
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    void *malloc(size_t size)
+    {
+        AllocCounter::count();
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        AllocCounter::count();
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        AllocCounter::count();
+        return __libc_realloc(ptr, size);
+    }
+}
+#else
+void *operator new(size_t size)
+{
+    AllocCounter::count();
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+#endif
+
+void setUp() {}
+void tearDown() {}
+
+// Keeps the optimizer from dropping the allocation under test
+static volatile size_t sink;
+
+void test_transient_allocation_is_counted()
+{
+    uint32_t before = AllocCounter::calls();
+    {
+        std::string text(200, 'x');
+        sink = text.size();
+    }
+    // Freed again, so a free-size delta would read zero
+    TEST_ASSERT_TRUE(AllocCounter::calls() > before);
+}
+
+void test_other_threads_are_not_counted()
+{
+    constexpr uint32_t ALLOCATIONS = 100;
+    uint32_t workerCalls = 0;
+    uint32_t before = AllocCounter::calls();
+    std::thread worker([&workerCalls] {
+        uint32_t start = AllocCounter::calls();
+        for (uint32_t i = 0; i < ALLOCATIONS; i++)
+        {
+            std::string text(200, 'x');
+            sink = text.size();
+        }
+        workerCalls = AllocCounter::calls() - start;
+    });
+    worker.join();
+
+    // Starting the thread may allocate here, the worker's strings may not
+    TEST_ASSERT_TRUE(workerCalls >= ALLOCATIONS);
+    TEST_ASSERT_TRUE(AllocCounter::calls() - before < ALLOCATIONS);
+}
+
+void test_fixed_string_never_allocates()
+{
+    FixedString<32> text;
+    uint32_t before = AllocCounter::calls();
+    for (int i = 0; i < 1000; i++)
+    {
+        text = "axis";
+        text += " 0 ";
+        text.format("%s %d rpm %.1f A", "axis", i, i * 0.01);
+        FixedString<24> cut = Fmt::ellipsize<24>("a long station name that does not fit", 20);
+        FixedString<16> uptime = Fmt::duration(i * 37UL);
+        sink = text.length() + cut.length() + uptime.length();
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, AllocCounter::calls());
+}
+
+void test_load_estimator_never_allocates()
+{
+    LoadEstimator estimator;
+    estimator.reset();
+    uint32_t before = AllocCounter::calls();
+    for (uint32_t i = 1; i <= 5000; i++)
+        estimator.update(500, i * 5, Config::Stall::NO_LOAD_CURRENT_ADC, i * 1000);
+    TEST_ASSERT_EQUAL_UINT32(before, AllocCounter::calls());
+}
+
+void test_block_analysis_never_allocates()
+{
+    constexpr size_t N = Config::Analysis::BLOCK_SIZE;
+    static float samples[N], centered[N], window[N], work[2 * N];
+    Dsp::hannWindow(window, N);
+    for (size_t i = 0; i < N; i++)
+        samples[i] = 2048 + 200 * sinf(2.0f * (float)M_PI * 125 * i / Config::Analysis::SAMPLE_RATE_HZ);
+
+    uint32_t before = AllocCounter::calls();
+    for (int i = 0; i < 100; i++)
+    {
+        Dsp::statsReference(samples, centered, N);
+        Dsp::loadWindowed(centered, window, work, N);
+        Dsp::fftReference(work, N);
+        Dsp::Spectrum sp = Dsp::summarize(work, N, Config::Analysis::SAMPLE_RATE_HZ,
+                                          Config::Analysis::VIBRATION_BAND_LOW_HZ, Config::Analysis::VIBRATION_BAND_HIGH_HZ);
+        sink = (size_t)sp.dominantHz;
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, AllocCounter::calls());
+}
+
+// Moves every reported field, so each pass has a delta to write
+static void churn(DeviceState &state, int i)
+{
+    for (uint8_t a = 0; a < Config::Axes::COUNT; a++)
+    {
+        AxisState &axis = state.axes[a];
+        axis.encoderPos += 1000 + i;
+        axis.motorSpeed = (i * 37 + a * 100) % 1000 - 500;
+        axis.currentAdc = 1000 + (i * 13) % 800;
+        axis.currentRms = 100 + (i % 50) * 3.5f;
+        axis.currentPeak = axis.currentRms * 1.4f;
+        axis.vibrationHz = 50 + (i % 7) * 20;
+        axis.velocity = axis.motorSpeed * 12.5f;
+        axis.loadEstimate = (i % 100) / 100.0f;
+        axis.loadStall = i % 9 == 0;
+        axis.currentAlarm = i % 9 == 0 ? CurrentAlarm::Stall : CurrentAlarm::None;
+    }
+    state.wifiConnected = i % 2;
+    state.mqttConnected = i % 3 != 0;
+    state.heapFree = 120000 + i * 1024;
+    state.backlogRecords = i % 20;
+}
+
+static JsonArena &mqttArena()
+{
+    static JsonArena arena;
+    if (!arena.capacity())
+        arena.begin("mqtt", Config::Json::MQTT_ARENA_SIZE);
+    return arena;
+}
+
+void test_telemetry_build_never_allocates()
+{
+    static DeviceState state;
+    static TelemetryFrame frame;
+    static ChangeTracker tracker;
+    static char keyframe[Config::Telemetry::KEYFRAME_BYTES];
+    JsonArena &arena = mqttArena();
+    Host::clockUs = 1000000;
+
+    uint32_t before = AllocCounter::calls();
+    uint32_t seq = 0;
+    size_t written = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        churn(state, i);
+        Host::clockUs += 20000;
+
+        // Keyframe every 50 passes, deltas in between
+        bool full = i % 50 == 0;
+        frame.capture(state);
+        uint64_t mask = full ? ChangeTracker::ALL : tracker.changes(frame);
+
+        JsonArena::Scope scope(arena, full ? "telemetry" : "delta");
+        JsonDocument doc(&arena);
+        JsonObject out = doc.to<JsonObject>();
+        Timebase::stamp(out);
+        out["seq"] = ++seq;
+        frame.write(out, mask);
+
+        char buffer[Config::Mqtt::MAX_MESSAGE_SIZE];
+        char *target = full ? keyframe : buffer;
+        size_t size = full ? sizeof(keyframe) : sizeof(buffer);
+        if (measureJson(doc) >= size)
+        {
+            TEST_FAIL_MESSAGE("telemetry message does not fit its buffer");
+        }
+        written += serializeJson(doc, target, size);
+        tracker.commit(frame, mask);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, AllocCounter::calls());
+    TEST_ASSERT_GREATER_THAN(1000, written);
+}
+
+void test_status_refresh_never_allocates()
+{
+    static DeviceState state;
+    static JsonArena arena;
+    if (!arena.capacity())
+        arena.begin("status", Config::Json::STATUS_ARENA_SIZE);
+    static FixedString<Config::Web::STATUS_JSON_SIZE> statusJson;
+    state.savedSsid = "shop-floor-2.4GHz";
+    state.localIP.octets[0] = 192;
+    state.localIP.octets[1] = 168;
+    state.localIP.octets[3] = 42;
+
+    uint32_t before = AllocCounter::calls();
+    uint32_t versions = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        churn(state, i / 10);
+        state.powerIdle = i % 4 == 0;
+        state.avgCurrentMa = 80 + i % 30;
+
+        FixedString<Config::Web::STATUS_JSON_SIZE> json;
+        {
+            JsonArena::Scope scope(arena, "status");
+            JsonDocument doc(&arena);
+            doc["connected"] = state.wifiConnected;
+            doc["ip"] = Fmt::ip(state.localIP).c_str();
+            doc["savedSsid"] = state.savedSsid.c_str();
+            doc["powerIdle"] = state.powerIdle;
+            doc["avgCurrentMa"] = state.avgCurrentMa;
+            doc["wakeLatencyUs"] = state.wakeLatencyUs;
+            doc["heapFree"] = state.heapFree & ~1023u;
+            doc["memoryLow"] = state.memoryLow;
+            doc["backlog"] = state.backlogRecords;
+
+            char buffer[Config::Web::STATUS_JSON_SIZE + 1];
+            serializeJson(doc, buffer, sizeof(buffer));
+            json = buffer;
+        }
+        if (json != statusJson)
+        {
+            statusJson = json;
+            versions++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, AllocCounter::calls());
+    TEST_ASSERT_GREATER_THAN(10, versions);
+    TEST_ASSERT_NOT_NULL(strstr(statusJson.c_str(), "\"ip\":\"192.168.0.42\""));
+}
+
+void test_display_text_never_allocates()
+{
+    static DeviceState state;
+    state.savedSsid = "a-very-long-workshop-network-name";
+    char buffer[32];
+
+    uint32_t before = AllocCounter::calls();
+    for (int i = 0; i < 1000; i++)
+    {
+        churn(state, i);
+        Host::clockUs += 500000;
+
+        sprintf(buffer, "%6.1f%%   ", state.axes[0].motorSpeed / 10.0f);
+        sprintf(buffer, "%8lld    ", (long long)state.axes[0].encoderPos);
+        sprintf(buffer, "%4d      ", state.axes[0].currentAdc);
+        sprintf(buffer, "%-15s", Fmt::ip(state.localIP).c_str());
+        sprintf(buffer, "%-16s", Fmt::ellipsize<16>(state.savedSsid.c_str(), 16).c_str());
+        snprintf(buffer, sizeof(buffer), "Up %s", Fmt::duration(Timebase::nowMs() / 1000).c_str());
+        snprintf(buffer, sizeof(buffer), "Uptime: %s", Fmt::duration(Timebase::nowMs() / 1000).c_str());
+        sink = strlen(buffer);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, AllocCounter::calls());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_transient_allocation_is_counted);
+    RUN_TEST(test_other_threads_are_not_counted);
+    RUN_TEST(test_fixed_string_never_allocates);
+    RUN_TEST(test_load_estimator_never_allocates);
+    RUN_TEST(test_block_analysis_never_allocates);
+    RUN_TEST(test_telemetry_build_never_allocates);
+    RUN_TEST(test_status_refresh_never_allocates);
+    RUN_TEST(test_display_text_never_allocates);
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+// Reference current-analysis kernels (core/Dsp.h): correctness on synthetic
+// blocks and a host benchmark. The esp-dsp kernels are timed on the target
+// by CurrentAnalyzer::benchmark() at boot ("Block benchmark" in the log).
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "core/Config.h"
+#include "core/Dsp.h"
+
+static constexpr size_t N = Config::Analysis::BLOCK_SIZE;
+static constexpr float RATE = Config::Analysis::SAMPLE_RATE_HZ;
+
+static float samples[N];
+static float centered[N];
+static float window[N];
+static float work[2 * N];
+
+void setUp() {}
+void tearDown() {}
+
+static void fillSine(float dc, float amplitude, float hz)
+{
+    for (size_t i = 0; i < N; i++)
+        samples[i] = dc + amplitude * sinf(2.0f * (float)M_PI * hz * i / RATE);
+}
+
+static Dsp::Spectrum analyze()
+{
+    Dsp::statsReference(samples, centered, N);
+    Dsp::loadWindowed(centered, window, work, N);
+    Dsp::fftReference(work, N);
+    return Dsp::summarize(work, N, RATE, Config::Analysis::VIBRATION_BAND_LOW_HZ, Config::Analysis::VIBRATION_BAND_HIGH_HZ);
+}
+
+void test_stats_of_sine_with_offset()
+{
+    // Whole number of periods, so the mean is exact
+    fillSine(2048, 300, RATE * 8 / N);
+    Dsp::BlockStats s = Dsp::statsReference(samples, centered, N);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 2048, s.mean);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 300 / sqrtf(2), s.rms);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 300, s.peak);
+}
+
+void test_dominant_frequency_in_band()
+{
+    fillSine(2048, 200, 125);
+    Dsp::Spectrum sp = analyze();
+    TEST_ASSERT_FLOAT_WITHIN(RATE / N, 125, sp.dominantHz);
+    TEST_ASSERT_TRUE(sp.bandRatio > 0.9f);
+}
+
+void test_dominant_frequency_out_of_band()
+{
+    fillSine(2048, 200, 700);
+    Dsp::Spectrum sp = analyze();
+    TEST_ASSERT_FLOAT_WITHIN(RATE / N, 700, sp.dominantHz);
+    TEST_ASSERT_TRUE(sp.bandRatio < 0.1f);
+}
+
+void test_fft_matches_dft()
+{
+    fillSine(0, 100, 300);
+    for (size_t i = 0; i < N; i++)
+    {
+        work[2 * i] = samples[i];
+        work[2 * i + 1] = 0;
+    }
+    Dsp::fftReference(work, N);
+
+    const size_t bins[] = {1, 38, 39, 100};
+    for (size_t k : bins)
+    {
+        double re = 0, im = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            re += samples[i] * cos(2 * M_PI * k * i / N);
+            im -= samples[i] * sin(2 * M_PI * k * i / N);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(0.05f, re, work[2 * k]);
+        TEST_ASSERT_FLOAT_WITHIN(0.05f, im, work[2 * k + 1]);
+    }
+}
+
+// Host figure for the reference path; compare with the boot log on target
+void test_benchmark_reference_block()
+{
+    constexpr int BLOCKS = 2000;
+    fillSine(2048, 200, 125);
+    auto start = std::chrono::steady_clock::now();
+    float sink = 0;
+    for (int i = 0; i < BLOCKS; i++)
+        sink += analyze().dominantHz;
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    char line[96];
+    snprintf(line, sizeof(line), "Reference block (N=%u): %.2f us", (unsigned)N, (double)us / BLOCKS);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(sink > 0);
+}
+
+int main()
+{
+    Dsp::hannWindow(window, N);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_stats_of_sine_with_offset);
+    RUN_TEST(test_dominant_frequency_in_band);
+    RUN_TEST(test_dominant_frequency_out_of_band);
+    RUN_TEST(test_fft_matches_dft);
+    RUN_TEST(test_benchmark_reference_block);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+// LoadEstimator (core/LoadEstimator.h) against simulated motor traces: a
+// brushed motor at Config::Stall's no-load model, 1 ms control passes with
+// jitter, encoder quantization and current noise.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "core/Config.h"
+#include "core/LoadEstimator.h"
+
+struct Motor
+{
+    // Share of no-load speed the load allows, and the current it draws
+    float speedFactor = 1.0f;
+    float currentAdc = Config::Stall::NO_LOAD_CURRENT_ADC;
+
+    double position = 0;
+    uint32_t nowUs = 0;
+};
+
+static LoadEstimator estimator;
+static Motor motor;
+
+void setUp()
+{
+    estimator.reset();
+    motor = Motor();
+    srand(1);
+}
+
+void tearDown() {}
+
+static float noise(float amplitude)
+{
+    return amplitude * (2.0f * rand() / RAND_MAX - 1.0f);
+}
+
+// Runs passes for `ms`; returns the time of the first stall since the
+// start, or -1 if none
+static int32_t run(int speed, uint32_t ms)
+{
+    uint32_t start = motor.nowUs;
+    int32_t stalledAt = -1;
+    while (motor.nowUs - start < ms * 1000)
+    {
+        uint32_t dtUs = 1000 + (int32_t)noise(300);
+        motor.position += speed * Config::Stall::NO_LOAD_CPS_PER_SPEED * motor.speedFactor * dtUs / 1e6;
+        motor.nowUs += dtUs;
+        estimator.update(speed, (int64_t)motor.position, motor.currentAdc + noise(40), motor.nowUs);
+        if (estimator.stalled() && stalledAt < 0)
+            stalledAt = (motor.nowUs - start) / 1000;
+    }
+    return stalledAt;
+}
+
+void test_free_run_never_stalls()
+{
+    TEST_ASSERT_EQUAL(-1, run(500, 3000));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 1.0f, estimator.speedRatio());
+    TEST_ASSERT_FLOAT_WITHIN(20, 0, estimator.load());
+}
+
+void test_jam_detected_within_tens_of_ms()
+{
+    TEST_ASSERT_EQUAL(-1, run(500, 1000));
+
+    motor.speedFactor = 0;
+    motor.currentAdc = 2500;
+    int32_t detectMs = run(500, 500);
+
+    char line[64];
+    snprintf(line, sizeof(line), "Jam detected after %ld ms", (long)detectMs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(detectMs >= (int32_t)Config::Stall::STALL_CONFIRM_MS);
+    TEST_ASSERT_LESS_OR_EQUAL(80, detectMs);
+    TEST_ASSERT_TRUE(estimator.load() > 1500);
+}
+
+void test_heavy_load_while_moving_is_not_a_stall()
+{
+    motor.speedFactor = 0.5f;
+    motor.currentAdc = 2200;
+    TEST_ASSERT_EQUAL(-1, run(500, 3000));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 0.5f, estimator.speedRatio());
+}
+
+void test_inrush_during_spinup_is_ignored()
+{
+    // Stalled-looking start: no motion and high current for 100 ms
+    motor.speedFactor = 0;
+    motor.currentAdc = 2500;
+    TEST_ASSERT_EQUAL(-1, run(500, 100));
+
+    motor.speedFactor = 1.0f;
+    motor.currentAdc = Config::Stall::NO_LOAD_CURRENT_ADC;
+    TEST_ASSERT_EQUAL(-1, run(500, 2000));
+}
+
+void test_stall_clears_when_jam_releases()
+{
+    run(500, 1000);
+    motor.speedFactor = 0;
+    motor.currentAdc = 2500;
+    TEST_ASSERT_TRUE(run(500, 200) >= 0);
+    TEST_ASSERT_TRUE(estimator.stalled());
+
+    motor.speedFactor = 1.0f;
+    motor.currentAdc = Config::Stall::NO_LOAD_CURRENT_ADC;
+    run(500, 100);
+    TEST_ASSERT_FALSE(estimator.stalled());
+}
+
+void test_new_setpoint_clears_stall()
+{
+    run(500, 1000);
+    motor.speedFactor = 0;
+    motor.currentAdc = 2500;
+    run(500, 200);
+    TEST_ASSERT_TRUE(estimator.stalled());
+
+    // Reverse-and-retry: a new duty restarts the spin-up grace
+    run(-470, 1);
+    TEST_ASSERT_FALSE(estimator.stalled());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_free_run_never_stalls);
+    RUN_TEST(test_jam_detected_within_tens_of_ms);
+    RUN_TEST(test_heavy_load_while_moving_is_not_a_stall);
+    RUN_TEST(test_inrush_during_spinup_is_ignored);
+    RUN_TEST(test_stall_clears_when_jam_releases);
+    RUN_TEST(test_new_setpoint_clears_stall);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// Log (core/Log.h): records packed by Log::write() and formatted on the way
+// into the history must read as snprintf() would have printed them, plus a
+// host benchmark of the per-call enqueue cost. On the target the same push
+// runs in every LOG_x call; formatting happens on the drain task.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "core/Config.h"
+#include "core/Log.h"
+
+using Log::Level;
+using Log::Module;
+
+static constexpr size_t SLOTS = Config::Log::RING_SLOTS;
+
+void setUp()
+{
+    Log::flush();
+    Host::clockUs = 12345678;
+}
+
+void tearDown() {}
+
+// Formats through the ring and returns the newest history line's text
+// without its "<ms> <module> " prefix; a marker the caller's compare rejects
+// if the line or its prefix is missing
+template <typename... Args>
+static const char *roundTrip(const char *fmt, Args... args)
+{
+    static Log::Line line;
+    Log::write(Module::Motor, Level::Info, fmt, args...);
+    Log::flush();
+    if (Log::history(Log::lastSeq() - 1, &line, 1) != 1)
+        return "<no line>";
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%llu %s ", (unsigned long long)(Host::clockUs / 1000),
+             Log::detail::prefixes[(uint8_t)Module::Motor]);
+    if (strncmp(line.text.c_str(), prefix, strlen(prefix)) != 0)
+        return "<bad prefix>";
+    return line.text.c_str() + strlen(prefix);
+}
+
+void test_integers_round_trip()
+{
+    TEST_ASSERT_EQUAL_STRING("speed=-300 axis=2", roundTrip("speed=%d axis=%u", -300, (uint8_t)2));
+    TEST_ASSERT_EQUAL_STRING("pos=-9000000000 max=18446744073709551615",
+                             roundTrip("pos=%lld max=%llu", (long long)-9000000000LL, (unsigned long long)UINT64_MAX));
+    TEST_ASSERT_EQUAL_STRING("0x00ff |  42| |42  | 052 c",
+                             roundTrip("0x%04x |%4d| |%-4d| %03o %c", 255u, 42, 42, 42, 'c'));
+    TEST_ASSERT_EQUAL_STRING("100% done", roundTrip("100%% done"));
+}
+
+void test_floats_and_strings_round_trip()
+{
+    TEST_ASSERT_EQUAL_STRING("rms=12.35 hz=1.5e+03", roundTrip("rms=%.2f hz=%.1e", 12.345f, 1500.0));
+    TEST_ASSERT_EQUAL_STRING("ssid 'shop-floor' ip (null)", roundTrip("ssid '%s' ip %s", "shop-floor", (const char *)nullptr));
+    TEST_ASSERT_EQUAL_STRING("[   ab]", roundTrip("[%5s]", "ab"));
+}
+
+void test_missing_argument_is_marked()
+{
+    TEST_ASSERT_EQUAL_STRING("a=1 b=<?>", roundTrip("a=%d b=%d", 1));
+}
+
+void test_long_string_is_cut_and_counted()
+{
+    char text[200];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+
+    uint32_t before = Log::stats().truncated;
+    const char *out = roundTrip("%s", text);
+    TEST_ASSERT_EQUAL_UINT32(before + 1, Log::stats().truncated);
+    TEST_ASSERT_TRUE(strlen(out) > 0 && strlen(out) < Log::detail::PAYLOAD);
+    TEST_ASSERT_EQUAL_INT('x', out[0]);
+}
+
+void test_full_ring_drops_and_counts()
+{
+    uint32_t dropped = Log::stats().dropped;
+    for (size_t i = 0; i < SLOTS + 5; i++)
+        Log::write(Module::Motor, Level::Info, "fill %u", (unsigned)i);
+    TEST_ASSERT_EQUAL_UINT32(dropped + 5, Log::stats().dropped);
+
+    // The oldest records survive, in order
+    Log::flush();
+    Log::Line line;
+    TEST_ASSERT_EQUAL(1, Log::history(Log::lastSeq() - 1, &line, 1));
+    char expected[16];
+    snprintf(expected, sizeof(expected), "fill %u", (unsigned)(SLOTS - 1));
+    TEST_ASSERT_NOT_NULL(strstr(line.text.c_str(), expected));
+}
+
+void test_history_keeps_the_newest_lines()
+{
+    for (unsigned i = 0; i < Config::Log::HISTORY_LINES + 8; i++)
+        Log::write(Module::Motor, Level::Info, "line %u", i);
+    Log::flush();
+
+    static Log::Line lines[Config::Log::HISTORY_LINES + 8];
+    uint32_t last = Log::lastSeq();
+    size_t n = Log::history(0, lines, Config::Log::HISTORY_LINES + 8);
+    TEST_ASSERT_EQUAL(Config::Log::HISTORY_LINES, n);
+    for (size_t i = 0; i < n; i++)
+        TEST_ASSERT_EQUAL_UINT32(last - Config::Log::HISTORY_LINES + 1 + i, lines[i].seq);
+
+    TEST_ASSERT_EQUAL(3, Log::history(last - 3, lines, 8));
+    TEST_ASSERT_EQUAL(0, Log::history(last, lines, 8));
+}
+
+void test_benchmark_enqueue()
+{
+    constexpr int ROUNDS = 2000;
+    constexpr size_t BATCH = SLOTS - 1;
+    uint32_t dropped = Log::stats().dropped;
+
+    // Only the writes are timed; the ring is drained between batches
+    std::chrono::nanoseconds spent{0};
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < BATCH; i++)
+            Log::write(Module::Motor, Level::Info, "axis %u speed %d rms %.1f via %s", (unsigned)(i & 3), -500, 12.5f, "mqtt");
+        spent += std::chrono::steady_clock::now() - start;
+        Log::flush();
+    }
+
+    double ns = (double)spent.count() / (ROUNDS * BATCH);
+    char line[96];
+    snprintf(line, sizeof(line), "Log::write, 4 args: %.1f ns per call", ns);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(dropped, Log::stats().dropped);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_integers_round_trip);
+    RUN_TEST(test_floats_and_strings_round_trip);
+    RUN_TEST(test_missing_argument_is_marked);
+    RUN_TEST(test_long_string_is_cut_and_counted);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_history_keeps_the_newest_lines);
+    RUN_TEST(test_benchmark_enqueue);
+    return UNITY_END();
+}
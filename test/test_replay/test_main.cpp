@@ -0,0 +1,232 @@
+// Replay (core/Replay.h): a recording read back through export, a replay
+// that feeds the recorded commands and passes back in their order, the
+// record walk stopping at a truncated record, and the HTTP upload of an
+// input file with a second request racing the owner for the buffer.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "core/Config.h"
+#include "core/Replay.h"
+
+static constexpr uint8_t AXES = Config::Axes::COUNT;
+
+static DeviceState state;
+
+// Stand-ins for two HTTP requests; only their addresses matter
+static int requestA, requestB;
+
+struct Injected
+{
+    char topic[32];
+    char payload[64];
+};
+static std::vector<Injected> injected;
+
+static void inject(const char *topic, const char *payload)
+{
+    Injected command = {};
+    snprintf(command.topic, sizeof(command.topic), "%s", topic);
+    snprintf(command.payload, sizeof(command.payload), "%s", payload);
+    injected.push_back(command);
+}
+
+static void update() { Replay::update(state, inject); }
+
+static void pass(int64_t encoder, int16_t current)
+{
+    AxisInputs in[AXES];
+    for (uint8_t i = 0; i < AXES; i++)
+    {
+        in[i].encoderCount = encoder + i;
+        in[i].currentAdc = current;
+    }
+    Replay::inputs(in);
+    Host::clockUs += 1000;
+}
+
+// Two commands and three passes: a, pass 1, b, pass 2, pass 3
+static std::vector<uint8_t> record()
+{
+    Replay::requestRecord(1000);
+    update();
+    Replay::command("hub/cmd/motor", "{\"speed\":100}");
+    pass(10, 1);
+    Replay::command("hub/cmd/sequence", "{\"action\":\"stop\"}");
+    pass(20, 2);
+    pass(30, 3);
+    Replay::requestStop();
+    update();
+
+    std::vector<uint8_t> file(Replay::exportSize(false));
+    Replay::read(false, file.data(), file.size(), 0);
+    return file;
+}
+
+void setUp()
+{
+    Replay::requestStop();
+    update();
+    Replay::cancelUpload(&requestA);
+    Replay::cancelUpload(&requestB);
+    state = DeviceState();
+    injected.clear();
+    Host::clockUs = 5000000;
+}
+
+void tearDown() {}
+
+void test_recording_exports_header_and_records()
+{
+    std::vector<uint8_t> file = record();
+    TEST_ASSERT_FALSE(Replay::busy());
+    TEST_ASSERT_GREATER_THAN(sizeof(Replay::Header), file.size());
+
+    Replay::Header header;
+    memcpy(&header, file.data(), sizeof(header));
+    TEST_ASSERT_EQUAL_MEMORY("AFRP", header.magic, 4);
+    TEST_ASSERT_EQUAL_UINT8(0, header.output);
+    TEST_ASSERT_EQUAL_UINT8(AXES, header.axes);
+    TEST_ASSERT_EQUAL_UINT32(5, header.records);
+    TEST_ASSERT_EQUAL_UINT32(file.size(), header.bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, header.dropped);
+
+    // First record: the motor command, topic and payload
+    Replay::RecordHeader first;
+    memcpy(&first, file.data() + sizeof(header), sizeof(first));
+    TEST_ASSERT_EQUAL((int)Replay::Type::Command, (int)first.type);
+    const char *topic = (const char *)file.data() + sizeof(header) + sizeof(first);
+    TEST_ASSERT_EQUAL_STRING("hub/cmd/motor", topic);
+    TEST_ASSERT_EQUAL(strlen("hub/cmd/motor") + 1 + strlen("{\"speed\":100}"), first.size);
+}
+
+void test_replay_feeds_commands_before_their_pass()
+{
+    record();
+    TEST_ASSERT_TRUE(Replay::requestReplay(0));
+    update();
+    TEST_ASSERT_TRUE(Replay::replaying());
+
+    AxisInputs in[AXES];
+    int64_t expected[] = {10, 20, 30};
+    size_t commands[] = {1, 2, 2};
+    for (int p = 0; p < 3; p++)
+    {
+        TEST_ASSERT_EQUAL(commands[p], injected.size());
+        TEST_ASSERT_TRUE(Replay::inputs(in));
+        TEST_ASSERT_EQUAL_INT64(expected[p], in[0].encoderCount);
+        TEST_ASSERT_EQUAL_INT64(expected[p] + AXES - 1, in[AXES - 1].encoderCount);
+        TEST_ASSERT_EQUAL_INT16(p + 1, in[0].currentAdc);
+        update();
+    }
+
+    TEST_ASSERT_FALSE(Replay::replaying());
+    TEST_ASSERT_EQUAL_STRING("hub/cmd/motor", injected[0].topic);
+    TEST_ASSERT_EQUAL_STRING("{\"speed\":100}", injected[0].payload);
+    TEST_ASSERT_EQUAL_STRING("hub/cmd/sequence", injected[1].topic);
+    TEST_ASSERT_EQUAL_STRING("{\"action\":\"stop\"}", injected[1].payload);
+}
+
+void test_truncated_record_ends_the_replay()
+{
+    std::vector<uint8_t> file = record();
+
+    // Cut into the last pass: its header says more than the file holds
+    size_t cut = file.size() - 4;
+    const char *error = nullptr;
+    TEST_ASSERT_TRUE(Replay::upload(&requestA, file.data(), cut, 0, cut, error));
+    TEST_ASSERT_TRUE(Replay::requestReplay(0));
+    update();
+
+    AxisInputs in[AXES];
+    TEST_ASSERT_TRUE(Replay::inputs(in));
+    update();
+    TEST_ASSERT_TRUE(Replay::inputs(in));
+    TEST_ASSERT_EQUAL_INT64(20, in[0].encoderCount);
+    TEST_ASSERT_TRUE(Replay::replaying());
+
+    // The truncated pass is never read
+    TEST_ASSERT_FALSE(Replay::inputs(in));
+    TEST_ASSERT_EQUAL_INT64(20, in[0].encoderCount);
+    update();
+    TEST_ASSERT_FALSE(Replay::replaying());
+}
+
+void test_second_upload_cannot_touch_the_first()
+{
+    std::vector<uint8_t> file = record();
+    size_t total = file.size();
+    size_t half = total / 2;
+    const char *error = nullptr;
+
+    TEST_ASSERT_TRUE(Replay::upload(&requestA, file.data(), half, 0, total, error));
+    TEST_ASSERT_NULL(error);
+
+    // B is refused on its first chunk...
+    std::vector<uint8_t> other(Config::Replay::INPUT_BYTES, 0xee);
+    TEST_ASSERT_FALSE(Replay::upload(&requestB, other.data(), 64, 0, other.size(), error));
+    TEST_ASSERT_EQUAL_STRING("busy", error);
+
+    // ...and its later chunks neither land in A's buffer nor run past it
+    error = nullptr;
+    TEST_ASSERT_FALSE(Replay::upload(&requestB, other.data(), 64, half, other.size(), error));
+    TEST_ASSERT_FALSE(Replay::upload(&requestB, other.data(), 4096, other.size() - 64, other.size(), error));
+    TEST_ASSERT_NULL(error);
+
+    // B's disconnect leaves A's upload alone
+    Replay::cancelUpload(&requestB);
+    TEST_ASSERT_TRUE(Replay::busy());
+
+    TEST_ASSERT_TRUE(Replay::upload(&requestA, file.data() + half, total - half, half, total, error));
+    TEST_ASSERT_NULL(error);
+    TEST_ASSERT_FALSE(Replay::busy());
+
+    std::vector<uint8_t> back(Replay::exportSize(false));
+    TEST_ASSERT_EQUAL(total, back.size());
+    Replay::read(false, back.data(), back.size(), 0);
+    TEST_ASSERT_EQUAL_MEMORY(file.data(), back.data(), total);
+}
+
+void test_chunk_past_declared_size_is_refused()
+{
+    std::vector<uint8_t> file = record();
+    const char *error = nullptr;
+
+    TEST_ASSERT_TRUE(Replay::upload(&requestA, file.data(), 32, 0, 64, error));
+    TEST_ASSERT_FALSE(Replay::upload(&requestA, file.data(), 32, 48, 64, error));
+    TEST_ASSERT_EQUAL_STRING("bad_size", error);
+
+    // The buffer is released for the next upload
+    TEST_ASSERT_FALSE(Replay::busy());
+    error = nullptr;
+    TEST_ASSERT_TRUE(Replay::upload(&requestB, file.data(), file.size(), 0, file.size(), error));
+    TEST_ASSERT_NULL(error);
+}
+
+void test_owner_disconnect_releases_the_buffer()
+{
+    std::vector<uint8_t> file = record();
+    const char *error = nullptr;
+
+    TEST_ASSERT_TRUE(Replay::upload(&requestA, file.data(), 32, 0, file.size(), error));
+    Replay::cancelUpload(&requestA);
+    TEST_ASSERT_FALSE(Replay::busy());
+    TEST_ASSERT_EQUAL(0, Replay::exportSize(false));
+
+    // A's late chunk is dropped without an answer
+    TEST_ASSERT_FALSE(Replay::upload(&requestA, file.data() + 32, 32, 32, file.size(), error));
+    TEST_ASSERT_NULL(error);
+    TEST_ASSERT_FALSE(Replay::requestReplay(0));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_recording_exports_header_and_records);
+    RUN_TEST(test_replay_feeds_commands_before_their_pass);
+    RUN_TEST(test_truncated_record_ends_the_replay);
+    RUN_TEST(test_second_upload_cannot_touch_the_first);
+    RUN_TEST(test_chunk_past_declared_size_is_refused);
+    RUN_TEST(test_owner_disconnect_releases_the_buffer);
+    return UNITY_END();
+}
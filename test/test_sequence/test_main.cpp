@@ -0,0 +1,170 @@
+// SequenceEngine (core/SequenceEngine.h) driven pass by pass on the fake
+// clock: timed steps chained on their deadlines, pause and resume, loop
+// laps, and the abort on a stall latched by the guard.
+#include <unity.h>
+#include <string.h>
+#include "core/Config.h"
+#include "core/SequenceEngine.h"
+
+static constexpr int64_t MS = 1000;
+
+static DeviceState state;
+
+// Sends a JSON command the way the MQTT and HTTP handlers do
+static const char *command(const char *json)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, json))
+        return "<bad json>";
+    const char *error = nullptr;
+    if (!SequenceEngine::handle(doc.as<JsonVariantConst>(), error))
+        return error ? error : "<refused>";
+    return "";
+}
+
+// One control pass, `ms` after the previous one
+static void pass(int64_t ms = 0)
+{
+    Host::clockUs += ms * MS;
+    SequenceEngine::tick(state);
+}
+
+static uint32_t reportU32(const char *key)
+{
+    JsonDocument doc;
+    SequenceEngine::report(doc.to<JsonObject>());
+    return doc[key] | 0u;
+}
+
+void setUp()
+{
+    SequenceEngine::stop();
+    state = DeviceState();
+    Host::clockUs = 10000 * MS;
+    pass();
+}
+
+void tearDown() {}
+
+void test_timed_steps_chain_on_their_deadlines()
+{
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"upload","start":true,"steps":[
+        {"speed":300,"ms":100},{"speed":-200,"ms":50},{"speed":0,"ms":0}]})"));
+    pass();
+    TEST_ASSERT_EQUAL((int)SequenceState::Running, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(300, state.axes[0].motorSpeed);
+
+    // 7 ms passes: step 0 ends at the first pass past 100 ms (105)...
+    for (int i = 0; i < 14; i++)
+        pass(7);
+    TEST_ASSERT_EQUAL(0, state.sequenceStep);
+    pass(7);
+    TEST_ASSERT_EQUAL(1, state.sequenceStep);
+    TEST_ASSERT_EQUAL(-200, state.axes[0].motorSpeed);
+    TEST_ASSERT_EQUAL_UINT32(5 * MS, reportU32("lastLateUs"));
+
+    // ...and step 1 at 150 ms, not 50 ms after that late pass (155)
+    for (int i = 0; i < 6; i++)
+        pass(7);
+    TEST_ASSERT_EQUAL(1, state.sequenceStep);
+    pass(7);
+    TEST_ASSERT_EQUAL_UINT32(4 * MS, reportU32("lastLateUs"));
+
+    // The zero-length last step runs on the same pass and ends the program
+    TEST_ASSERT_EQUAL((int)SequenceState::Done, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(0, state.axes[0].motorSpeed);
+    TEST_ASSERT_LESS_THAN(7 * MS, reportU32("maxLateUs"));
+}
+
+void test_pause_holds_the_remaining_time()
+{
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"upload","start":true,"steps":[
+        {"speed":500,"ms":100},{"speed":100,"ms":100}]})"));
+    pass();
+    pass(40);
+
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"pause"})"));
+    pass(1);
+    TEST_ASSERT_EQUAL((int)SequenceState::Paused, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(0, state.axes[0].motorSpeed);
+
+    // Time spent paused does not count against the step
+    for (int i = 0; i < 50; i++)
+        pass(20);
+    TEST_ASSERT_EQUAL((int)SequenceState::Paused, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(0, state.sequenceStep);
+
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"resume"})"));
+    pass(1);
+    TEST_ASSERT_EQUAL((int)SequenceState::Running, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(500, state.axes[0].motorSpeed);
+
+    // 59 ms were left when it paused
+    pass(58);
+    TEST_ASSERT_EQUAL(0, state.sequenceStep);
+    pass(1);
+    TEST_ASSERT_EQUAL(1, state.sequenceStep);
+    TEST_ASSERT_EQUAL(100, state.axes[0].motorSpeed);
+}
+
+void test_loop_counts_laps_until_turned_off()
+{
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"upload","start":true,"loop":true,"steps":[
+        {"speed":100,"ms":10},{"speed":-100,"ms":10}]})"));
+    pass();
+
+    for (int i = 0; i < 10; i++)
+        pass(10);
+    TEST_ASSERT_EQUAL((int)SequenceState::Running, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL_UINT32(5, state.sequenceLoops);
+    TEST_ASSERT_EQUAL(0, state.sequenceStep);
+
+    // The lap in progress finishes, then the program ends
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"loop","value":false})"));
+    pass(10);
+    TEST_ASSERT_EQUAL(1, state.sequenceStep);
+    pass(10);
+    TEST_ASSERT_EQUAL((int)SequenceState::Done, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL_UINT32(5, state.sequenceLoops);
+}
+
+void test_stall_on_a_program_axis_aborts()
+{
+    TEST_ASSERT_EQUAL_STRING("", command(R"({"action":"upload","start":true,"steps":[
+        {"axis":0,"speed":400,"ms":1000},{"axis":0,"speed":-400,"ms":1000}]})"));
+    pass();
+
+    // A stall on an axis the program does not drive is not its business
+    if (Config::Axes::COUNT > 1)
+    {
+        state.axes[1].loadStall = true;
+        pass(10);
+        TEST_ASSERT_EQUAL((int)SequenceState::Running, (int)state.sequenceState);
+        state.axes[1].loadStall = false;
+    }
+
+    state.axes[0].loadStall = true;
+    pass(10);
+    TEST_ASSERT_EQUAL((int)SequenceState::Failed, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(0, state.axes[0].motorSpeed);
+
+    JsonDocument doc;
+    SequenceEngine::report(doc.to<JsonObject>());
+    TEST_ASSERT_EQUAL_STRING("stall", doc["error"] | "");
+
+    // Failed stays put, even past the step's deadline
+    state.axes[0].loadStall = false;
+    pass(2000);
+    TEST_ASSERT_EQUAL((int)SequenceState::Failed, (int)state.sequenceState);
+    TEST_ASSERT_EQUAL(0, state.axes[0].motorSpeed);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_timed_steps_chain_on_their_deadlines);
+    RUN_TEST(test_pause_holds_the_remaining_time);
+    RUN_TEST(test_loop_counts_laps_until_turned_off);
+    RUN_TEST(test_stall_on_a_program_axis_aborts);
+    return UNITY_END();
+}
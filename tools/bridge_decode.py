@@ -0,0 +1,33 @@
+#!/usr/bin/env python3
+"""Print the messages inside bridge batches read from an upstream broker.
+
+    mosquitto_sub -h localhost -t 'plant/#' -F '%t %x' | python tools/bridge_decode.py
+"""
+import sys
+import zlib
+
+
+def decode(topic, body):
+    """Batch body -> (topic, payload) pairs; batch/z bodies are raw deflate"""
+    if topic.endswith("/batch/z"):
+        body = zlib.decompress(body, -15)
+    for line in body.decode("utf-8", "replace").splitlines():
+        inner, _, payload = line.partition("\t")
+        yield inner, payload
+
+
+def main():
+    for line in sys.stdin:
+        topic, _, hexbody = line.rstrip("\n").partition(" ")
+        if "/batch" not in topic:
+            continue
+        device = topic.split("/")[-3 if topic.endswith("/z") else -2]
+        try:
+            for inner, payload in decode(topic, bytes.fromhex(hexbody)):
+                print(f"{device} {inner} {payload}", flush=True)
+        except (ValueError, zlib.error) as e:
+            print(f"{topic}: undecodable batch ({e})", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Command round trip through the hub: tagged command in, hub/echo out.
+
+Sends motor commands carrying an "id" over MQTT (hub/axis/<n>/cmd) or HTTP
+(POST /api/motor) and waits for the matching hub/echo, which the device
+publishes once the command has reached the PWM output. Reports the round
+trip seen by this client next to the device's own ingress-to-PWM latency
+(latencyUs in the echo, as in /api/latency).
+
+    python tools/cmd_loopback.py --host hub.local --count 200
+    python tools/cmd_loopback.py --host hub.local --via http --api http://hub.local
+    python tools/cmd_loopback.py --host hub.local --speed 300   # hold axis 0 at 300
+
+The default command is "stop", so the motors do not move. Standard library
+only; the MQTT client is the one from mqtt_load.py.
+"""
+import argparse
+import asyncio
+import json
+import struct
+import time
+import urllib.request
+
+from mqtt_load import Client, percentile, read_packet
+
+ECHO_TOPIC = "hub/echo"
+
+
+def command(args, cmd_id):
+    body = {"action": "set", "speed": args.speed} if args.speed is not None else {"action": "stop"}
+    body["id"] = cmd_id
+    return body
+
+
+def post_motor(api, body):
+    request = urllib.request.Request(f"{api}/api/motor", data=json.dumps(body).encode(),
+                                     headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(request, timeout=5) as r:
+        r.read()
+
+
+async def next_echo(client, cmd_id):
+    while True:
+        kind, data = await read_packet(client.reader)
+        if kind & 0xF0 != 0x30:
+            continue
+        topic_len = struct.unpack_from("!H", data)[0]
+        if data[2:2 + topic_len].decode() != ECHO_TOPIC:
+            continue
+        echo = json.loads(data[2 + topic_len:])
+        if echo.get("id") == cmd_id:
+            return echo
+
+
+async def run(args):
+    client = Client("loopback")
+    await client.connect(args.host, args.port)
+    await client.subscribe(ECHO_TOPIC)
+    loop = asyncio.get_running_loop()
+
+    round_trips, device, lost = [], [], 0
+    # Ids start high so they do not collide with other clients' small ones
+    base = int(time.time()) % 1000000 * 1000 + 1
+    for i in range(args.count):
+        cmd_id = base + i
+        body = command(args, cmd_id)
+        start = time.perf_counter_ns()
+        if args.via == "http":
+            body["axis"] = args.axis
+            await loop.run_in_executor(None, post_motor, args.api, body)
+        else:
+            client.publish(f"hub/axis/{args.axis}/cmd", json.dumps(body).encode())
+            await client.writer.drain()
+        try:
+            echo = await asyncio.wait_for(next_echo(client, cmd_id), args.timeout)
+        except asyncio.TimeoutError:
+            lost += 1
+            continue
+        round_trips.append((time.perf_counter_ns() - start) / 1e3)
+        device.append(echo.get("latencyUs", 0))
+        await asyncio.sleep(args.interval)
+
+    client.close()
+
+    print(f"via={args.via} axis={args.axis} sent={args.count} echoed={len(round_trips)} lost={lost}")
+    for name, values in (("round trip", round_trips), ("device ingress-to-PWM", device)):
+        print(f"  {name} us: p50={percentile(values, 50):.0f} p99={percentile(values, 99):.0f} "
+              f"max={max(values, default=0):.0f}")
+    return 1 if lost else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="hub.local", help="broker carrying hub/echo")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--via", choices=("mqtt", "http"), default="mqtt")
+    parser.add_argument("--api", default="http://hub.local", help="hub base URL for --via http")
+    parser.add_argument("--axis", type=int, default=0)
+    parser.add_argument("--speed", type=int, help="send set with this speed instead of stop")
+    parser.add_argument("--count", type=int, default=100)
+    parser.add_argument("--interval", type=float, default=0.05, help="seconds between commands")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for each echo")
+    args = parser.parse_args()
+    raise SystemExit(asyncio.run(run(args)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Fan-out load test for the hub's embedded broker (or any MQTT 3.1.1 broker).
+
+Opens N subscribers on one topic plus a publisher, publishes at a fixed rate
+and reports delivered message rate, fan-out latency and, when --api points at
+the hub, memory per client from /api/broker. --slow K makes K of the
+subscribers stop reading, to check that the broker drops them instead of
+stalling everyone else.
+
+    python tools/mqtt_load.py --host hub.local --api http://hub.local --clients 1,4,8,16
+    python tools/mqtt_load.py --host localhost --clients 32 --slow 2   # mosquitto baseline
+
+Standard library only.
+"""
+import argparse
+import asyncio
+import json
+import struct
+import time
+import urllib.request
+
+TOPIC = "bench/fanout"
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        byte, n = n & 0x7F, n >> 7
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def utf8(s):
+    data = s.encode()
+    return struct.pack("!H", len(data)) + data
+
+
+def packet(kind, body):
+    return bytes([kind]) + varint(len(body)) + body
+
+
+async def read_packet(reader):
+    kind = (await reader.readexactly(1))[0]
+    length, shift = 0, 0
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return kind, await reader.readexactly(length)
+
+
+class Client:
+    def __init__(self, name):
+        self.name = name
+        self.reader = self.writer = None
+        self.latencies = []
+        self.received = 0
+        self.disconnected = False
+
+    async def connect(self, host, port, keepalive=60):
+        self.reader, self.writer = await asyncio.open_connection(host, port)
+        body = utf8("MQTT") + bytes([4, 0x02]) + struct.pack("!H", keepalive) + utf8(self.name)
+        self.writer.write(packet(0x10, body))
+        kind, data = await asyncio.wait_for(read_packet(self.reader), 5)
+        if kind != 0x20 or data[1] != 0:
+            raise ConnectionRefusedError(f"CONNACK rc={data[1] if len(data) > 1 else '?'}")
+
+    async def subscribe(self, topic):
+        self.writer.write(packet(0x82, struct.pack("!H", 1) + utf8(topic) + b"\x00"))
+        kind, _ = await asyncio.wait_for(read_packet(self.reader), 5)
+        if kind != 0x90:
+            raise ConnectionError("no SUBACK")
+
+    def publish(self, topic, payload):
+        self.writer.write(packet(0x30, utf8(topic) + payload))
+
+    async def receive(self):
+        try:
+            while True:
+                kind, data = await read_packet(self.reader)
+                if kind & 0xF0 != 0x30:
+                    continue
+                topic_len = struct.unpack_from("!H", data)[0]
+                payload = data[2 + topic_len:]
+                sent_ns = struct.unpack_from("!Q", payload, 4)[0]
+                self.latencies.append((time.perf_counter_ns() - sent_ns) / 1e3)
+                self.received += 1
+        except (asyncio.IncompleteReadError, ConnectionError):
+            self.disconnected = True
+
+    def close(self):
+        if self.writer:
+            self.writer.close()
+
+
+def broker_stats(api):
+    if not api:
+        return None
+    with urllib.request.urlopen(f"{api}/api/broker", timeout=5) as r:
+        return json.load(r)
+
+
+def percentile(values, pct):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+async def run(args, count):
+    subscribers, refused = [], 0
+    for i in range(count):
+        client = Client(f"load-{i}")
+        try:
+            await client.connect(args.host, args.port)
+            await client.subscribe(TOPIC)
+            subscribers.append(client)
+        except (ConnectionError, asyncio.TimeoutError, OSError) as e:
+            refused += 1
+            print(f"  {client.name}: {e}")
+
+    publisher = Client("load-pub")
+    await publisher.connect(args.host, args.port)
+    await asyncio.sleep(0.5)
+    stats = broker_stats(args.api)
+
+    # Slow subscribers never read, so their sockets fill up
+    readers = [asyncio.create_task(c.receive()) for c in subscribers[args.slow:]]
+
+    interval = 1.0 / args.rate
+    padding = bytes(max(0, args.size - 12))
+    start = time.perf_counter()
+    sent = 0
+    while time.perf_counter() - start < args.duration:
+        publisher.publish(TOPIC, struct.pack("!IQ", sent, time.perf_counter_ns()) + padding)
+        await publisher.writer.drain()
+        sent += 1
+        await asyncio.sleep(max(0.0, start + sent * interval - time.perf_counter()))
+    elapsed = time.perf_counter() - start
+    await asyncio.sleep(1.0)  # Let the fan-out drain
+
+    after = broker_stats(args.api)
+    fast = subscribers[args.slow:]
+    latencies = [l for c in fast for l in c.latencies]
+    received = sum(c.received for c in fast)
+    expected = sent * len(fast)
+
+    print(f"clients={len(subscribers)} refused={refused} slow={min(args.slow, len(subscribers))}")
+    print(f"  published {sent} at {sent / elapsed:.0f}/s, delivered {received}/{expected} "
+          f"({received / elapsed:.0f}/s)")
+    print(f"  fan-out latency us: p50={percentile(latencies, 50):.0f} "
+          f"p99={percentile(latencies, 99):.0f} max={max(latencies, default=0):.0f}")
+    print(f"  fast subscribers dropped: {sum(c.disconnected for c in fast)}")
+    if stats and after:
+        print(f"  per client: internal={stats['internalPerClient']} B psram={stats['psramPerClient']} B; "
+              f"longest pass {after['longestPassUs']} us, slow disconnects {after['slowDisconnects']}")
+
+    for task in readers:
+        task.cancel()
+    for c in subscribers + [publisher]:
+        c.close()
+    await asyncio.sleep(0.5)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="hub.local")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--api", help="hub base URL for /api/broker, e.g. http://hub.local")
+    parser.add_argument("--clients", default="1,4,8,16", help="comma-separated subscriber counts")
+    parser.add_argument("--rate", type=float, default=50, help="publishes per second")
+    parser.add_argument("--size", type=int, default=128, help="payload bytes")
+    parser.add_argument("--duration", type=float, default=10, help="seconds per step")
+    parser.add_argument("--slow", type=int, default=0, help="subscribers that never read")
+    args = parser.parse_args()
+
+    for count in (int(n) for n in args.clients.split(",")):
+        asyncio.run(run(args, count))
+
+
+if __name__ == "__main__":
+    main()
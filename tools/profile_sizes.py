@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Build every profile in platformio.ini and compare flash and static DRAM.
+
+    python tools/profile_sizes.py                      # all [env:...] sections
+    python tools/profile_sizes.py headless standalone  # just these
+
+The sizes are PlatformIO's own summary: Flash is the application image,
+RAM is static DRAM (.data + .bss). Boot time and the heap left after setup
+are runtime figures; each build logs them at boot ("Profile ... up in")
+and reports them under "boot" in /api/memory and hub/memory.
+"""
+import configparser
+import re
+import subprocess
+import sys
+
+SIZE = re.compile(r"^(RAM|Flash):.*\(used (\d+) bytes from (\d+) bytes\)", re.MULTILINE)
+
+
+def environments():
+    config = configparser.ConfigParser(interpolation=None)
+    config.read("platformio.ini")
+    # The native environment only runs host tests
+    return [s.split(":", 1)[1] for s in config.sections()
+            if s.startswith("env:") and config.get(s, "platform", fallback="") != "native"]
+
+
+def build(env):
+    result = subprocess.run(["pio", "run", "-e", env], capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout[-2000:] + result.stderr[-2000:])
+        sys.exit(f"{env}: build failed")
+    sizes = {kind: (int(used), int(total)) for kind, used, total in SIZE.findall(result.stdout)}
+    if set(sizes) != {"RAM", "Flash"}:
+        sys.exit(f"{env}: no size summary in the build output")
+    return sizes
+
+
+def main():
+    envs = sys.argv[1:] or environments()
+    results = {}
+    for env in envs:
+        print(f"Building {env}...", file=sys.stderr)
+        results[env] = build(env)
+
+    base = envs[0]
+    print(f"{'profile':28} {'flash':>10} {'vs ' + base[:10]:>14} {'DRAM':>8} {'vs ' + base[:10]:>14}")
+    for env in envs:
+        flash, ram = results[env]["Flash"][0], results[env]["RAM"][0]
+        flash_delta = flash - results[base]["Flash"][0]
+        ram_delta = ram - results[base]["RAM"][0]
+        print(f"{env:28} {flash:10} {flash_delta:+14} {ram:8} {ram_delta:+14}")
+
+
+if __name__ == "__main__":
+    main()
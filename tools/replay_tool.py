@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+"""Inspect and compare /api/replay recordings (src/core/Replay.h).
+
+    # Record 20 s of commands and sensor readings, keep both halves
+    curl -X POST "http://<device-ip>/api/replay?action=record&ms=20000"
+    curl -o field-in.bin  "http://<device-ip>/api/replay/input"
+    curl -o field-out.bin "http://<device-ip>/api/replay/output"
+
+    # Replay it on another build, pass by pass (speed=0) or at 1x..16x
+    curl --data-binary @field-in.bin "http://<device-ip>/api/replay/input"
+    curl -X POST "http://<device-ip>/api/replay?action=play&speed=1"
+    curl -o new-out.bin "http://<device-ip>/api/replay/output"
+
+    python tools/replay_tool.py dump field-in.bin
+    python tools/replay_tool.py stats new-out.bin
+    python tools/replay_tool.py diff field-out.bin new-out.bin
+"""
+import argparse
+import json
+import struct
+import sys
+from collections import defaultdict
+
+HEADER = struct.Struct("<4sHBBIII16s")
+RECORD = struct.Struct("<IBBH")
+INPUT = struct.Struct("<qqhBBI")
+PASS_AXIS = struct.Struct("<hH")
+
+COMMAND, INPUTS = 1, 2
+PASS, PUBLISH, DISPLAY, HANDLED = 16, 17, 18, 19
+NAMES = {COMMAND: "command", INPUTS: "inputs", PASS: "pass", PUBLISH: "publish", DISPLAY: "display", HANDLED: "handled"}
+
+# Payload keys that differ between runs without a change in behaviour
+VOLATILE_KEYS = {"ts", "utc", "seq", "controlTickUs", "wakeLatencyUs", "avgCurrentMa", "heapFree",
+                 "heapLargestBlock", "latencyUs"}
+# Topics whose content is diagnostic text rather than behaviour
+SKIPPED_TOPICS = {"hub/log"}
+
+
+class Recording:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if len(data) < HEADER.size:
+            sys.exit(f"{path}: too short")
+        magic, version, output, axes, records, size, dropped, firmware = HEADER.unpack_from(data)
+        if magic != b"AFRP" or version != 1:
+            sys.exit(f"{path}: not a replay file (magic {magic!r}, version {version})")
+        self.path = path
+        self.output = bool(output)
+        self.axes = axes
+        self.dropped = dropped
+        self.firmware = firmware.split(b"\0", 1)[0].decode("ascii", "replace")
+        self.records = list(self._records(data[:size]))
+        if len(self.records) != records:
+            print(f"{path}: header says {records} records, found {len(self.records)}", file=sys.stderr)
+
+    def _records(self, data):
+        offset = HEADER.size
+        while offset + RECORD.size <= len(data):
+            time_us, kind, _, size = RECORD.unpack_from(data, offset)
+            offset += RECORD.size
+            yield time_us, kind, self._decode(kind, data[offset:offset + size])
+            offset += size
+
+    def _decode(self, kind, body):
+        if kind in (COMMAND, PUBLISH):
+            topic, _, payload = body.partition(b"\0")
+            return topic.decode(), payload.decode("utf-8", "replace")
+        if kind == INPUTS:
+            return [INPUT.unpack_from(body, i * INPUT.size)[:4] for i in range(self.axes)]
+        if kind == PASS:
+            (pass_us,) = struct.unpack_from("<I", body)
+            return pass_us, [PASS_AXIS.unpack_from(body, 4 + i * PASS_AXIS.size) for i in range(self.axes)]
+        if kind == DISPLAY:
+            return struct.unpack_from("<IQ", body)
+        if kind == HANDLED:
+            (process_us,) = struct.unpack_from("<I", body)
+            return process_us, body[4:].decode()
+        return body
+
+    def of(self, kind):
+        return [(t, value) for t, k, value in self.records if k == kind]
+
+    def describe(self):
+        kind = "output" if self.output else "input"
+        return f"{self.path}: {kind}, firmware {self.firmware}, {self.axes} axes, {len(self.records)} records, {self.dropped} dropped"
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100))] if ordered else 0
+
+
+def timings(rec):
+    """Processing time in us per step: control pass, display update, each command topic"""
+    steps = defaultdict(list)
+    for _, (pass_us, _) in rec.of(PASS):
+        steps["pass"].append(pass_us)
+    for _, (update_us, _) in rec.of(DISPLAY):
+        steps["display"].append(update_us)
+    for _, (process_us, topic) in rec.of(HANDLED):
+        steps[topic].append(process_us)
+    return steps
+
+
+def normalize(payload, ignore):
+    try:
+        value = json.loads(payload)
+    except ValueError:
+        return payload
+
+    def strip(v):
+        if isinstance(v, dict):
+            return {k: strip(x) for k, x in v.items() if k not in ignore}
+        if isinstance(v, list):
+            return [strip(x) for x in v]
+        return v
+
+    return json.dumps(strip(value), sort_keys=True)
+
+
+def cmd_dump(args):
+    rec = Recording(args.file)
+    print(rec.describe())
+    for time_us, kind, value in rec.records:
+        if args.type and NAMES.get(kind) not in args.type:
+            continue
+        if kind == INPUTS:
+            text = "  ".join(f"enc={e} idx={'%d' % i if latched else '-'} adc={a}" for e, i, a, latched in value)
+        elif kind == PASS:
+            text = f"{value[0]} us  " + "  ".join(f"speed={s} duty={d}" for s, d in value[1])
+        elif kind == DISPLAY:
+            text = f"{value[0]} us  changed={value[1]:#x}"
+        elif kind == HANDLED:
+            text = f"{value[0]} us  {value[1]}"
+        elif kind in (COMMAND, PUBLISH):
+            text = f"{value[0]}  {value[1]}"
+        else:
+            text = value.hex()
+        print(f"{time_us / 1000:10.3f} ms  {NAMES.get(kind, kind):8} {text}")
+
+
+def cmd_stats(args):
+    rec = Recording(args.file)
+    print(rec.describe())
+    print(f"{'step':28} {'count':>7} {'p50':>7} {'p99':>7} {'max':>7}  (us)")
+    for step, values in sorted(timings(rec).items()):
+        print(f"{step:28} {len(values):7} {percentile(values, 50):7} {percentile(values, 99):7} {max(values):7}")
+
+
+def compare(label, a, b, limit):
+    """Prints the first `limit` differing positions; returns their count"""
+    differences = [i for i in range(max(len(a), len(b))) if i >= len(a) or i >= len(b) or a[i] != b[i]]
+    if not differences:
+        print(f"{label}: {len(a)} identical")
+        return 0
+    print(f"{label}: {len(differences)} of {max(len(a), len(b))} differ ({len(a)} vs {len(b)})")
+    for i in differences[:limit]:
+        print(f"  #{i}: {a[i] if i < len(a) else '<missing>'}")
+        print(f"  {' ' * len(str(i))}  {b[i] if i < len(b) else '<missing>'}")
+    return len(differences)
+
+
+def cmd_diff(args):
+    a, b = Recording(args.a), Recording(args.b)
+    print("A " + a.describe())
+    print("B " + b.describe())
+    if not (a.output and b.output):
+        sys.exit("diff compares output files")
+    if a.axes != b.axes:
+        sys.exit("axis counts differ")
+
+    ignore = VOLATILE_KEYS | set(args.ignore or [])
+    failures = 0
+
+    # PWM: one entry per control pass, so positions line up exactly
+    failures += compare("pwm", [axes for _, (_, axes) in a.of(PASS)], [axes for _, (_, axes) in b.of(PASS)], args.limit)
+
+    # Telemetry: publishes are paced by real time, so compare what was said
+    # per topic, with consecutive repeats folded
+    def published(rec):
+        topics = defaultdict(list)
+        for _, (topic, payload) in rec.of(PUBLISH):
+            if topic in SKIPPED_TOPICS:
+                continue
+            text = normalize(payload, ignore)
+            if not topics[topic] or topics[topic][-1] != text:
+                topics[topic].append(text)
+        return topics
+
+    pa, pb = published(a), published(b)
+    for topic in sorted(set(pa) | set(pb)):
+        failures += compare(f"publish {topic}", pa.get(topic, []), pb.get(topic, []), args.limit)
+
+    # Display: the set of fields each update redrew
+    failures += compare("display", [f"{m:#x}" for _, (_, m) in a.of(DISPLAY)], [f"{m:#x}" for _, (_, m) in b.of(DISPLAY)], args.limit)
+
+    # Timing: p50/p99 per step, flagged past the threshold
+    print(f"\n{'step':28} {'p50 A':>7} {'p50 B':>7} {'p99 A':>7} {'p99 B':>7}  change")
+    ta, tb = timings(a), timings(b)
+    regressions = 0
+    for step in sorted(set(ta) | set(tb)):
+        va, vb = ta.get(step, []), tb.get(step, [])
+        p50a, p50b, p99a, p99b = percentile(va, 50), percentile(vb, 50), percentile(va, 99), percentile(vb, 99)
+        change = (p99b - p99a) / p99a * 100 if p99a else 0
+        flag = "  REGRESSION" if va and vb and change > args.threshold and p99b - p99a > args.min_us else ""
+        regressions += bool(flag)
+        print(f"{step:28} {p50a:7} {p50b:7} {p99a:7} {p99b:7}  {change:+6.1f}%{flag}")
+
+    print(f"\n{failures} behavioural differences, {regressions} timing regressions")
+    return 1 if failures or regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    dump = sub.add_parser("dump", help="print every record")
+    dump.add_argument("file")
+    dump.add_argument("--type", action="append", choices=sorted(NAMES.values()), help="only these record types")
+
+    stats = sub.add_parser("stats", help="processing time per step")
+    stats.add_argument("file")
+
+    diff = sub.add_parser("diff", help="compare two output files")
+    diff.add_argument("a")
+    diff.add_argument("b")
+    diff.add_argument("--ignore", action="append", help="extra payload key to ignore")
+    diff.add_argument("--limit", type=int, default=5, help="differences shown per stream")
+    diff.add_argument("--threshold", type=float, default=10.0, help="p99 increase in %% that counts as a regression")
+    diff.add_argument("--min-us", type=int, default=5, help="ignore p99 increases below this many us")
+
+    args = parser.parse_args()
+    if args.command == "dump":
+        cmd_dump(args)
+    elif args.command == "stats":
+        cmd_stats(args)
+    else:
+        sys.exit(cmd_diff(args))
+
+
+if __name__ == "__main__":
+    main()
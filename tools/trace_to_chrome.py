@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Convert a /api/trace capture into Chrome trace JSON (open in ui.perfetto.dev).
+
+    curl -o trace.bin "http://<device-ip>/api/trace"
+    python tools/trace_to_chrome.py trace.bin trace.json
+"""
+import bisect
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHIIIHH")
+EVENT = struct.Struct("<IIIIBBH")
+
+
+def read_table(data, offset, count):
+    table = {}
+    for _ in range(count):
+        key, length = struct.unpack_from("<IB", data, offset)
+        offset += 5
+        table[key] = data[offset:offset + length].decode("utf-8", "replace")
+        offset += length
+    return table, offset
+
+
+def unwrap(previous, value, bits=32):
+    """Extends a wrapping counter using the signed distance to the previous value"""
+    if previous is None:
+        return value
+    delta = (value - previous) & ((1 << bits) - 1)
+    if delta >= 1 << (bits - 1):
+        delta -= 1 << bits
+    return previous + delta
+
+
+class Clock:
+    """Cycle count -> microseconds for one core, piecewise between Sync anchors"""
+
+    def __init__(self, mhz):
+        self.mhz = mhz
+        self.cycles = []
+        self.micros = []
+
+    def anchor(self, cycles, micros):
+        self.cycles.append(cycles)
+        self.micros.append(micros)
+
+    def to_us(self, cycles):
+        if not self.cycles:
+            return cycles / self.mhz
+        i = bisect.bisect_right(self.cycles, cycles)
+        lo = max(0, min(i - 1, len(self.cycles) - 2))
+        if len(self.cycles) < 2:
+            return self.micros[0] + (cycles - self.cycles[0]) / self.mhz
+        c0, c1 = self.cycles[lo], self.cycles[lo + 1]
+        u0, u1 = self.micros[lo], self.micros[lo + 1]
+        rate = (c1 - c0) / (u1 - u0) if u1 > u0 else self.mhz
+        return u0 + (cycles - c0) / rate
+
+
+def convert(data):
+    magic, version, event_size, mhz, count, dropped, name_count, task_count = HEADER.unpack_from(data)
+    if magic != b"AFTR" or version != 1 or event_size != EVENT.size:
+        raise SystemExit("not an AFDevice trace (or unsupported version)")
+
+    names, offset = read_table(data, HEADER.size, name_count)
+    tasks, offset = read_table(data, offset, task_count)
+
+    # First pass: unwrap cycles per core and collect the sync anchors
+    events = []
+    last_cycles, last_us = {}, {}
+    clocks = {}
+    for i in range(count):
+        cycles, name, arg, task, phase, core, _ = EVENT.unpack_from(data, offset + i * EVENT.size)
+        cycles = unwrap(last_cycles.get(core), cycles)
+        last_cycles[core] = cycles
+        clock = clocks.setdefault(core, Clock(mhz))
+        if chr(phase) == "S":
+            us = unwrap(last_us.get(core), arg)
+            last_us[core] = us
+            clock.anchor(cycles, us)
+            continue
+        events.append((cycles, names.get(name, "0x%08x" % name), arg, task, chr(phase), core))
+
+    # Tracks: one per task, ISRs on a per-core track
+    tids = {}
+    out = []
+
+    def track(task, core):
+        key = (task, core) if task == 0 else (task, None)
+        if key not in tids:
+            tids[key] = len(tids) + 1
+            label = "isr core %d" % core if task == 0 else tasks.get(task, "task 0x%08x" % task)
+            out.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": tids[key], "args": {"name": label}})
+        return tids[key]
+
+    origin = min((clocks[e[5]].to_us(e[0]) for e in events), default=0)
+    open_scopes = {}
+    end_us = 0
+    for cycles, name, arg, task, phase, core in events:
+        ts = clocks[core].to_us(cycles) - origin
+        end_us = max(end_us, ts)
+        tid = track(task, core)
+        stack = open_scopes.setdefault(tid, [])
+        if phase == "E":
+            if name not in stack:
+                continue  # Begin happened before the capture started
+            while stack and stack.pop() != name:
+                pass
+        elif phase == "B":
+            stack.append(name)
+        event = {"name": name, "ph": phase, "ts": round(ts, 3), "pid": 0, "tid": tid}
+        if phase == "i":
+            event["s"] = "t"
+            event["args"] = {"arg": arg}
+        out.append(event)
+
+    # Close scopes still open when the capture ended
+    for tid, stack in open_scopes.items():
+        for name in reversed(stack):
+            out.append({"name": name, "ph": "E", "ts": round(end_us, 3), "pid": 0, "tid": tid})
+
+    meta = {"cpuMhz": mhz, "events": count, "dropped": dropped}
+    return {"traceEvents": out, "displayTimeUnit": "ns", "otherData": meta}
+
+
+def main():
+    if len(sys.argv) != 3:
+        raise SystemExit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        trace = convert(f.read())
+    with open(sys.argv[2], "w") as f:
+        json.dump(trace, f)
+    meta = trace["otherData"]
+    print("%d events (%d dropped) -> %s" % (meta["events"], meta["dropped"], sys.argv[2]))
+
+
+if __name__ == "__main__":
+    main()